@@ -80,6 +80,12 @@ requires (sizeof...(whats) > 0)
     return std::string_view{*possible.begin()};
 }
 
+/// The value of an `«option»=«value»` argument, empty for the bare `«option»` as well as for `«option»=`.
+constexpr std::string_view option_value(std::string_view argument, std::string_view option)
+{
+    return argument.size() > option.size() + 1 ? argument.substr(option.size() + 1) : std::string_view{};
+}
+
 constexpr std::size_t count_arguments(is_argument_list auto args)
 {
     return static_cast<std::size_t>(std::ranges::distance(std::begin(args), std::end(args)));
@@ -0,0 +1,317 @@
+#ifndef INCLUDED_ARTIFACT_SIZES_HPP
+#define INCLUDED_ARTIFACT_SIZES_HPP
+
+#include "history.hpp"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Size of an executable or shared library, split by the sections it is made of.
+struct artifact_size
+{
+    std::string   name; ///< Relative to the build directory.
+    std::uint64_t file    = 0;
+    std::uint64_t text    = 0;
+    std::uint64_t rodata  = 0;
+    std::uint64_t data    = 0;
+    std::uint64_t debug   = 0;
+    std::uint64_t symbols = 0; ///< Both the static and the dynamic symbol tables.
+
+    /// The measurements of the artifact by name, in the order the history keeps them in `history_record::sizes`.
+    auto measurements() const
+    {
+        return std::array<std::pair<std::string_view, std::uint64_t>, history_record::SIZES>{ {
+            { "file"sv, file },
+            { "text"sv, text },
+            { "rodata"sv, rodata },
+            { "data"sv, data },
+            { "debug"sv, debug },
+            { "symbols"sv, symbols },
+        } };
+    }
+
+    std::array<std::uint64_t, history_record::SIZES> sizes() const
+    {
+        auto result = std::array<std::uint64_t, history_record::SIZES>{};
+        std::ranges::copy(measurements() | std::views::values, result.begin());
+        return result;
+    }
+};
+
+namespace details {
+
+/// Reads the section headers of a mapped ELF file of the class of `HEADER`.
+template <typename HEADER, typename SECTION>
+std::optional<artifact_size> read_sections(std::string_view image)
+{
+    if (image.size() < sizeof(HEADER)) {
+        return std::nullopt;
+    }
+    auto header = HEADER{};
+    std::memcpy(&header, image.data(), sizeof(header));
+    if (header.e_type != ET_EXEC && header.e_type != ET_DYN) {
+        return std::nullopt;
+    }
+    if (header.e_shentsize != sizeof(SECTION) || header.e_shstrndx >= header.e_shnum ||
+        header.e_shoff + std::uint64_t{ header.e_shnum } * sizeof(SECTION) > image.size()) {
+        return std::nullopt;
+    }
+
+    auto section = [&](std::size_t index) {
+        auto result = SECTION{};
+        std::memcpy(&result, image.data() + header.e_shoff + index * sizeof(SECTION), sizeof(result));
+        return result;
+    };
+    auto names = section(header.e_shstrndx);
+    if (names.sh_offset + names.sh_size > image.size()) {
+        return std::nullopt;
+    }
+    auto strings = image.substr(names.sh_offset, names.sh_size);
+
+    auto result = artifact_size{};
+    result.file = image.size();
+    for (auto index = std::size_t{ 0 }; index < header.e_shnum; ++index) {
+        auto current = section(index);
+        auto name    = current.sh_name < strings.size() ? strings.substr(current.sh_name) : ""sv;
+        name         = name.substr(0, name.find('\0'));
+
+        if (current.sh_type == SHT_SYMTAB || current.sh_type == SHT_DYNSYM) {
+            result.symbols += current.sh_entsize != 0 ? current.sh_size / current.sh_entsize : 0;
+        }
+        if (current.sh_type == SHT_NOBITS) {
+            // .bss takes memory, not room in the file.
+            continue;
+        }
+        if (name.starts_with(".text"sv)) {
+            result.text += current.sh_size;
+        } else if (name.starts_with(".rodata"sv)) {
+            result.rodata += current.sh_size;
+        } else if (name.starts_with(".data"sv)) {
+            result.data += current.sh_size;
+        } else if (name.starts_with(".debug"sv) || name.starts_with(".zdebug"sv)) {
+            result.debug += current.sh_size;
+        }
+    }
+    return result;
+}
+
+} // namespace details
+
+/// The size of the executables and shared libraries of a build, read from their ELF headers.
+///
+/// The files are mapped in memory and only their section headers are read, no tool is run. The sizes are recorded in
+/// the history, each run shows how they changed since the previous one.
+class artifact_sizes
+{
+public:
+
+    static constexpr auto SHOWN = std::size_t{ 10 };
+
+    /// The sections of `file`, nothing if it is not an executable or a shared library of this machine's byte order.
+    static std::optional<artifact_size> read(const std::filesystem::path& file)
+    {
+        auto fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return std::nullopt;
+        }
+
+        auto result = std::optional<artifact_size>{};
+        struct stat info{};
+        if (::fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) > EI_NIDENT) {
+            auto size   = static_cast<std::size_t>(info.st_size);
+            auto mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                result = parse(std::string_view{ static_cast<const char*>(mapped), size });
+                ::munmap(mapped, size);
+            }
+        }
+        ::close(fd);
+        return result;
+    }
+
+    static std::optional<artifact_size> parse(std::string_view image)
+    {
+        static constexpr auto NATIVE = std::endian::native == std::endian::little ? ELFDATA2LSB : ELFDATA2MSB;
+
+        if (image.size() <= EI_NIDENT || !image.starts_with(ELFMAG) || image[EI_DATA] != NATIVE) {
+            return std::nullopt;
+        }
+        switch (image[EI_CLASS]) {
+        case ELFCLASS64:
+            return details::read_sections<Elf64_Ehdr, Elf64_Shdr>(image);
+        case ELFCLASS32:
+            return details::read_sections<Elf32_Ehdr, Elf32_Shdr>(image);
+        default:
+            return std::nullopt;
+        }
+    }
+
+    /// The executables and shared libraries in `build_dir`, the largest first.
+    ///
+    /// Objects and static libraries are left out, only what gets deployed counts.
+    static std::vector<artifact_size> scan(const std::filesystem::path& build_dir)
+    {
+        auto result = std::vector<artifact_size>{};
+        auto error  = std::error_code{};
+        for (auto it = std::filesystem::recursive_directory_iterator{ build_dir, error };
+             it != std::filesystem::recursive_directory_iterator{};
+             it.increment(error)) {
+            auto name = it->path().filename().string();
+            if (it->is_directory(error) && (name == "CMakeFiles"sv || name == ".vmk"sv)) {
+                it.disable_recursion_pending();
+                continue;
+            }
+            if (it->is_symlink(error) || !it->is_regular_file(error)) {
+                continue;
+            }
+            auto executable = (it->status(error).permissions() & std::filesystem::perms::owner_exec) !=
+                              std::filesystem::perms::none;
+            if (!executable && !name.contains(".so"sv)) {
+                continue;
+            }
+            if (auto size = read(it->path()); size.has_value()) {
+                size->name = it->path().lexically_relative(build_dir).generic_string();
+                result.push_back(std::move(*size));
+            }
+        }
+        std::ranges::sort(result, std::ranges::greater{}, &artifact_size::file);
+        return result;
+    }
+
+    static void record(history_recorder& recorder, const std::vector<artifact_size>& artifacts)
+    {
+        for (const auto& artifact : artifacts) {
+            recorder.add_sizes(artifact.name, artifact.sizes());
+        }
+    }
+
+    using sizes_type = std::map<std::string, std::array<std::uint64_t, history_record::SIZES>, std::less<>>;
+
+    /// The sizes recorded by the latest run of the same configuration that recorded each one.
+    static sizes_type previous(const history& past, std::uint64_t configuration)
+    {
+        auto result = sizes_type{};
+        for (const auto& record : past.records() | std::views::reverse) {
+            if (record.type == history_record::kind::artifact && record.configuration == configuration) {
+                result.emplace(record.get_name(), record.sizes);
+            }
+        }
+        return result;
+    }
+
+    /// The artifacts whose size changed since the previous run, or the largest ones when none did.
+    static std::vector<std::string> summary(const std::vector<artifact_size>& artifacts, const sizes_type& before)
+    {
+        auto result = std::vector<std::string>{};
+        if (artifacts.empty()) {
+            return result;
+        }
+
+        auto total    = std::uint64_t{ 0 };
+        auto previous = std::uint64_t{ 0 };
+        auto changed  = std::vector<std::string>{};
+        auto largest  = std::vector<std::string>{};
+        for (const auto& artifact : artifacts) {
+            auto line    = describe(artifact);
+            auto differs = false;
+            auto last    = before.find(history_name(artifact.name));
+            auto sizes   = last != before.end() ? last->second : artifact.sizes();
+            total += artifact.file;
+            previous += sizes.front();
+            for (auto [index, measured] : artifact.measurements() | std::views::enumerate) {
+                auto [label, bytes] = measured;
+                auto earlier        = sizes[static_cast<std::size_t>(index)];
+                if (earlier != bytes) {
+                    line += std::format(" {}{}", label, delta(bytes, earlier));
+                    differs = true;
+                }
+            }
+            if (differs) {
+                changed.push_back(std::move(line));
+            } else if (largest.size() < SHOWN) {
+                largest.push_back(std::move(line));
+            }
+        }
+
+        result.push_back(std::format(
+            "📏 {} artifacts, {}{}", artifacts.size(), human(total), previous != total ? delta(total, previous) : ""s));
+        for (auto& line : changed.empty() ? largest : changed) {
+            result.push_back(std::move(line));
+        }
+        return result;
+    }
+
+    static std::string human(std::uint64_t bytes)
+    {
+        static constexpr auto units = std::array{ "B"sv, "KiB"sv, "MiB"sv, "GiB"sv };
+
+        auto value = static_cast<double>(bytes);
+        auto unit  = std::size_t{ 0 };
+        while (value >= 1024 && unit + 1 < units.size()) {
+            value /= 1024;
+            ++unit;
+        }
+        return unit == 0 ? std::format("{} B", bytes) : std::format("{:.1f} {}", value, units[unit]);
+    }
+
+private:
+
+    /// The name as the history keeps it, long ones are cut.
+    static std::string history_name(std::string_view name)
+    {
+        auto record = history_record{};
+        record.set_name(name);
+        return std::string{ record.get_name() };
+    }
+
+    static std::string describe(const artifact_size& artifact)
+    {
+        return std::format(
+            "    {:<40} {:>10}  text {}, rodata {}, data {}, debug {}, {} symbols",
+            artifact.name,
+            human(artifact.file),
+            human(artifact.text),
+            human(artifact.rodata),
+            human(artifact.data),
+            human(artifact.debug),
+            artifact.symbols);
+    }
+
+    static std::string delta(std::uint64_t now, std::uint64_t before)
+    {
+        auto grew = now >= before;
+        auto diff = grew ? now - before : before - now;
+        return std::format(
+            " ({}{}, {:+.1f}%)",
+            grew ? "+"sv : "-"sv,
+            human(diff),
+            before == 0 ? 100.0 : (static_cast<double>(now) / static_cast<double>(before) - 1.0) * 100.0);
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_ARTIFACT_SIZES_HPP
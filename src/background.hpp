@@ -0,0 +1,419 @@
+#ifndef INCLUDED_BACKGROUND_HPP
+#define INCLUDED_BACKGROUND_HPP
+
+#include "state.hpp"
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Runs the tools with only the capacity the rest of the machine leaves unused.
+///
+/// Enabled by `--background`. vmk switches itself to `SCHED_IDLE` and the idle I/O class, which the tools it starts
+/// inherit, and moves to a cgroup of its own with the lowest `cpu.weight` when the cgroup tree is delegated to the
+/// user. With `--background=pause` the tools are also stopped while the other processes keep more than half of the
+/// cores busy, and continued once they use less than a quarter. The thread watching the load keeps the normal policy,
+/// a busy machine would starve it right when the tools have to be stopped, and the tools it stopped are continued if
+/// vmk exits or is killed by a signal it can catch.
+class background_mode
+{
+public:
+
+    static constexpr auto PAUSE        = "pause"sv;
+    static constexpr auto CPU_WEIGHT   = 1;
+    static constexpr auto PAUSE_ABOVE  = 0.5;
+    static constexpr auto RESUME_BELOW = 0.25;
+    static constexpr auto INTERVAL     = 500ms;
+
+    /// Busy and total time of all the cores, from the `cpu` line of `/proc/stat`.
+    struct cpu_times
+    {
+        std::uint64_t busy  = 0;
+        std::uint64_t total = 0;
+    };
+
+    /// Parent and time used, in clock ticks, from a `/proc/«pid»/stat`.
+    struct process_stat
+    {
+        pid_t         parent = 0;
+        std::uint64_t ticks  = 0;
+    };
+
+    static constexpr auto MAX_STOPPED = std::size_t{ 4096 };
+
+    explicit background_mode(bool pause)
+    {
+        enter_cgroup();
+        if (pause) {
+            continue_stopped_on_exit();
+            my_monitor = std::jthread{ [this](std::stop_token stop) { monitor(stop); } };
+        }
+        // Only for this thread and the ones it starts, the monitor started before keeps the normal policy.
+        lower_priorities();
+    }
+
+    background_mode(const background_mode&)            = delete;
+    background_mode& operator=(const background_mode&) = delete;
+
+    ~background_mode()
+    {
+        if (my_monitor.joinable()) {
+            my_monitor.request_stop();
+            my_monitor.join();
+            for (const auto& [signal, action] : my_previous_actions) {
+                ::sigaction(signal, &action, nullptr);
+            }
+        }
+        leave_cgroup();
+    }
+
+    /// What could and could not be set up, for the user to know what to expect.
+    const std::vector<std::string>& notes() const
+    {
+        return my_notes;
+    }
+
+    static std::optional<cpu_times> parse_cpu_times(std::string_view proc_stat)
+    {
+        if (!proc_stat.starts_with("cpu "sv)) {
+            return std::nullopt;
+        }
+        auto line   = std::istringstream{ std::string{ proc_stat.substr(0, proc_stat.find('\n')) } };
+        auto label  = std::string{};
+        auto fields = std::vector<std::uint64_t>{};
+        line >> label;
+        for (auto value = std::uint64_t{}; line >> value;) {
+            fields.push_back(value);
+        }
+        if (fields.size() < 5) {
+            return std::nullopt;
+        }
+
+        // user nice system idle iowait irq softirq steal, the guest times are already in user and nice.
+        auto result = cpu_times{};
+        for (auto [index, value] : fields | std::views::take(8) | std::views::enumerate) {
+            result.total += value;
+            if (index != 3 && index != 4) {
+                result.busy += value;
+            }
+        }
+        return result;
+    }
+
+    static std::optional<process_stat> parse_process_stat(std::string_view stat)
+    {
+        // The command name is between parentheses and may contain anything, the fields follow the last one.
+        auto name_end = stat.rfind(')');
+        if (name_end == stat.npos) {
+            return std::nullopt;
+        }
+        auto fields = std::vector<std::string_view>{};
+        for (auto field : stat.substr(name_end + 1) | std::views::split(' ')) {
+            if (!field.empty()) {
+                fields.emplace_back(field.begin(), field.end());
+            }
+        }
+        // state ppid … utime(12th) stime(13th) after the name.
+        if (fields.size() < 13) {
+            return std::nullopt;
+        }
+
+        auto number = [](std::string_view text) {
+            auto value = std::uint64_t{};
+            std::from_chars(text.data(), text.data() + text.size(), value);
+            return value;
+        };
+        return process_stat{ static_cast<pid_t>(number(fields[1])), number(fields[11]) + number(fields[12]) };
+    }
+
+    /// Hysteresis between pausing and resuming, `others` is the share of the cores the other processes used.
+    static bool should_pause(bool paused, double others)
+    {
+        return paused ? others >= RESUME_BELOW : others > PAUSE_ABOVE;
+    }
+
+    /// Every process started by `root`, directly or not.
+    static std::vector<pid_t> descendants(pid_t root, const std::map<pid_t, process_stat>& processes)
+    {
+        auto result  = std::vector<pid_t>{};
+        auto parents = std::vector<pid_t>{ root };
+        while (!parents.empty()) {
+            auto parent = parents.back();
+            parents.pop_back();
+            for (const auto& [pid, stat] : processes) {
+                if (stat.parent == parent) {
+                    result.push_back(pid);
+                    parents.push_back(pid);
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+
+    /// The signals that end vmk and can be caught, the tools stopped are continued before vmk goes.
+    static constexpr auto fatal_signals = std::array{ SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGABRT };
+
+    std::vector<std::string>                      my_notes;
+    std::optional<std::filesystem::path>          my_cgroup;
+    std::filesystem::path                         my_parent_cgroup;
+    std::map<pid_t, std::uint64_t>                my_running;
+    std::uint64_t                                 my_finished = 0;
+    std::vector<std::pair<int, struct sigaction>> my_previous_actions;
+    std::jthread                                  my_monitor;
+
+    /// The tools the monitor stopped, where a signal handler can read them.
+    static inline auto stopped       = std::array<std::atomic<pid_t>, MAX_STOPPED>{};
+    static inline auto stopped_count = std::atomic<std::size_t>{ 0 };
+
+    static void remember_stopped(const std::vector<pid_t>& pids)
+    {
+        stopped_count = 0;
+        auto count    = std::min(pids.size(), MAX_STOPPED);
+        for (auto index = std::size_t{ 0 }; index < count; ++index) {
+            stopped[index] = pids[index];
+        }
+        stopped_count = count;
+    }
+
+    /// Only calls async signal safe functions.
+    static void continue_stopped()
+    {
+        auto count = stopped_count.exchange(0);
+        for (auto index = std::size_t{ 0 }; index < count; ++index) {
+            ::kill(stopped[index], SIGCONT);
+        }
+    }
+
+    static void on_fatal_signal(int signal)
+    {
+        continue_stopped();
+        // The handler was reset to the default one, which ends vmk as the signal meant to.
+        ::raise(signal);
+    }
+
+    void continue_stopped_on_exit()
+    {
+        static auto registered = std::atomic_flag{};
+        if (!registered.test_and_set()) {
+            std::atexit(continue_stopped);
+        }
+
+        struct sigaction action{};
+        action.sa_handler = on_fatal_signal;
+        action.sa_flags   = SA_RESETHAND;
+        ::sigemptyset(&action.sa_mask);
+        for (auto signal : fatal_signals) {
+            struct sigaction previous{};
+            ::sigaction(signal, nullptr, &previous);
+            // Signals ignored when vmk started, by nohup for instance, stay ignored.
+            if (previous.sa_handler == SIG_IGN) {
+                continue;
+            }
+            ::sigaction(signal, &action, nullptr);
+            my_previous_actions.emplace_back(signal, previous);
+        }
+    }
+
+    /// Lowers the priorities of the calling thread, the threads and processes it starts afterwards inherit them.
+    void lower_priorities()
+    {
+        auto policy = sched_param{};
+        if (::sched_setscheduler(0, SCHED_IDLE, &policy) != 0) {
+            my_notes.push_back(std::format("could not use the idle scheduling policy: {}", std::strerror(errno)));
+        }
+
+        // ioprio_set has no glibc wrapper: class idle is 3, in the 3 top bits of the 16 bits priority.
+        static constexpr auto IOPRIO_WHO_PROCESS = 1;
+        static constexpr auto IOPRIO_IDLE        = 3 << 13;
+        if (::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_IDLE) != 0) {
+            my_notes.push_back(std::format("could not use the idle I/O class: {}", std::strerror(errno)));
+        }
+    }
+
+    /// Moves vmk to a new child of its cgroup, where the weight can be lowered if the cpu controller is delegated.
+    void enter_cgroup()
+    {
+        static constexpr auto CGROUP_ROOT = "/sys/fs/cgroup"sv;
+
+        // The v2 entry is `0::/path`, in a hybrid hierarchy it comes after the v1 ones.
+        auto membership = "\n"s + read_file("/proc/self/cgroup");
+        auto entry      = membership.find("\n0::/"sv);
+        if (entry == membership.npos ||
+            !std::filesystem::exists(std::filesystem::path{ CGROUP_ROOT } / "cgroup.controllers")) {
+            my_notes.push_back("no cgroup v2 hierarchy, the cpu weight is left as it is"s);
+            return;
+        }
+        auto relative    = membership.substr(entry + 5, membership.find('\n', entry + 1) - entry - 5);
+        my_parent_cgroup = std::filesystem::path{ CGROUP_ROOT } / relative;
+        auto cgroup      = my_parent_cgroup / std::format("vmk-{}", ::getpid());
+
+        auto error = std::error_code{};
+        if (!std::filesystem::create_directory(cgroup, error) || !write_value(cgroup / "cgroup.procs", ::getpid())) {
+            std::filesystem::remove(cgroup, error);
+            my_notes.push_back(std::format("the cgroup {} is not delegated, the cpu weight is left as it is", relative));
+            return;
+        }
+        my_cgroup = cgroup;
+
+        if (!write_value(cgroup / "cpu.weight", CPU_WEIGHT)) {
+            my_notes.push_back("the cpu controller is not enabled for the cgroup, the cpu weight is left as it is"s);
+        }
+    }
+
+    void leave_cgroup()
+    {
+        if (!my_cgroup.has_value()) {
+            return;
+        }
+        // A cgroup can only be removed once empty, the tools still running, daemons a build started, leave with vmk.
+        auto error = std::error_code{};
+        for (auto attempt = 0; attempt < 3; ++attempt) {
+            auto procs = std::istringstream{ read_file(*my_cgroup / "cgroup.procs") };
+            for (auto pid = pid_t{}; procs >> pid;) {
+                write_value(my_parent_cgroup / "cgroup.procs", pid);
+            }
+            if (std::filesystem::remove(*my_cgroup, error)) {
+                return;
+            }
+        }
+    }
+
+    static bool write_value(const std::filesystem::path& file, auto value)
+    {
+        auto out = std::ofstream{ file };
+        out << value;
+        return static_cast<bool>(out.flush());
+    }
+
+    static std::map<pid_t, process_stat> processes()
+    {
+        auto result = std::map<pid_t, process_stat>{};
+        auto error  = std::error_code{};
+        for (const auto& entry : std::filesystem::directory_iterator{ "/proc", error }) {
+            auto name = entry.path().filename().string();
+            auto pid  = pid_t{};
+            if (std::from_chars(name.data(), name.data() + name.size(), pid).ptr != name.data() + name.size()) {
+                continue;
+            }
+            if (auto stat = parse_process_stat(read_file(entry.path() / "stat")); stat.has_value()) {
+                result.emplace(pid, *stat);
+            }
+        }
+        return result;
+    }
+
+    static void signal_all(const std::vector<pid_t>& pids, int signal)
+    {
+        for (auto pid : pids) {
+            ::kill(pid, signal);
+        }
+    }
+
+    /// Clock ticks used so far by the tools, exactly from the cgroup when vmk has one, else summed over the processes.
+    ///
+    /// A process that ends between two checks loses the time it used since the last one.
+    std::uint64_t tools_ticks(const std::map<pid_t, process_stat>& all, const std::vector<pid_t>& tools)
+    {
+        if (my_cgroup.has_value()) {
+            auto stat = std::istringstream{ read_file(*my_cgroup / "cpu.stat") };
+            auto name = std::string{};
+            for (auto value = std::uint64_t{}; stat >> name >> value;) {
+                if (name == "usage_usec"sv) {
+                    return value * static_cast<std::uint64_t>(::sysconf(_SC_CLK_TCK)) / 1'000'000;
+                }
+            }
+        }
+
+        auto current = std::map<pid_t, std::uint64_t>{};
+        auto result  = std::uint64_t{ 0 };
+        for (auto pid : tools) {
+            current.emplace(pid, all.at(pid).ticks);
+            result += all.at(pid).ticks;
+        }
+        for (const auto& [pid, ticks] : my_running) {
+            if (!current.contains(pid)) {
+                my_finished += ticks;
+            }
+        }
+        my_running = std::move(current);
+        return my_finished + result;
+    }
+
+    /// Compares the time all the cores were busy with the time the tools used, what is left is the others' load.
+    void monitor(std::stop_token stop)
+    {
+        auto paused    = false;
+        auto last_cpu  = parse_cpu_times(read_file("/proc/stat"));
+        auto last_ours = tools_ticks(processes(), {});
+
+        while (!stop.stop_requested()) {
+            std::this_thread::sleep_for(INTERVAL);
+
+            auto all   = processes();
+            auto tools = descendants(::getpid(), all);
+            auto ours  = tools_ticks(all, tools);
+            auto cpu   = parse_cpu_times(read_file("/proc/stat"));
+            if (!cpu.has_value() || !last_cpu.has_value() || cpu->total <= last_cpu->total) {
+                continue;
+            }
+
+            auto busy   = cpu->busy - std::min(cpu->busy, last_cpu->busy);
+            auto used   = ours - std::min(ours, last_ours);
+            auto others = static_cast<double>(busy - std::min(busy, used)) / static_cast<double>(cpu->total - last_cpu->total);
+            last_cpu    = cpu;
+            last_ours   = ours;
+
+            auto pause = should_pause(paused, others);
+            if (pause) {
+                // Tools started since the last check are stopped too.
+                remember_stopped(tools);
+                signal_all(tools, SIGSTOP);
+            } else if (paused) {
+                signal_all(tools, SIGCONT);
+                remember_stopped({});
+            }
+            paused = pause;
+        }
+
+        if (paused) {
+            signal_all(descendants(::getpid(), processes()), SIGCONT);
+            remember_stopped({});
+        }
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_BACKGROUND_HPP
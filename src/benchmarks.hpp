@@ -0,0 +1,420 @@
+#ifndef INCLUDED_BENCHMARKS_HPP
+#define INCLUDED_BENCHMARKS_HPP
+
+#include "state.hpp"
+#include "worktree.hpp"
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Time of one benchmark over its repetitions, in nanoseconds.
+struct benchmark_result
+{
+    double      mean    = 0.0;
+    double      stddev  = 0.0;
+    std::size_t samples = 0;
+
+    static benchmark_result of(std::span<const double> times)
+    {
+        auto result    = benchmark_result{};
+        result.samples = times.size();
+        if (times.empty()) {
+            return result;
+        }
+        for (auto time : times) {
+            result.mean += time;
+        }
+        result.mean /= static_cast<double>(times.size());
+        if (times.size() > 1) {
+            for (auto time : times) {
+                result.stddev += (time - result.mean) * (time - result.mean);
+            }
+            result.stddev = std::sqrt(result.stddev / static_cast<double>(times.size() - 1));
+        }
+        return result;
+    }
+};
+
+/// An executable that runs benchmarks, and how to read what it reports.
+struct benchmark_program
+{
+    enum class kind
+    {
+        google, ///< Google Benchmark, reports JSON with `--benchmark_format=json`.
+        catch2, ///< Catch2, reports XML with `--reporter xml`.
+        plain   ///< Anything else, the whole run is timed.
+    };
+
+    std::string              name;
+    std::vector<std::string> command;
+    std::filesystem::path    working_directory;
+    kind                     type = kind::plain;
+
+    static constexpr auto GOOGLE_OPTION = "benchmark_format"sv;
+    static constexpr auto CATCH2_OPTION = "benchmark-samples"sv;
+
+    /// Which framework an executable was built with, from the options it knows about.
+    static kind kind_of(std::string_view image)
+    {
+        if (image.contains(GOOGLE_OPTION)) {
+            return kind::google;
+        }
+        if (image.contains(CATCH2_OPTION)) {
+            return kind::catch2;
+        }
+        return kind::plain;
+    }
+
+    /// `kind_of` the content of `file`, read a chunk at a time instead of whole, executables with debug information
+    /// can weigh hundreds of megabytes.
+    static kind kind_of_file(const std::filesystem::path& file)
+    {
+        static constexpr auto CHUNK   = std::size_t{ 1 } << 16;
+        static constexpr auto OVERLAP = std::max(GOOGLE_OPTION.size(), CATCH2_OPTION.size()) - 1;
+
+        auto in     = std::ifstream{ file, std::ios::binary };
+        auto buffer = std::string(OVERLAP + CHUNK, '\0');
+        auto kept   = std::size_t{ 0 };
+        auto result = kind::plain;
+        while (in.read(buffer.data() + kept, CHUNK) || in.gcount() > 0) {
+            // The end of the previous chunk is kept in front, for an option split between two chunks.
+            auto window = std::string_view{ buffer.data(), kept + static_cast<std::size_t>(in.gcount()) };
+            auto found  = kind_of(window);
+            if (found == kind::google) {
+                return found;
+            }
+            if (found == kind::catch2) {
+                result = found;
+            }
+            kept = std::min(OVERLAP, window.size());
+            std::memmove(buffer.data(), window.data() + window.size() - kept, kept);
+        }
+        return result;
+    }
+
+    /// The tests of `ctest --show-only=json-v1`, those not built for the configuration have no command.
+    static std::vector<benchmark_program> from_ctest(const nlohmann::json& tests)
+    {
+        auto result = std::vector<benchmark_program>{};
+        for (const auto& test : tests.value("tests", nlohmann::json::array())) {
+            auto command = test.value("command", std::vector<std::string>{});
+            if (command.empty()) {
+                continue;
+            }
+            auto program = benchmark_program{ test.value("name", command.front()), std::move(command) };
+            for (const auto& property : test.value("properties", nlohmann::json::array())) {
+                if (property.value("name", ""s) == "WORKING_DIRECTORY"sv && property["value"].is_string()) {
+                    program.working_directory = property["value"].get<std::string>();
+                }
+            }
+            result.push_back(std::move(program));
+        }
+        return result;
+    }
+
+    /// The `benchmark()` targets of `meson-info/intro-benchmarks.json`.
+    static std::vector<benchmark_program> from_meson(const nlohmann::json& benchmarks)
+    {
+        auto result = std::vector<benchmark_program>{};
+        for (const auto& benchmark : benchmarks) {
+            auto command = benchmark.value("cmd", std::vector<std::string>{});
+            if (command.empty()) {
+                continue;
+            }
+            auto program = benchmark_program{ benchmark.value("name", command.front()), std::move(command) };
+            if (auto dir = benchmark.find("workdir"); dir != benchmark.end() && dir->is_string()) {
+                program.working_directory = dir->get<std::string>();
+            }
+            result.push_back(std::move(program));
+        }
+        return result;
+    }
+};
+
+/// How a benchmark compares to its baseline.
+struct benchmark_comparison
+{
+    std::string name;
+    double      change      = 0.0; ///< Relative, 0.1 is 10% slower.
+    bool        significant = false;
+};
+
+/// The results of all the benchmarks of one commit, and the comparison between two of them.
+///
+/// The comparison is Welch's t-test: a change counts when the difference of the means is unlikely at the 5% level
+/// given the spread of both runs, so noisy benchmarks need a larger change to be reported.
+class benchmark_set
+{
+public:
+
+    static constexpr auto DIRECTORY = "bench"sv;
+
+    using results_type = std::map<std::string, benchmark_result, std::less<>>;
+
+    benchmark_set() = default;
+
+    explicit benchmark_set(std::string commit)
+        : my_commit{ std::move(commit) }
+    {
+    }
+
+    const std::string& commit() const
+    {
+        return my_commit;
+    }
+
+    const results_type& results() const
+    {
+        return my_results;
+    }
+
+    void add(std::string_view name, benchmark_result result)
+    {
+        my_results.insert_or_assign(std::string{ name }, result);
+    }
+
+    /// Adds the iterations of a Google Benchmark `--benchmark_format=json` report, one sample per repetition.
+    void add_google_benchmark(const nlohmann::json& report, std::string_view prefix = {})
+    {
+        auto samples = std::map<std::string, std::vector<double>, std::less<>>{};
+        for (const auto& entry : report.value("benchmarks", nlohmann::json::array())) {
+            if (entry.value("run_type", "iteration"s) != "iteration") {
+                continue;
+            }
+            auto name = entry.value("run_name", entry.value("name", ""s));
+            auto time = entry.value("real_time", 0.0) * nanoseconds_per(entry.value("time_unit", "ns"s));
+            samples[std::format("{}{}", prefix, name)].push_back(time);
+        }
+        for (const auto& [name, times] : samples) {
+            add(name, benchmark_result::of(times));
+        }
+    }
+
+    /// Adds the `<BenchmarkResults>` of a Catch2 XML report, its times are in nanoseconds.
+    void add_catch2(std::string_view report, std::string_view prefix = {})
+    {
+        static constexpr auto ELEMENT = "<BenchmarkResults"sv;
+
+        for (auto at = report.find(ELEMENT); at != report.npos; at = report.find(ELEMENT, at + 1)) {
+            auto end     = report.find("</BenchmarkResults>"sv, at);
+            auto element = report.substr(at, end == report.npos ? report.npos : end - at);
+            auto value   = [element](std::string_view child) {
+                auto found = element.find(child);
+                return found == element.npos ? 0.0 : number(attribute(element.substr(found), "value"sv));
+            };
+            auto name = attribute(element, "name"sv);
+            if (!name.empty() && element.contains("<mean"sv)) {
+                add(std::format("{}{}", prefix, name),
+                    benchmark_result{ value("<mean"sv),
+                                      value("<standardDeviation"sv),
+                                      static_cast<std::size_t>(number(attribute(element, "samples"sv))) });
+            }
+        }
+    }
+
+    nlohmann::json json() const
+    {
+        auto results = nlohmann::json::object();
+        for (const auto& [name, result] : my_results) {
+            results[name] = { { "mean", result.mean }, { "stddev", result.stddev }, { "samples", result.samples } };
+        }
+        return { { "commit", my_commit }, { "results", results } };
+    }
+
+    static benchmark_set from_json(const nlohmann::json& content)
+    {
+        auto result  = benchmark_set{ content.value("commit", ""s) };
+        auto results = content.value("results", nlohmann::json::object());
+        for (const auto& [name, entry] : results.items()) {
+            result.add(
+                name,
+                benchmark_result{
+                    entry.value("mean", 0.0), entry.value("stddev", 0.0), entry.value("samples", std::size_t{ 0 }) });
+        }
+        return result;
+    }
+
+    /// Where the results of each commit are kept, shared by all the checkouts of the repository.
+    static std::filesystem::path directory(const std::filesystem::path& root)
+    {
+        return repository_state_dir(root) / DIRECTORY;
+    }
+
+    void store(const std::filesystem::path& root) const
+    {
+        auto dir = directory(root);
+        std::filesystem::create_directories(dir);
+        write_atomically(dir / std::format("{}.json", my_commit), json().dump(1));
+    }
+
+    /// The commit and the variant of the results stored as `name`, `«commit»-«variant»` for a variant.
+    static std::pair<std::string_view, std::string_view> split_name(std::string_view name)
+    {
+        auto dash = name.find('-');
+        return dash == name.npos ? std::pair{ name, ""sv } : std::pair{ name.substr(0, dash), name.substr(dash + 1) };
+    }
+
+    /// The results of `commit`, or when it is empty of the latest commit measured other than `current`.
+    ///
+    /// Only the results of the build `variant` are candidates, none when empty: a `pgo` build is no baseline for the
+    /// usual one.
+    static std::optional<benchmark_set> baseline(
+        const std::filesystem::path& root,
+        std::string_view             current,
+        std::string_view             commit  = {},
+        std::string_view             variant = {})
+    {
+        auto latest = std::optional<std::filesystem::path>{};
+        auto when   = std::filesystem::file_time_type::min();
+        auto error  = std::error_code{};
+        for (const auto& entry : std::filesystem::directory_iterator{ directory(root), error }) {
+            auto name               = entry.path().stem().string();
+            auto [measured, suffix] = split_name(name);
+            if (entry.path().extension() != ".json" || name == current || suffix != variant) {
+                continue;
+            }
+            if (!commit.empty()) {
+                if (measured.starts_with(commit)) {
+                    latest = entry.path();
+                    break;
+                }
+                continue;
+            }
+            if (auto time = entry.last_write_time(error); !error && time > when) {
+                when   = time;
+                latest = entry.path();
+            }
+        }
+        if (!latest.has_value()) {
+            return std::nullopt;
+        }
+
+        auto content = nlohmann::json::parse(read_file(*latest), nullptr, false);
+        if (content.is_discarded()) {
+            return std::nullopt;
+        }
+        return from_json(content);
+    }
+
+    /// The benchmarks measured in both sets, with how much slower each one got.
+    std::vector<benchmark_comparison> compare(const benchmark_set& base) const
+    {
+        auto result = std::vector<benchmark_comparison>{};
+        for (const auto& [name, current] : my_results) {
+            auto found = base.my_results.find(name);
+            if (found == base.my_results.end() || found->second.mean <= 0.0) {
+                continue;
+            }
+            result.push_back(
+                { name, current.mean / found->second.mean - 1.0, is_significant(current, found->second) });
+        }
+        return result;
+    }
+
+    /// The overall change of the times, the geometric mean so that each benchmark weighs the same whatever its scale.
+    static std::optional<double> mean_change(const std::vector<benchmark_comparison>& compared)
+    {
+        if (compared.empty()) {
+            return std::nullopt;
+        }
+        auto sum = 0.0;
+        for (const auto& current : compared) {
+            sum += std::log1p(current.change);
+        }
+        return std::expm1(sum / static_cast<double>(compared.size()));
+    }
+
+    /// Welch's t-test at the 5% level, two-sided.
+    static bool is_significant(const benchmark_result& first, const benchmark_result& second)
+    {
+        if (first.samples < 2 || second.samples < 2) {
+            return false;
+        }
+        auto n1       = static_cast<double>(first.samples);
+        auto n2       = static_cast<double>(second.samples);
+        auto v1       = first.stddev * first.stddev / n1;
+        auto v2       = second.stddev * second.stddev / n2;
+        auto variance = v1 + v2;
+        if (variance <= 0.0) {
+            return first.mean != second.mean;
+        }
+
+        auto t       = std::abs(first.mean - second.mean) / std::sqrt(variance);
+        auto freedom = variance * variance / (v1 * v1 / (n1 - 1) + v2 * v2 / (n2 - 1));
+        return t > critical_t(freedom);
+    }
+
+    /// Two-sided 5% critical value of Student's t distribution.
+    static double critical_t(double freedom)
+    {
+        static constexpr auto table = std::array{ 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                                  2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                                  2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+        if (freedom < 1.0) {
+            return table.front();
+        }
+        auto index = static_cast<std::size_t>(freedom) - 1;
+        return index < table.size() ? table[index] : 1.96;
+    }
+
+private:
+
+    std::string  my_commit;
+    results_type my_results;
+
+    static double nanoseconds_per(std::string_view unit)
+    {
+        if (unit == "us"sv) {
+            return 1e3;
+        }
+        if (unit == "ms"sv) {
+            return 1e6;
+        }
+        if (unit == "s"sv) {
+            return 1e9;
+        }
+        return 1.0;
+    }
+
+    static std::string_view attribute(std::string_view element, std::string_view name)
+    {
+        auto key   = std::format(" {}=\"", name);
+        auto start = element.find(key);
+        if (start == element.npos || start > element.find('>')) {
+            return {};
+        }
+        start += key.size();
+        return element.substr(start, element.find('"', start) - start);
+    }
+
+    static double number(std::string_view text)
+    {
+        auto value = 0.0;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_BENCHMARKS_HPP
@@ -17,6 +17,7 @@
 #include <memory>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <string_view>
 #include <type_traits>
 #include <vector>
@@ -25,15 +26,24 @@ namespace vb::maker {
 
 using optional_path = std::optional<std::filesystem::path>;
 
+/// Value of a variable in a builder environment, empty if it is not set.
+inline std::string value_of(const env::environment& env, std::string_view name)
+{
+    if (auto var = env.get(name); var.has_value() && var.value().has_value()) {
+        return var.value().value_str();
+    }
+    return {};
+}
+
 template<typename ROOT_LOCATOR>
 concept is_root_locator =
     std::convertible_to<std::invoke_result_t<ROOT_LOCATOR, std::filesystem::path>, optional_path> &&
     std::invocable<ROOT_LOCATOR, std::filesystem::path>;
 
 template<typename RUNNER>
-concept is_runner = requires(const RUNNER runner, std::string_view target, argument_container args) {
-    { runner.working_directory(target) } -> std::same_as<fs::path>;
-    { runner.run(target, args) } -> std::same_as<execution_result>;
+concept is_runner = requires(const RUNNER runner, std::span<const std::string_view> targets, argument_container args) {
+    { runner.working_directory(targets) } -> std::same_as<fs::path>;
+    { runner.run(targets, args) } -> std::same_as<execution_result>;
 };
 
 template<typename OPT_RUNNER>
@@ -56,7 +66,8 @@ struct builder_base
 
     using ptr            = std::unique_ptr<builder_base>;
     using factory        = ptr (*)(work_dir, env::environment::optional);
-    using target_type    = std::string_view;
+    /// Targets given on the command line, each builder passes all of them to a single invocation of its tool.
+    using targets_type   = std::span<const std::string_view>;
     using arguments_type = std::vector<std::string>;
 
     virtual ~builder_base() = default;
@@ -86,16 +97,36 @@ struct builder_base
         return get_next_builder();
     }
 
-    constexpr auto run(std::string_view target, is_argument_container auto args) const
+    constexpr auto run(targets_type targets, is_argument_container auto args) const
     {
-        auto extra_arguments = get_arguments(target);
+        auto extra_arguments = get_arguments(targets);
         std::ranges::copy(extra_arguments, std::back_inserter(args));
-        return execute_step(get_command(target), extra_arguments);
+        return execute_step(get_command(targets), extra_arguments);
+    }
+
+    constexpr auto working_directory(targets_type targets) const
+    {
+        return get_working_directory(targets);
+    }
+
+    /// The command and the arguments `run` would use, without the ones given on the command line.
+    auto command_line(targets_type targets) const
+    {
+        auto result = arguments_type{ get_command(targets) };
+        std::ranges::copy(get_arguments(targets), std::back_inserter(result));
+        return result;
+    }
+
+    /// Files the outcome of this stage depends on, besides its command line.
+    auto inputs() const
+    {
+        return get_inputs();
     }
 
-    constexpr auto working_directory(std::string_view target) const
+    /// The directory the build outputs of this stage go to, when the builder knows it.
+    auto build_directory(targets_type targets) const
     {
-        return get_working_directory(target);
+        return get_build_directory(targets);
     }
 
 private:
@@ -109,16 +140,27 @@ private:
         return nullptr;
     }
 
-    virtual std::string get_command(std::string_view target [[maybe_unused]]) const = 0;
+    virtual std::string get_command(targets_type targets [[maybe_unused]]) const = 0;
 
-    virtual arguments_type get_arguments(std::string_view target [[maybe_unused]]) const = 0;
+    /// Must not touch the file system: it is also called to describe and fingerprint the stage, without running it.
+    virtual arguments_type get_arguments(targets_type targets [[maybe_unused]]) const = 0;
 
-    virtual const env::environment& get_environment(std::string_view target [[maybe_unused]]) const = 0;
+    virtual const env::environment& get_environment(targets_type targets [[maybe_unused]]) const = 0;
 
-    virtual fs::path get_working_directory(std::string_view target [[maybe_unused]]) const
+    virtual fs::path get_working_directory(targets_type targets [[maybe_unused]]) const
     {
         return root().path();
     }
+
+    virtual std::vector<fs::path> get_inputs() const
+    {
+        return {};
+    }
+
+    virtual std::optional<fs::path> get_build_directory(targets_type targets [[maybe_unused]]) const
+    {
+        return std::nullopt;
+    }
 };
 
 template<typename TYPE, typename VALUE_T>
@@ -249,11 +291,22 @@ protected:
         return build_dir;
     }
 
+    /// The build directory, without creating it.
+    std::filesystem::path build_dir_path() const
+        requires(needs_build_dir)
+    {
+        return root().path() / std::filesystem::path{ get_build_dirname(environment()) };
+    }
+
     std::filesystem::path get_build_dir() const
         requires(needs_build_dir)
     {
-        auto build_dir = root().path() / std::filesystem::path{ get_build_dirname(environment()) };
+        auto build_dir = build_dir_path();
         if (!std::filesystem::is_directory(build_dir)) {
+            // A build directory moved to memory is left as a dangling link by a reboot.
+            if (std::filesystem::is_symlink(build_dir)) {
+                std::filesystem::remove(build_dir);
+            }
             std::filesystem::create_directory(build_dir);
         }
         return build_dir;
@@ -304,9 +357,9 @@ protected:
                });
     }
 
-    execution_result execute_step(std::string target, arguments_type arguments) const override
+    execution_result execute_step(std::string command, arguments_type arguments) const override
     {
-        return root().execute(get_command(target), arguments, get_environment(target));
+        return root().execute(command, arguments, get_environment({}));
     }
 
     std::string get_name() const override
@@ -341,26 +394,25 @@ protected:
         }
     }
 
-    std::string get_command(std::string_view target [[maybe_unused]]) const override
+    std::string get_command(targets_type targets [[maybe_unused]]) const override
     {
         return std::string{specification_type::command};
     }
 
-    arguments_type get_arguments(std::string_view target) const override
+    arguments_type get_arguments(targets_type targets) const override
     {
-        std::string target_arg;
-        if (!target.empty()) {
+        auto result = arguments_builder();
+        for (auto target : targets | std::views::filter([](auto target) { return !target.empty(); })) {
             if constexpr (requires { SPECIFICATION::target_argument_prefix; }) {
-                target_arg = std::string(SPECIFICATION::target_argument_prefix) + std::string{ target };
+                result.push_back(std::string(SPECIFICATION::target_argument_prefix) + std::string{ target });
             } else {
-                target_arg = target;
+                result.emplace_back(target);
             }
         }
-
-        return arguments_builder(target_arg);
+        return result;
     }
 
-    const env::environment& get_environment(std::string_view) const override
+    const env::environment& get_environment(targets_type) const override
     {
         return environment();
     }
@@ -370,6 +422,21 @@ protected:
         return Stage{ specification_type::stage };
     }
 
+    std::vector<fs::path> get_inputs() const override
+    {
+        auto result = std::vector<fs::path>{};
+        if constexpr (is_many_of<decltype(specification_type::build_file), std::string_view>) {
+            for (auto filename : specification_type::build_file) {
+                if (root().has_file(filename)) {
+                    result.push_back(root().path() / filename);
+                }
+            }
+        } else if (root().has_file(specification_type::build_file)) {
+            result.push_back(root().path() / specification_type::build_file);
+        }
+        return result;
+    }
+
 protected:
 
     template<typename SELF>
@@ -378,14 +445,14 @@ protected:
         return std::forward<SELF>(self).my_env;
     }
 
-    arguments_type arguments(std::string_view target) const
+    arguments_type arguments(targets_type targets) const
     {
-        return get_arguments(target);
+        return get_arguments(targets);
     }
 
-    std::string_view command(std::string_view target) const
+    std::string_view command(targets_type targets) const
     {
-        return get_command(target);
+        return get_command(targets);
     }
 };
 
@@ -465,24 +532,40 @@ private:
         return impl->next_builder();
     }
 
-    const env::environment& get_environment(std::string_view target) const override
+    const env::environment& get_environment(targets_type targets) const override
     {
-        return impl->get_environment(target);
+        return impl->get_environment(targets);
     }
 
-    fs::path get_working_directory(std::string_view target) const override
+    fs::path get_working_directory(targets_type targets) const override
     {
-        return impl->get_working_directory(target);
+        return impl->get_working_directory(targets);
     }
 
-    std::string get_command(std::string_view target) const override
+    std::string get_command(targets_type targets) const override
     {
-        return impl->get_command(target);
+        return impl->get_command(targets);
     }
 
-    arguments_type get_arguments(std::string_view target) const override
+    arguments_type get_arguments(targets_type targets) const override
     {
-        return impl->get_arguments(target);
+        return impl->get_arguments(targets);
+    }
+
+    std::vector<fs::path> get_inputs() const override
+    {
+        if (!*this) {
+            return {};
+        }
+        return impl->get_inputs();
+    }
+
+    std::optional<fs::path> get_build_directory(targets_type targets) const override
+    {
+        if (!*this) {
+            return std::nullopt;
+        }
+        return impl->get_build_directory(targets);
     }
 };
 
@@ -2,11 +2,18 @@
 #define INCLUDED_BUILDERS_HPP
 
 #include "builder.hpp"
+#include "builders/bench.hpp"
+#include "builders/cargo.hpp"
 #include "builders/cmake.hpp"
 #include "builders/cmake_preset.hpp"
 #include "builders/conan.hpp"
+#include "builders/git_submodule.hpp"
+#include "builders/gradle.hpp"
+#include "builders/install.hpp"
 #include "builders/meson.hpp"
 #include "builders/ninja.hpp"
+#include "builders/package.hpp"
+#include "builders/pgo.hpp"
 #include "tasks.hpp"
 #include <util/environment.hpp>
 
@@ -19,13 +26,13 @@ namespace vb::maker::builders {
 using namespace vb::literals;
 using namespace std::literals;
 
-bool is_git_root(std::filesystem::path path)
+inline bool is_git_root(std::filesystem::path path)
 {
     auto git = path / ".git";
     return std::filesystem::is_directory(git) || std::filesystem::is_regular_file(git);
 }
 
-optional_path git_root_locator(std::filesystem::path path)
+inline optional_path git_root_locator(std::filesystem::path path)
 {
     while (!is_git_root(path) && (path.has_relative_path())) {
         path = path.parent_path();
@@ -65,29 +72,6 @@ struct gnumake_spec
 
 using gnumake = basic_builder<gnumake_spec>;
 
-struct cargo_spec
-{
-    static constexpr auto stage      = task_type::build;
-    static constexpr auto name       = "Cargo"sv;
-    static constexpr auto build_file = "cargo.toml"sv;
-    static constexpr auto command    = "cargo"sv;
-    static constexpr auto next_step  = ninja::create;
-    static constexpr auto arguments  = std::array{ "build"sv };
-};
-
-using cargo = basic_builder<cargo_spec>;
-
-struct gradle_spec
-{
-    static constexpr auto stage      = task_type::build;
-    static constexpr auto name       = "gradle"sv;
-    static constexpr auto build_file = std::array{ "gradlew"sv };
-    static constexpr auto command    = "./gradlew"sv;
-    static constexpr auto arguments  = std::array{ "assemble"sv };
-};
-
-using gradle = basic_builder<gradle_spec>;
-
 struct factory
 {
     builder_base::factory my_builder;
@@ -95,6 +79,7 @@ struct factory
     std::string_view      my_name;
 
     bool (*my_stage_check)(task_type);
+    bool (*my_detect)(work_dir);
 
     template<is_builder BUILDER_T>
     static constexpr auto accepts_type(task_type stage)
@@ -110,7 +95,9 @@ struct factory
     template<is_builder BUILDER_T>
     static constexpr factory for_class()
     {
-        return factory{ BUILDER_T::create, BUILDER_T::stage, BUILDER_T::builder_name, &accepts_type<BUILDER_T> };
+        return factory{
+            BUILDER_T::create, BUILDER_T::stage, BUILDER_T::builder_name, &accepts_type<BUILDER_T>, &BUILDER_T::is_root
+        };
     }
 };
 
@@ -118,20 +105,52 @@ inline constexpr auto all_factories =
     std::array{ factory::for_class<make>(),  factory::for_class<gnumake>(), factory::for_class<cmake_preset>(),
                 factory::for_class<cmake>(), factory::for_class<ninja>(),   factory::for_class<jekyll>(),
                 factory::for_class<cargo>(), factory::for_class<meson>(),   factory::for_class<gradle>(),
-                factory::for_class<conan>() };
+                factory::for_class<git_submodule>(), factory::for_class<conan>() };
 
-builder_base::ptr select(work_dir root, Stage stage, env::environment::optional env = {})
+/// Finds the factory of the first builder that recognizes `root` for `stage`, without creating it.
+///
+/// Detection only looks at the files in `root`, so it is cheap and does not need the environment.
+inline const factory* detect(work_dir root, Stage stage)
 {
     for (const auto& factory : all_factories | std::views::filter([&](const auto& factory) {
         return factory.my_stage_check(stage.type());
     })) {
-        if (auto ptr = factory.my_builder(root, env); ptr != nullptr) {
-            return ptr;
+        if (factory.my_detect(root)) {
+            return &factory;
         }
     }
+    return nullptr;
+}
+
+inline builder_base::ptr select(work_dir root, Stage stage, env::environment::optional env = {})
+{
+    if (auto found = detect(root, stage); found != nullptr) {
+        return found->my_builder(root, env);
+    }
     return builder_base::ptr{ nullptr };
 }
 
+inline builder_base::ptr bench::get_next_builder() const
+{
+    if (my_build_dir.has_value()) {
+        return std::make_unique<package>(root(), environment(), *my_build_dir, my_presets);
+    }
+    return package::create(root(), environment());
+}
+
+inline builder_base::ptr git_submodule::get_next_builder() const
+{
+    for (auto stage : all_stages) {
+        for (const auto& factory : all_factories) {
+            if (factory.my_name != git_submodule::builder_name && factory.my_stage_check(stage.type()) &&
+                factory.my_detect(root())) {
+                return factory.my_builder(root(), environment());
+            }
+        }
+    }
+    return nullptr;
+}
+
 }
 
 #endif // INCLUDED_BUILDERS_HPP
@@ -0,0 +1,376 @@
+#ifndef INCLUDED_BENCH_HPP
+#define INCLUDED_BENCH_HPP
+
+#include "../artifact_sizes.hpp"
+#include "../benchmarks.hpp"
+#include "../builder.hpp"
+#include "../output_cache.hpp"
+#include "../state.hpp"
+#include "../tasks.hpp"
+#include "../worktree.hpp"
+#include <nlohmann/json.hpp>
+
+#include <sched.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vb::maker::builders {
+
+using namespace std::literals;
+
+class presets_storage;
+
+struct bench_spec
+{
+    static constexpr auto stage       = task_type::bench;
+    static constexpr auto name        = "benchmarks"sv;
+    static constexpr auto build_file  = std::array{ "CMakeLists.txt"sv, "meson.build"sv };
+    static constexpr auto command     = "bench"sv;
+    static constexpr auto build_dir   = true;
+    static constexpr auto import_vars =
+        std::array{ "CMAKE_BUILD_TYPE",      "VMK_BENCH",         "VMK_BENCH_BASELINE", "VMK_BENCH_FAIL",
+                    "VMK_BENCH_REPETITIONS", "VMK_BENCH_SAMPLES", "VMK_BENCH_THRESHOLD", "VMK_BENCH_VARIANT" };
+};
+
+/// Runs the benchmarks of the build and compares them with the results of a previous commit.
+///
+/// Only runs when asked for with `---bench`. The benchmarks are the ctest tests labeled `benchmark`, the meson
+/// `benchmark()` targets, or else the executables of the build with `bench` in their name. Each one runs alone, pinned
+/// to a core, and its results are stored for the current commit.
+struct bench : basic_builder<bench_spec, bench>
+{
+    using parent = basic_builder<bench_spec, bench>;
+    using parent::create;
+
+    static constexpr auto ENABLE_VAR      = "VMK_BENCH"sv;
+    static constexpr auto BASELINE_VAR    = "VMK_BENCH_BASELINE"sv;
+    static constexpr auto FAIL_VAR        = "VMK_BENCH_FAIL"sv;
+    static constexpr auto REPETITIONS_VAR = "VMK_BENCH_REPETITIONS"sv;
+    static constexpr auto SAMPLES_VAR     = "VMK_BENCH_SAMPLES"sv; ///< Catch2 samples, its own default otherwise.
+    static constexpr auto THRESHOLD_VAR   = "VMK_BENCH_THRESHOLD"sv;
+    static constexpr auto VARIANT_VAR     = "VMK_BENCH_VARIANT"sv; ///< e.g. `pgo`, for another build of the same commit.
+
+    static constexpr auto LABEL             = "benchmark"sv;
+    static constexpr auto INTROSPECTION     = "meson-info/intro-benchmarks.json"sv;
+    static constexpr auto REPETITIONS       = 10;
+    static constexpr auto THRESHOLD_PERCENT = 5.0;
+
+    bench(work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+    {
+    }
+
+    /// Benchmarks the build in `build_dir`, that of a preset, instead of the one `BUILD_DIR` names.
+    ///
+    /// The `presets` of the project are handed over to the package stage.
+    bench(
+        work_dir                               wd,
+        env::environment::optional             env_,
+        std::filesystem::path                  build_dir,
+        std::shared_ptr<const presets_storage> presets = nullptr)
+        : basic_builder{ wd, env_ }
+        , my_build_dir{ std::move(build_dir) }
+        , my_presets{ std::move(presets) }
+    {
+    }
+
+    /// Enables the stage, its options, e.g. `---bench --threshold=3 --fail`, go to the environment of the builder.
+    static void apply(env::environment& env, const std::vector<std::string_view>& options)
+    {
+        static constexpr auto variables = std::array{
+            std::pair{ "--baseline="sv, BASELINE_VAR },
+            std::pair{ "--repetitions="sv, REPETITIONS_VAR },
+            std::pair{ "--samples="sv, SAMPLES_VAR },
+            std::pair{ "--threshold="sv, THRESHOLD_VAR },
+        };
+
+        env.set(ENABLE_VAR) = "1";
+        for (auto option : options) {
+            if (option == "--fail"sv) {
+                env.set(FAIL_VAR) = "1";
+            }
+            for (auto [prefix, name] : variables) {
+                if (option.starts_with(prefix)) {
+                    env.set(name) = option.substr(prefix.size());
+                }
+            }
+        }
+    }
+
+private:
+
+    std::optional<std::filesystem::path>                  my_build_dir;
+    std::shared_ptr<const presets_storage>                my_presets;
+    mutable std::optional<std::vector<benchmark_program>> my_programs;
+
+    std::filesystem::path build_dir() const
+    {
+        return my_build_dir.value_or(build_dir_path());
+    }
+
+    /// Discovered once per run, running ctest to list the tests is not free.
+    const std::vector<benchmark_program>& programs() const
+    {
+        if (my_programs.has_value()) {
+            return *my_programs;
+        }
+
+        auto build_dir = this->build_dir();
+        if (std::filesystem::is_regular_file(build_dir / "CTestTestfile.cmake")) {
+            my_programs = ctest_benchmarks(build_dir);
+        } else if (std::filesystem::is_regular_file(build_dir / INTROSPECTION)) {
+            auto content = nlohmann::json::parse(read_file(build_dir / INTROSPECTION), nullptr, false);
+            my_programs  = content.is_discarded() ? std::vector<benchmark_program>{}
+                                                  : benchmark_program::from_meson(content);
+        } else {
+            my_programs.emplace();
+        }
+
+        if (my_programs->empty()) {
+            for (const auto& artifact : artifact_sizes::scan(build_dir)) {
+                auto file = std::filesystem::path{ artifact.name };
+                if (file.filename().string().contains("bench"sv) && !file.filename().string().contains(".so"sv)) {
+                    my_programs->push_back({ file.filename().string(), { (build_dir / file).string() } });
+                }
+            }
+        }
+        for (auto& program : *my_programs) {
+            program.type = benchmark_program::kind_of_file(program.command.front());
+        }
+        return *my_programs;
+    }
+
+    /// The multi-config generator needs a configuration for ctest to know the commands.
+    std::vector<benchmark_program> ctest_benchmarks(const std::filesystem::path& build_dir) const
+    {
+        auto configuration = value_of(environment(), "CMAKE_BUILD_TYPE");
+        auto listed        = details::tool_output(
+            "ctest"sv, "--test-dir"sv, build_dir.string(), "-N"sv, "-L"sv, LABEL, "-C"sv,
+            configuration.empty() ? "Debug"sv : std::string_view{ configuration }, "--show-only=json-v1"sv);
+        if (!listed.has_value()) {
+            return {};
+        }
+        auto content = nlohmann::json::parse(
+            std::ranges::to<std::string>(*listed | std::views::join_with('\n')), nullptr, false);
+        return content.is_discarded() ? std::vector<benchmark_program>{} : benchmark_program::from_ctest(content);
+    }
+
+    int repetitions() const
+    {
+        auto text  = value_of(environment(), REPETITIONS_VAR);
+        auto value = REPETITIONS;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return std::max(value, 2);
+    }
+
+    double threshold() const
+    {
+        auto text  = value_of(environment(), THRESHOLD_VAR);
+        auto value = THRESHOLD_PERCENT;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value / 100.0;
+    }
+
+    /// The last core vmk may run on, the one least likely to also serve interrupts.
+    static std::optional<int> pinned_cpu()
+    {
+        auto allowed = cpu_set_t{};
+        CPU_ZERO(&allowed);
+        if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return std::nullopt;
+        }
+        for (auto cpu = CPU_SETSIZE - 1; cpu >= 0; --cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                return cpu;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /// The hash of `revision`, or itself when git does not know it.
+    std::string commit(std::string_view revision = "HEAD"sv) const
+    {
+        auto hash = details::tool_output("git"sv, "-C"sv, root().path().string(), "rev-parse"sv, revision);
+        return hash.has_value() && !hash->empty() ? hash->front() : std::string{ revision };
+    }
+
+    /// Runs `program` with `arguments` added, pinned with taskset when it is there. Returns its output, its errors go to
+    /// the sink.
+    std::optional<std::vector<std::string>>
+    run_program(const benchmark_program& program, std::initializer_list<std::string_view> arguments) const
+    {
+        auto command = program.command.front();
+        auto all     = std::ranges::to<arguments_type>(program.command | std::views::drop(1));
+        for (auto argument : arguments) {
+            all.emplace_back(argument);
+        }
+        if (auto cpu = pinned_cpu(); cpu.has_value() && find_program("taskset"sv).has_value()) {
+            all.insert(all.begin(), { "-c"s, std::to_string(*cpu), command });
+            command = "taskset"s;
+        }
+
+        auto dir = program.working_directory.empty() ? build_dir() : program.working_directory;
+        auto output = std::vector<std::string>{};
+        auto status = root().stream_lines(command, all, environment(), dir, [&](std::string_view line, std_io stream) {
+            if (stream == std_io::OUT) {
+                output.emplace_back(line);
+            } else {
+                root().emit(line, stream);
+            }
+        });
+        if (status != 0) {
+            return std::nullopt;
+        }
+        return output;
+    }
+
+    /// Adds the results of `program` to `results`, false if it failed.
+    bool measure(const benchmark_program& program, benchmark_set& results) const
+    {
+        auto count  = std::to_string(repetitions());
+        auto prefix = std::format("{}/", program.name);
+        switch (program.type) {
+        case benchmark_program::kind::google: {
+            auto repetitions_option = std::format("--benchmark_repetitions={}", count);
+            auto output             = run_program(program, { "--benchmark_format=json"sv, repetitions_option });
+            if (!output.has_value()) {
+                return false;
+            }
+            auto report =
+                nlohmann::json::parse(std::ranges::to<std::string>(*output | std::views::join_with('\n')), nullptr, false);
+            if (!report.is_discarded()) {
+                results.add_google_benchmark(report, prefix);
+            }
+            return true;
+        }
+        case benchmark_program::kind::catch2: {
+            // Catch2 repeats each benchmark itself, its samples are not runs of the program.
+            auto samples = value_of(environment(), SAMPLES_VAR);
+            auto output  = samples.empty()
+                             ? run_program(program, { "--reporter"sv, "xml"sv })
+                             : run_program(program, { "--reporter"sv, "xml"sv, "--benchmark-samples"sv, samples });
+            if (!output.has_value()) {
+                return false;
+            }
+            results.add_catch2(std::ranges::to<std::string>(*output | std::views::join_with('\n')), prefix);
+            return true;
+        }
+        case benchmark_program::kind::plain:
+            break;
+        }
+
+        auto times = std::vector<double>{};
+        for (auto run = 0; run < repetitions(); ++run) {
+            auto started = std::chrono::steady_clock::now();
+            if (!run_program(program, {}).has_value()) {
+                return false;
+            }
+            times.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count());
+        }
+        results.add(program.name, benchmark_result::of(times));
+        return true;
+    }
+
+    bool get_required() const override
+    {
+        return !value_of(environment(), ENABLE_VAR).empty() && !programs().empty();
+    }
+
+    arguments_type get_arguments(targets_type) const override
+    {
+        return std::ranges::to<arguments_type>(programs() | std::views::transform(&benchmark_program::name));
+    }
+
+    execution_result execute_step(std::string, arguments_type) const override
+    {
+        auto result  = execution_result{ execution_result::SUCCESS };
+        auto head    = commit();
+        auto variant = value_of(environment(), VARIANT_VAR);
+        auto current = benchmark_set{ variant.empty() ? head : std::format("{}-{}", head, variant) };
+        for (const auto& program : programs()) {
+            root().emit(std::format("📊 {}", program.name));
+            if (!measure(program, current)) {
+                result.status    = execution_result::FAILURE;
+                result.exit_code = 1;
+                result.error_output.push_back(std::format("benchmark {} failed", program.name));
+            }
+        }
+        if (!result) {
+            return result;
+        }
+
+        // A variant is compared with the usual build of the same commit, or with itself at the commit asked for.
+        auto wanted   = value_of(environment(), BASELINE_VAR);
+        auto against  = !wanted.empty() ? commit(wanted) : variant.empty() ? ""s : head;
+        auto baseline =
+            benchmark_set::baseline(root().path(), current.commit(), against, wanted.empty() ? ""s : variant);
+        current.store(root().path());
+        result.output.push_back(std::format(
+            "📊 {} benchmarks of {} programs, results stored for {:.12}",
+            current.results().size(),
+            programs().size(),
+            current.commit()));
+        if (!baseline.has_value()) {
+            result.output.push_back(
+                variant.empty() ? "📊 no baseline to compare with yet"s
+                                : std::format("📊 no results of {:.12} without {} to compare with, `vmk ---bench` measures them", head, variant));
+            return result;
+        }
+
+        auto comparisons = current.compare(*baseline);
+        if (auto change = benchmark_set::mean_change(comparisons); change.has_value()) {
+            result.output.push_back(
+                std::format("📊 times {:+.1f}% against {:.12}, geometric mean", *change * 100.0, baseline->commit()));
+        }
+
+        auto regressions = std::vector<std::string>{};
+        for (const auto& compared : comparisons) {
+            if (!compared.significant || std::abs(compared.change) < threshold()) {
+                continue;
+            }
+            auto line = std::format(
+                "{} {} {:+.1f}% against {:.12}",
+                compared.change > 0 ? "📉"sv : "📈"sv,
+                compared.name,
+                compared.change * 100.0,
+                baseline->commit());
+            if (compared.change > 0) {
+                regressions.push_back(line);
+            }
+            result.output.push_back(std::move(line));
+        }
+        if (regressions.empty()) {
+            return result;
+        }
+
+        if (value_of(environment(), FAIL_VAR).empty()) {
+            result.status = execution_result::SOFT_FAILURE;
+            result.output.push_back(std::format("⚠ {} benchmarks regressed beyond {:.1f}%", regressions.size(), threshold() * 100.0));
+        } else {
+            result.status    = execution_result::FAILURE;
+            result.exit_code = 1;
+            for (auto& line : regressions) {
+                result.error_output.push_back(std::move(line));
+            }
+        }
+        return result;
+    }
+
+    /// The build is packaged and installed once it was measured, when `---package` and `---install` ask for it.
+    builder_base::ptr get_next_builder() const override;
+};
+
+}
+
+#endif // INCLUDED_BENCH_HPP
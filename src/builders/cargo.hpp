@@ -0,0 +1,171 @@
+#ifndef INCLUDED_CARGO_HPP
+#define INCLUDED_CARGO_HPP
+
+#include "../builder.hpp"
+#include "../html_table.hpp"
+#include "../tasks.hpp"
+#include "../work_directory.hpp"
+#include "../worktree.hpp"
+#include <util/environment.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace vb::maker::builders {
+
+using namespace std::literals;
+
+struct cargo_spec
+{
+    static constexpr auto stage       = task_type::DYNAMIC;
+    static constexpr auto stages      = std::array{ task_type::build, task_type::test };
+    static constexpr auto name        = "Cargo"sv;
+    static constexpr auto build_file  = "Cargo.toml"sv;
+    static constexpr auto command     = "cargo"sv;
+    static constexpr auto import_vars = std::array{ "CARGO_HOME",     "CARGO_TARGET_DIR", "CARGO_BUILD_JOBS",
+                                                    "CARGO_PROFILE",  "RUSTC_WRAPPER",    "RUSTFLAGS",
+                                                    "SCCACHE_DIR",    "MAKEFLAGS",        "MFLAGS",
+                                                    "CARGO_MAKEFLAGS" };
+};
+
+class cargo : public basic_builder<cargo_spec, cargo>
+{
+public:
+
+    using parent = basic_builder<cargo_spec, cargo>;
+    using parent::create;
+
+    static constexpr auto TARGET_DIR_VAR = "CARGO_TARGET_DIR"sv;
+    static constexpr auto WRAPPER_VAR    = "RUSTC_WRAPPER"sv;
+    static constexpr auto TIMINGS_REPORT = "cargo-timings/cargo-timing.html"sv;
+
+private:
+
+    task_type my_task = task_type::build;
+
+    /// Shares the target directory between all worktrees of the repository.
+    ///
+    /// Registry dependencies are then compiled once, instead of once per worktree.
+    void setup_target_dir()
+    {
+        if (value_of(environment(), TARGET_DIR_VAR).empty()) {
+            environment().set(TARGET_DIR_VAR) = shared_cache_dir(root().path(), "cargo-target").string();
+        }
+    }
+
+    void setup_wrapper()
+    {
+        if (!value_of(environment(), WRAPPER_VAR).empty()) {
+            return;
+        }
+
+        if (auto sccache = find_program("sccache"); sccache.has_value()) {
+            environment().set(WRAPPER_VAR) = sccache->string();
+        }
+    }
+
+    std::filesystem::path target_dir() const
+    {
+        auto dir = value_of(environment(), TARGET_DIR_VAR);
+        return dir.empty() ? root().path() / "target" : std::filesystem::path{ dir };
+    }
+
+    /// Summary table of the `--timings` report, one line per entry.
+    std::vector<std::string> timings_summary() const
+    {
+        auto report = target_dir() / TIMINGS_REPORT;
+        if (!std::filesystem::is_regular_file(report)) {
+            return {};
+        }
+
+        auto result = std::vector<std::string>{};
+        for (const auto& row : read_html_table(report)) {
+            if (row.size() != 2 || !row.front().ends_with(':')) {
+                continue;
+            }
+            if (row.front().starts_with("Total") || row.front().ends_with("units:") ||
+                row.front().starts_with("Max concurrency")) {
+                result.push_back(std::format("⏱ {} {}", row.front(), row.back()));
+            }
+        }
+        result.push_back(std::format("⏱ report: {}", report.string()));
+        return result;
+    }
+
+public:
+
+    cargo(work_dir wd, env::environment::optional env_)
+        : cargo{ task_type::build, wd, env_ }
+    {
+    }
+
+    cargo(task_type current_stage, work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+        , my_task{ current_stage }
+    {
+        setup_target_dir();
+        setup_wrapper();
+    }
+
+private:
+
+    Stage get_stage() const override
+    {
+        return Stage{ my_task };
+    }
+
+    arguments_type get_arguments(targets_type targets) const override
+    {
+        auto result = arguments_type{};
+        if (my_task == task_type::test) {
+            result.push_back("test"s);
+        } else {
+            result.push_back("build"s);
+            result.push_back("--timings"s);
+        }
+
+        if (auto profile = value_of(environment(), "CARGO_PROFILE"); !profile.empty()) {
+            result.push_back("--profile"s);
+            result.push_back(profile);
+        }
+
+        for (auto target : targets) {
+            result.push_back("--package"s);
+            result.emplace_back(target);
+        }
+        return result;
+    }
+
+    execution_result execute_step(std::string target, arguments_type arguments) const override
+    {
+        auto result = parent::execute_step(target, arguments);
+
+        if (result && my_task == task_type::build) {
+            std::ranges::copy(timings_summary(), std::back_inserter(result.output));
+        }
+        return result;
+    }
+
+    builder_base::ptr get_next_builder() const override
+    {
+        if (my_task != task_type::build) {
+            return nullptr;
+        }
+        return std::make_unique<cargo>(task_type::test, root(), environment());
+    }
+
+    std::string get_name() const override
+    {
+        return std::format("{} «{}»", cargo_spec::name, my_task);
+    }
+};
+
+} // namespace vb::maker::builders
+
+#endif // INCLUDED_CARGO_HPP
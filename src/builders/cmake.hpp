@@ -2,6 +2,10 @@
 #define INCLUDED_CMAKE_HPP
 
 #include "../builder.hpp"
+#include "../cmake_profile.hpp"
+#include "../state.hpp"
+#include "../worktree_sharing.hpp"
+#include "bench.hpp"
 #include "ninja.hpp"
 #include "tasks.hpp"
 #include "work_directory.hpp"
@@ -33,6 +37,7 @@ struct cmake : basic_builder<cmake_spec, cmake>
     {
         environment().set("CMAKE_EXPORT_COMPILE_COMMANDS") = "true";
         environment().set("CMAKE_GENERATOR")               = "Ninja Multi-Config";
+        worktree_sharing::apply(environment(), root().path());
     }
 
 protected:
@@ -50,21 +55,43 @@ protected:
 private:
     execution_result execute_step(std::string target, arguments_type arguments) const override
     {
+        worktree_sharing::prepare(environment(), root().path());
+        if (cmake_profile::enabled(environment())) {
+            std::filesystem::create_directories(profile_output().parent_path());
+        }
         auto result = basic_builder::execute_step(target, arguments);
 
         if (!result) {
             failure_clean_up(get_build_dir());
+        } else if (cmake_profile::enabled(environment())) {
+            cmake_profile::report(result, profile_output());
         }
         return result;
     }
 
-    arguments_type get_arguments(std::string_view) const override  {
-        return arguments_builder("-B", get_build_dirname(environment()));
+    /// A configuration being profiled runs even when the build directory is already configured.
+    bool get_required() const override
+    {
+        return cmake_profile::enabled(environment()) || basic_builder::get_required();
+    }
+
+    arguments_type get_arguments(targets_type) const override  {
+        auto result = arguments_builder("-B", get_build_dirname(environment()));
+        std::ranges::copy(worktree_sharing::cmake_arguments(environment(), root().path()), std::back_inserter(result));
+        if (cmake_profile::enabled(environment())) {
+            std::ranges::copy(cmake_profile::arguments(profile_output()), std::back_inserter(result));
+        }
+        return result;
+    }
+
+    std::filesystem::path profile_output() const
+    {
+        return state_path(build_dir_path()) / cmake_profile::FILE;
     }
 
     builder_base::ptr get_next_builder() const override
     {
-        return builder_base::ptr{std::make_unique<ninja>(root(), environment(), get_build_dir())};
+        return builder_base::ptr{std::make_unique<ninja>(root(), environment(), get_build_dir(), bench::create)};
     }
 };
 
@@ -2,18 +2,29 @@
 #define INCLUDED_CMAKE_PRESET_HPP
 
 #include "../builder.hpp"
+#include "../cmake_profile.hpp"
+#include "../metrics.hpp"
 #include "../tasks.hpp"
 #include "../work_directory.hpp"
+#include "../worktree_sharing.hpp"
+#include "bench.hpp"
+#include "ninja.hpp"
 #include <bits/utility.h>
 #include <nlohmann/json.hpp>
 #include <util/environment.hpp>
 
+#include <charconv>
+#include <cstdlib>
 #include <filesystem>
 #include <flat_map>
 #include <format>
 #include <fstream>
 #include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -49,10 +60,15 @@ private:
     static constexpr auto valid_types =
         std::array{ task_type::configuration, task_type::build, task_type::test, task_type::package };
     static constexpr auto preset_keys =
-        std::array{ "configurePresets"sv, "buildPresets"sv, "testPresets"sv, "packagePreset"sv};
+        std::array{ "configurePresets"sv, "buildPresets"sv, "testPresets"sv, "packagePresets"sv };
+
+    static constexpr auto MAX_INHERITANCE = 32;
 
     std::array<std::vector<preset_type>, std::to_underlying(task_type::DONE)> presets;
 
+    /// The definition of each preset, by type and name.
+    std::array<std::map<std::string, json, std::less<>>, valid_types.size()> definitions;
+
     static constexpr auto locate(task_type type)
     {
         if (auto it = std::ranges::find(valid_types, type); it != valid_types.end()) {
@@ -69,8 +85,117 @@ private:
 
     void load_presets(std::filesystem::path file_path);
 
+    /// Value of `key` in the preset `name`, or in the first of the presets it inherits from that has it.
+    std::optional<json> field_of(task_type type, std::string_view name, std::string_view key, int depth = 0) const
+    {
+        const auto& defined = definitions.at(locate(type));
+        auto        found   = defined.find(name);
+        if (found == defined.end() || depth > MAX_INHERITANCE) {
+            return std::nullopt;
+        }
+        if (auto value = found->second.find(std::string{ key }); value != found->second.end()) {
+            return *value;
+        }
+
+        auto inherits = found->second.value("inherits", json::array());
+        if (inherits.is_string()) {
+            inherits = json::array({ inherits });
+        }
+        for (const auto& parent : inherits) {
+            if (auto value = parent.is_string() ? field_of(type, parent.get<std::string>(), key, depth + 1) : std::nullopt;
+                value.has_value()) {
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /// The configure preset `name` of `type` builds from, itself for a configure preset.
+    std::optional<std::string> configure_preset_of(task_type type, std::string_view name) const
+    {
+        if (type == task_type::configuration) {
+            return definitions.at(locate(type)).contains(name) ? std::optional{ std::string{ name } } : std::nullopt;
+        }
+        auto preset = field_of(type, name, "configurePreset");
+        return preset.has_value() && preset->is_string() ? std::optional{ preset->get<std::string>() } : std::nullopt;
+    }
+
+    /// Expands the macros of a preset that do not depend on the host, `$env{…}` from the environment of vmk.
+    static std::string expand_macros(std::string_view text, const std::map<std::string_view, std::string>& macros)
+    {
+        auto result = std::string{};
+        while (!text.empty()) {
+            auto start = text.find('$');
+            auto open  = text.find('{', start);
+            auto close = text.find('}', open);
+            if (start == text.npos || open == text.npos || close == text.npos) {
+                break;
+            }
+
+            result += text.substr(0, start);
+            auto kind  = text.substr(start + 1, open - start - 1);
+            auto name  = text.substr(open + 1, close - open - 1);
+            auto macro = macros.find(name);
+            if (kind.empty() && macro != macros.end()) {
+                result += macro->second;
+            } else if (kind == "env"sv || kind == "penv"sv) {
+                if (auto value = std::getenv(std::string{ name }.c_str()); value != nullptr) {
+                    result += value;
+                }
+            } else {
+                result += text.substr(start, close - start + 1);
+            }
+            text.remove_prefix(close + 1);
+        }
+        result += text;
+        return result;
+    }
+
 public:
 
+    /// The generator of the configure preset used by the preset `name` of `type`.
+    std::optional<std::string> generator(task_type type, std::string_view name) const
+    {
+        auto configure = configure_preset_of(type, name);
+        auto value     = configure.has_value() ? field_of(task_type::configuration, *configure, "generator") : std::nullopt;
+        return value.has_value() && value->is_string() ? std::optional{ value->get<std::string>() } : std::nullopt;
+    }
+
+    /// The build directory of the configure preset used by the preset `name` of `type`, if it sets one.
+    std::optional<std::filesystem::path> binary_dir(
+        task_type type, std::string_view name, const std::filesystem::path& source_dir) const
+    {
+        auto configure = configure_preset_of(type, name);
+        auto value     = configure.has_value() ? field_of(task_type::configuration, *configure, "binaryDir") : std::nullopt;
+        if (!value.has_value() || !value->is_string()) {
+            return std::nullopt;
+        }
+
+        auto macros = std::map<std::string_view, std::string>{
+            { "sourceDir"sv, source_dir.string() },
+            { "sourceParentDir"sv, source_dir.parent_path().string() },
+            { "sourceDirName"sv, source_dir.filename().string() },
+            { "presetName"sv, *configure },
+            { "generator"sv, generator(type, name).value_or(""s) },
+            { "dollar"sv, "$"s },
+        };
+        auto result = std::filesystem::path{ expand_macros(value->get<std::string>(), macros) };
+        return (result.is_relative() ? source_dir / result : result).lexically_normal();
+    }
+
+    /// The cpack generators set by the package preset `name`, none when it leaves them to the `CPackConfig.cmake`.
+    std::vector<std::string> package_generators(std::string_view name) const
+    {
+        auto value  = field_of(task_type::package, name, "generators");
+        auto result = std::vector<std::string>{};
+        for (const auto& generator : value.value_or(json::array())) {
+            if (generator.is_string()) {
+                result.push_back(generator.get<std::string>());
+            }
+        }
+        return result;
+    }
+
     auto view_for(task_type type) const
     {
         return std::views::all(presets.at(locate(type)));
@@ -113,6 +238,7 @@ inline void presets_storage::load_presets(std::filesystem::path file_path)
         auto appender = appender_for(static_cast<std::size_t>(index));
         for (const auto& [_, current] : content[key].items()) {
             *appender = current["name"].get<std::string>();
+            definitions.at(static_cast<std::size_t>(index)).emplace(current["name"].get<std::string>(), current);
         }
     }
 }
@@ -125,8 +251,18 @@ public:
 
 private:
 
-    presets_storage my_presets;
-    task_type       my_task = configuration;
+    /// Loaded on first use and shared with the builders of the next stages, parsing the presets is not free.
+    mutable std::shared_ptr<const presets_storage> my_presets;
+    task_type                                      my_task = configuration;
+
+    const presets_storage& presets() const
+    {
+        if (!my_presets) {
+            my_presets = std::make_shared<const presets_storage>(
+                root().path() / build_file[0], root().path() / build_file[1]);
+        }
+        return *my_presets;
+    }
 
     static auto all_build_files()
     {
@@ -146,30 +282,79 @@ public:
 
     cmake_preset(work_dir wd, env::environment::optional env_)
         : basic_builder{ wd, env_ }
-        , my_presets{ wd.path() / build_file[0], wd.path() / build_file[1] }
     {
+        worktree_sharing::apply(environment(), root().path());
     }
 
-    cmake_preset(task_type current_stage, work_dir wd, env::environment::optional env_)
+    cmake_preset(
+        task_type                              current_stage,
+        work_dir                               wd,
+        env::environment::optional             env_,
+        std::shared_ptr<const presets_storage> presets = nullptr)
         : basic_builder{ wd, env_ }
-        , my_presets{ wd.path() / build_file[0], wd.path() / build_file[1] }
+        , my_presets{ std::move(presets) }
         , my_task{ current_stage }
     {
+        worktree_sharing::apply(environment(), root().path());
     }
 
     auto presets_for(task_type type) const
     {
-        return my_presets.view_for(type);
+        return presets().view_for(type);
+    }
+
+    /// Build directory of the preset of this stage selected by `targets`, if its configure preset sets one.
+    std::optional<std::filesystem::path> binary_dir(targets_type targets = {}) const
+    {
+        if (presets().view_for(my_task).empty()) {
+            return std::nullopt;
+        }
+        return presets().binary_dir(my_task, selected_preset(targets), root().path());
     }
 
 private:
 
-    arguments_type get_arguments(std::string_view target) const override
+    /// Regular expression for ctest matching any of `names`.
+    static std::string test_filter(std::span<const std::string_view> names)
     {
-        auto preset = target;
+        static constexpr auto special = R"(\^$.|?*+()[]{})"sv;
 
-        if (preset.empty()) {
-            preset = my_presets.view_for(my_task).front();
+        auto result = std::string{};
+        for (auto name : names) {
+            if (!result.empty()) {
+                result += '|';
+            }
+            for (auto c : name) {
+                if (special.contains(c)) {
+                    result += '\\';
+                }
+                result += c;
+            }
+        }
+        return result;
+    }
+
+    /// A target naming a preset of this stage selects it, the first preset is used otherwise.
+    std::string_view selected_preset(targets_type targets) const
+    {
+        auto found = std::ranges::find_if(targets, [&](auto target) {
+            return std::ranges::contains(presets().view_for(my_task), target);
+        });
+        return found != std::ranges::end(targets) ? *found : std::string_view{ presets().view_for(my_task).front() };
+    }
+
+    /// The other targets are build targets or test names.
+    arguments_type get_arguments(targets_type targets) const override
+    {
+        auto preset = selected_preset(targets);
+        auto others = std::vector<std::string_view>{};
+        auto taken  = false;
+        for (auto target : targets) {
+            if (!taken && target == preset) {
+                taken = true;
+            } else {
+                others.push_back(target);
+            }
         }
 
         auto result = arguments_type{};
@@ -181,12 +366,29 @@ private:
         switch (my_task) {
         case task_type::configuration:
             append(std::array{ "--preset"sv, preset });
+            if (auto dir = compile_profile_dir(); dir.has_value()) {
+                append(std::array{ "-B"s, dir->string() });
+            }
+            append(worktree_sharing::cmake_arguments(environment(), root().path()));
+            if (auto output = profile_output(); output.has_value()) {
+                append(cmake_profile::arguments(*output));
+            }
             break;
         case task_type::build:
             append(std::array{ "--build"sv, "--preset"sv, preset });
+            if (!others.empty()) {
+                append(std::array{ "--target"sv });
+                append(others);
+            }
             break;
         case task_type::test:
             append(std::array{ "--output-on-failure"sv, "--preset"sv, preset });
+            if (!others.empty()) {
+                append(std::array{ "--tests-regex"s, test_filter(others) });
+            }
+            if (auto report = junit_report(); report.has_value()) {
+                append(std::array{ "--output-junit"s, report->string() });
+            }
             break;
         default:
             break;
@@ -194,7 +396,125 @@ private:
         return result;
     }
 
-    std::string get_command(std::string_view) const override
+    /// Where ctest reports the tests it ran, only when metrics are collected.
+    std::optional<std::filesystem::path> junit_report() const
+    {
+        if (my_task != task_type::test || value_of(environment(), metrics_file::ENABLE_VAR).empty()) {
+            return std::nullopt;
+        }
+        auto build_dir = value_of(environment(), "BUILD_DIR");
+        return state_path(root().path() / (build_dir.empty() ? "build"s : build_dir)) / "ctest-junit.xml";
+    }
+
+    /// Where cmake writes the profile of the configuration, only when it is profiled.
+    std::optional<std::filesystem::path> profile_output() const
+    {
+        if (my_task != task_type::configuration || !cmake_profile::enabled(environment())) {
+            return std::nullopt;
+        }
+        auto build_dir = value_of(environment(), "BUILD_DIR");
+        return state_path(root().path() / (build_dir.empty() ? "build"s : build_dir)) / cmake_profile::FILE;
+    }
+
+    /// Value of the attribute `name` of the `<testsuite>` element of a JUnit report.
+    static std::optional<double> junit_count(std::string_view report, std::string_view name)
+    {
+        auto suite = report.find("<testsuite"sv);
+        if (suite == report.npos) {
+            return std::nullopt;
+        }
+        auto attribute = std::format(" {}=\"", name);
+        auto start     = report.find(attribute, suite);
+        if (start == report.npos || start > report.find('>', suite)) {
+            return std::nullopt;
+        }
+        start += attribute.size();
+        auto value = 0.0;
+        std::from_chars(report.data() + start, report.data() + report.find('"', start), value);
+        return value;
+    }
+
+    /// `vmk explain` runs ninja itself in the build directory of the preset, see `get_next_builder`; it cannot explain
+    /// a build that goes through `cmake --build`.
+    bool is_explained() const
+    {
+        return !value_of(environment(), rebuild_explanation::ENABLE_VAR).empty();
+    }
+
+    /// With `--profile-compile` the configuration goes to `BUILD_DIR`, which has the profile suffix, instead of the
+    /// binaryDir of the preset; the profiling flags must not end up in the usual build.
+    std::optional<std::filesystem::path> compile_profile_dir() const
+    {
+        if (value_of(environment(), compile_profile::ENABLE_VAR).empty()) {
+            return std::nullopt;
+        }
+        auto build_dir = value_of(environment(), "BUILD_DIR");
+        return root().path() / (build_dir.empty() ? "build"s : build_dir);
+    }
+
+    /// The build directory of the default build preset, when ninja can be run there directly.
+    std::optional<std::filesystem::path> ninja_binary_dir() const
+    {
+        if (presets().view_for(task_type::build).empty()) {
+            return std::nullopt;
+        }
+        auto preset    = presets().view_for(task_type::build).front();
+        auto generator = presets().generator(task_type::build, preset);
+        auto dir       = presets().binary_dir(task_type::build, preset, root().path());
+        if (!generator.has_value() || !generator->starts_with("Ninja"sv) || !dir.has_value() ||
+            !std::filesystem::is_regular_file(*dir / "build.ninja")) {
+            return std::nullopt;
+        }
+        return dir;
+    }
+
+    execution_result execute_step(std::string target, arguments_type arguments) const override
+    {
+        if (my_task == task_type::build && is_explained()) {
+            auto result      = execution_result{ execution_result::FAILURE };
+            result.exit_code = 1;
+            result.error_output.push_back(
+                "vmk explain is not supported for this preset: it needs the Ninja generator and a binaryDir"s);
+            return result;
+        }
+        if (my_task == task_type::build && compile_profile_dir().has_value()) {
+            auto result      = execution_result{ execution_result::FAILURE };
+            result.exit_code = 1;
+            result.error_output.push_back("--profile-compile is not supported for this preset: it needs the Ninja generator"s);
+            return result;
+        }
+        if (my_task == task_type::configuration) {
+            worktree_sharing::prepare(environment(), root().path());
+        }
+        if (auto output = profile_output(); output.has_value()) {
+            std::filesystem::create_directories(output->parent_path());
+            auto result = parent::execute_step(target, arguments);
+            if (result) {
+                cmake_profile::report(result, *output);
+            }
+            return result;
+        }
+
+        auto report = junit_report();
+        if (!report.has_value()) {
+            return parent::execute_step(target, arguments);
+        }
+
+        auto error = std::error_code{};
+        std::filesystem::remove(*report, error);
+        std::filesystem::create_directories(report->parent_path());
+        auto result  = parent::execute_step(target, arguments);
+        auto content = read_file(*report);
+        if (auto tests = junit_count(content, "tests"sv); tests.has_value()) {
+            result.metrics[std::string{ metric::TESTS }] = *tests;
+        }
+        if (auto failures = junit_count(content, "failures"sv); failures.has_value()) {
+            result.metrics[std::string{ metric::TESTS_FAILED }] = *failures;
+        }
+        return result;
+    }
+
+    std::string get_command(targets_type) const override
     {
         if (my_task == task_type::test) {
             return "ctest"s;
@@ -203,15 +523,34 @@ private:
         }
     }
 
+    std::optional<std::filesystem::path> get_build_directory(targets_type targets) const override
+    {
+        return binary_dir(targets);
+    }
+
     builder_base::ptr get_next_builder() const override
     {
         auto next_task = task_type::DONE;
         switch (my_task) {
         case task_type::configuration:
+            if (auto dir = is_explained() ? ninja_binary_dir() : std::nullopt; dir.has_value()) {
+                // The explanation ends the run, there is no next stage.
+                return std::make_unique<ninja>(root(), environment(), *dir);
+            }
+            if (auto dir = compile_profile_dir(); dir.has_value() && std::filesystem::is_regular_file(*dir / "build.ninja")) {
+                // The profiled build ends the run too, ninja reports where the compilers spent their time.
+                return std::make_unique<ninja>(root(), environment(), *dir);
+            }
             next_task = task_type::build;
             break;
         case task_type::build:
             next_task = task_type::test;
+            break;
+        case task_type::test:
+            if (auto dir = binary_dir(); dir.has_value()) {
+                return std::make_unique<bench>(root(), environment(), *dir, my_presets);
+            }
+            return bench::create(root(), environment());
         default:
             break;
         }
@@ -219,7 +558,7 @@ private:
         if (next_task == task_type::DONE) {
             return {};
         }
-        return std::make_unique<cmake_preset>(next_task, root(), environment());
+        return std::make_unique<cmake_preset>(next_task, root(), environment(), my_presets);
     }
 
     std::string get_name() const override
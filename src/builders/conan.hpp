@@ -3,6 +3,9 @@
 
 #include "../builder.hpp"
 #include "../builders/cmake_preset.hpp"
+#include "../conan_install_report.hpp"
+#include "../metrics.hpp"
+#include "../state.hpp"
 #include "json.hpp"
 #include "tasks.hpp"
 #include <unistd.h>
@@ -365,16 +368,49 @@ struct conan : basic_builder<conan_spec, conan>
         return true;
     }
 
-    arguments_type get_arguments(std::string_view) const override
+    arguments_type get_arguments(targets_type) const override
     {
         return std::vector{ "install"s,
                             "--build=missing"s,
                             "--profile:all="s + std::string{ current_profile.name },
                             "-s"s,
                             "build_type="s + to_string(current_build_type),
+                            "--format"s,
+                            "json"s,
                             root().path().string() };
     }
 
+    /// Streams the log to time each package, while the graph printed at the end is collected.
+    execution_result execute_step(std::string command, arguments_type arguments) const override
+    {
+        auto report = conan_install_report{};
+        auto result = execution_result{};
+        auto graph  = std::string{};
+
+        result.exit_code =
+            root().stream_lines(command, arguments, environment(), root().path(), [&](std::string_view line, std_io stream) {
+                if (stream == std_io::OUT) {
+                    graph += line;
+                    graph += '\n';
+                    return;
+                }
+                root().emit(line, stream);
+                report.add_log_line(line);
+                if (conan_install_report::is_error(line)) {
+                    result.error_output.emplace_back(line);
+                }
+            });
+        result.status    = result.exit_code != 0 ? execution_result::FAILURE : execution_result::SUCCESS;
+        if (auto parsed = nlohmann::json::parse(graph, nullptr, false); !parsed.is_discarded()) {
+            write_atomically(state_dir(root().path() / current_profile.build_dir) / "conan-graph.json", graph);
+            report.add_graph(parsed);
+            result.output = report.summary();
+            result.metrics[std::string{ metric::CONAN_BUILT_FROM_SOURCE }] =
+                static_cast<double>(report.built_from_source().size());
+        }
+        return result;
+    }
+
     builder_base::ptr get_next_builder() const override
     {
         return std::make_unique<cmake_preset>(task_type::configuration, root(), environment());
@@ -0,0 +1,280 @@
+#ifndef INCLUDED_GIT_SUBMODULE_HPP
+#define INCLUDED_GIT_SUBMODULE_HPP
+
+#include "../builder.hpp"
+#include "../state.hpp"
+#include "../worktree.hpp"
+#include "tasks.hpp"
+#include <util/environment.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace vb::maker::builders {
+
+using namespace std::literals;
+
+namespace details {
+
+/// Paths of the submodules declared in a `.gitmodules` file.
+inline std::vector<std::string> submodule_paths(std::string_view gitmodules)
+{
+    auto result = std::vector<std::string>{};
+    auto input  = std::istringstream{ std::string{ gitmodules } };
+    for (auto line = std::string{}; std::getline(input, line);) {
+        auto text = std::string_view{ line };
+        text.remove_prefix(std::min(text.find_first_not_of(" \t"sv), text.size()));
+        if (!text.starts_with("path"sv)) {
+            continue;
+        }
+        auto equal = text.find('=');
+        if (equal == text.npos || text.substr(4, equal - 4).find_first_not_of(" \t"sv) != text.npos) {
+            continue;
+        }
+        auto value = text.substr(equal + 1);
+        value.remove_prefix(std::min(value.find_first_not_of(" \t"sv), value.size()));
+        value = value.substr(0, value.find_last_not_of(" \t\r"sv) + 1);
+        result.emplace_back(value);
+    }
+    return result;
+}
+
+/// Commits recorded for the submodules in a git index, by path.
+///
+/// The entries of the submodules are the gitlinks, mode `160000`. Index versions 2 to 4 are read, for SHA-1
+/// repositories.
+inline std::map<std::string, std::string, std::less<>> gitlinks(std::string_view index)
+{
+    static constexpr auto HASH_SIZE  = std::size_t{ 20 };
+    static constexpr auto PATH_START = std::size_t{ 62 };
+    static constexpr auto GITLINK    = std::uint32_t{ 0160000 };
+    static constexpr auto EXTENDED   = std::uint16_t{ 0x4000 };
+
+    auto result = std::map<std::string, std::string, std::less<>>{};
+    auto number = [&](std::size_t at, std::size_t size) {
+        auto value = std::uint32_t{};
+        for (auto byte : index.substr(at, size)) {
+            value = (value << 8) | static_cast<unsigned char>(byte);
+        }
+        return value;
+    };
+
+    if (index.size() < 12 || !index.starts_with("DIRC"sv)) {
+        return result;
+    }
+    auto version  = number(4, 4);
+    auto count    = number(8, 4);
+    auto at       = std::size_t{ 12 };
+    auto previous = std::string{};
+
+    for (auto entry = std::uint32_t{ 0 }; entry < count && at + PATH_START < index.size(); ++entry) {
+        auto mode  = number(at + 24, 4);
+        auto hash  = index.substr(at + 40, HASH_SIZE);
+        auto flags = number(at + 60, 2);
+        auto start = at + PATH_START + ((version >= 3 && (flags & EXTENDED) != 0) ? 2 : 0);
+
+        auto path = std::string{};
+        if (version >= 4) {
+            // The path only stores what differs from the previous one, after the length to drop from it.
+            auto drop = std::size_t{ static_cast<unsigned char>(index[start]) & 0x7fU };
+            while ((static_cast<unsigned char>(index[start]) & 0x80U) != 0) {
+                ++start;
+                drop = ((drop + 1) << 7) | (static_cast<unsigned char>(index[start]) & 0x7fU);
+            }
+            ++start;
+            auto end = index.find('\0', start);
+            if (end == index.npos) {
+                break;
+            }
+            path = previous.substr(0, previous.size() - std::min(drop, previous.size()));
+            path += index.substr(start, end - start);
+            at = end + 1;
+        } else {
+            auto end = index.find('\0', start);
+            if (end == index.npos) {
+                break;
+            }
+            path = index.substr(start, end - start);
+            // Entries are padded with 1 to 8 NULs to a multiple of 8 bytes.
+            at += (end - at + 8) & ~std::size_t{ 7 };
+        }
+
+        if ((mode & 0170000) == GITLINK) {
+            auto hex = std::string{};
+            for (auto byte : hash) {
+                hex += std::format("{:02x}", static_cast<unsigned char>(byte));
+            }
+            result.insert_or_assign(path, std::move(hex));
+        }
+        previous = std::move(path);
+    }
+    return result;
+}
+
+inline std::string first_line(const std::filesystem::path& file)
+{
+    auto content = read_file(file);
+    return content.substr(0, content.find_first_of("\r\n"sv));
+}
+
+/// The commit checked out in the git directory `dir`, following `HEAD` if it is a branch.
+inline std::string head_commit(const std::filesystem::path& dir)
+{
+    static constexpr auto REF_PREFIX = "ref: "sv;
+
+    auto head = first_line(dir / "HEAD");
+    if (!head.starts_with(REF_PREFIX)) {
+        return head;
+    }
+
+    auto ref = head.substr(REF_PREFIX.size());
+    if (auto loose = first_line(dir / ref); !loose.empty()) {
+        return loose;
+    }
+    auto packed = std::istringstream{ read_file(dir / "packed-refs") };
+    for (auto line = std::string{}; std::getline(packed, line);) {
+        if (line.size() > ref.size() && line.ends_with(ref) && line[line.size() - ref.size() - 1] == ' ') {
+            return line.substr(0, line.find(' '));
+        }
+    }
+    return {};
+}
+
+/// True if every submodule of the checkout in `root`, and theirs, is at the commit recorded for it.
+///
+/// Only files are read: the gitlinks from the index and the `HEAD` of each submodule.
+inline bool submodules_up_to_date(const std::filesystem::path& root)
+{
+    auto dir = git_dir(root);
+    if (!dir.has_value()) {
+        return false;
+    }
+
+    auto recorded = gitlinks(read_file(*dir / "index"));
+    for (const auto& path : submodule_paths(read_file(root / ".gitmodules"))) {
+        auto commit = recorded.find(path);
+        if (commit == recorded.end()) {
+            continue;
+        }
+        auto checkout = root / path;
+        auto module   = git_dir(checkout);
+        if (!module.has_value() || head_commit(*module) != commit->second) {
+            return false;
+        }
+        if (std::filesystem::is_regular_file(checkout / ".gitmodules") && !submodules_up_to_date(checkout)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace details
+
+struct git_submodule_spec
+{
+    static constexpr auto stage       = task_type::pre_requisites;
+    static constexpr auto name        = "git submodules"sv;
+    static constexpr auto build_file  = ".gitmodules"sv;
+    static constexpr auto command     = "git"sv;
+    static constexpr auto import_vars = std::array{ "VMK_GIT_REFERENCE" };
+};
+
+/// Checks out the submodules at the commits recorded in the superproject, all at once.
+///
+/// The objects are borrowed from a local repository shared by every checkout on the machine (`VMK_GIT_REFERENCE`, by
+/// default `$XDG_CACHE_HOME/vmk/git-reference`), and the commits fetched are added to it afterwards. A fresh clone or
+/// worktree then finds most objects locally. The submodules copy what they borrowed, so the cache can be pruned or
+/// deleted without breaking them.
+struct git_submodule : basic_builder<git_submodule_spec, git_submodule>
+{
+    using parent = basic_builder<git_submodule_spec, git_submodule>;
+    using parent::create;
+
+    static constexpr auto REFERENCE_VAR = "VMK_GIT_REFERENCE"sv;
+
+    git_submodule(work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+    {
+    }
+
+    std::filesystem::path reference_repository() const
+    {
+        auto configured = value_of(environment(), REFERENCE_VAR);
+        return configured.empty() ? xdg_cache_home() / "vmk" / "git-reference" : std::filesystem::path{ configured };
+    }
+
+private:
+
+    bool get_required() const override
+    {
+        return !details::submodules_up_to_date(root().path());
+    }
+
+    arguments_type get_arguments(targets_type) const override
+    {
+        auto jobs = std::max(std::thread::hardware_concurrency(), 1U);
+        return { "submodule"s, "update"s, "--init"s, "--recursive"s, "--jobs"s, std::to_string(jobs),
+                 "--reference"s, reference_repository().string(), "--dissociate"s };
+    }
+
+    /// The recorded commits are in the index, a checkout of another commit changes them.
+    std::vector<fs::path> get_inputs() const override
+    {
+        auto result = parent::get_inputs();
+        if (auto dir = git_dir(root().path()); dir.has_value()) {
+            result.push_back(*dir / "index");
+        }
+        return result;
+    }
+
+    /// The stage of the project itself, after the submodules.
+    builder_base::ptr get_next_builder() const override;
+
+    execution_result execute_step(std::string command, arguments_type arguments) const override
+    {
+        auto reference = reference_repository();
+        if (!std::filesystem::is_directory(reference / "objects")) {
+            std::filesystem::create_directories(reference);
+            auto init = std::array{ "init"s, "--quiet"s, "--bare"s, reference.string() };
+            if (auto created = root().execute(command, init, environment()); !created) {
+                return created;
+            }
+        }
+
+        auto result = parent::execute_step(command, arguments);
+        if (result) {
+            remember_objects(command, reference);
+        }
+        return result;
+    }
+
+    /// Fetches the commits of the submodules into the reference repository, from their local copies.
+    void remember_objects(const std::string& command, const std::filesystem::path& reference) const
+    {
+        for (const auto& path : details::submodule_paths(read_file(root().path() / build_file))) {
+            auto module = git_dir(root().path() / path);
+            if (!module.has_value()) {
+                continue;
+            }
+            auto commit = details::head_commit(*module);
+            auto fetch  = std::array{ "-C"s, reference.string(), "fetch"s, "--quiet"s, "--no-tags"s, module->string(),
+                                     std::format("+HEAD:refs/vmk/{}", commit) };
+            root().execute(command, fetch, environment());
+        }
+    }
+};
+
+} // namespace vb::maker::builders
+
+#endif // INCLUDED_GIT_SUBMODULE_HPP
@@ -0,0 +1,257 @@
+#ifndef INCLUDED_GRADLE_HPP
+#define INCLUDED_GRADLE_HPP
+
+#include "../builder.hpp"
+#include "../html_table.hpp"
+#include "../tasks.hpp"
+#include "../work_directory.hpp"
+#include "../worktree.hpp"
+#include <util/environment.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace vb::maker::builders {
+
+using namespace std::literals;
+
+struct gradle_spec
+{
+    static constexpr auto stage       = task_type::DYNAMIC;
+    static constexpr auto stages      = std::array{ task_type::build, task_type::test };
+    static constexpr auto name        = "gradle"sv;
+    static constexpr auto build_file  = std::array{ "gradlew"sv };
+    static constexpr auto command     = "./gradlew"sv;
+    static constexpr auto import_vars = std::array{ "JAVA_HOME",    "GRADLE_USER_HOME", "GRADLE_OPTS",
+                                                    "ANDROID_HOME", "ANDROID_SDK_ROOT" };
+};
+
+namespace details {
+
+/// Phases of the summary tab of a `--profile` report, in the order gradle runs them.
+inline constexpr auto gradle_profile_phases = std::array{
+    "Total Build Time"sv,  "Startup"sv,           "Settings and buildSrc"sv, "Loading Projects"sv,
+    "Configuring Projects"sv, "Artifact Transforms"sv, "Task Execution"sv
+};
+
+/// Extracts the phase timings from a gradle `--profile` HTML report.
+inline std::vector<std::pair<std::string, std::string>> gradle_profile_summary(const std::vector<table_row>& rows)
+{
+    auto result = std::vector<std::pair<std::string, std::string>>{};
+    for (auto phase : gradle_profile_phases) {
+        auto found = std::ranges::find_if(rows, [&](const auto& row) {
+            return row.size() >= 2 && row.front() == phase;
+        });
+        if (found != std::end(rows)) {
+            result.emplace_back(std::string{ phase }, found->at(1));
+        }
+    }
+    return result;
+}
+
+/// Removes all but the `keep` newest `--profile` reports of `dir`, gradle writes a new one on every run.
+inline std::size_t prune_gradle_profiles(const std::filesystem::path& dir, std::size_t keep)
+{
+    auto reports = std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>>{};
+    auto error   = std::error_code{};
+    for (const auto& entry : std::filesystem::directory_iterator{ dir, error }) {
+        if (entry.path().extension() == ".html") {
+            reports.emplace_back(entry.last_write_time(error), entry.path());
+        }
+    }
+    if (reports.size() <= keep) {
+        return 0;
+    }
+
+    std::ranges::sort(reports, std::ranges::greater{});
+    auto removed = std::size_t{ 0 };
+    for (const auto& [_, report] : reports | std::views::drop(keep)) {
+        removed += std::filesystem::remove(report, error) ? 1 : 0;
+    }
+    return removed;
+}
+
+} // namespace details
+
+class gradle : public basic_builder<gradle_spec, gradle>
+{
+public:
+
+    using parent = basic_builder<gradle_spec, gradle>;
+    using parent::create;
+
+    /// Keep the daemon for 3 hours, so that it survives between edits.
+    static constexpr auto DAEMON_IDLE_TIMEOUT = "-Dorg.gradle.daemon.idletimeout=10800000"sv;
+    static constexpr auto PROFILE_DIR         = "build/reports/profile"sv;
+    static constexpr auto INIT_SCRIPT         = "vmk-build-cache.init.gradle"sv;
+    static constexpr auto PROFILES_KEPT       = std::size_t{ 10 };
+
+    static constexpr auto performance_arguments =
+        std::array{ "--daemon"sv, "--configuration-cache"sv, "--build-cache"sv, "--parallel"sv, "--profile"sv };
+
+private:
+
+    task_type my_task = task_type::build;
+
+    static std::filesystem::path build_cache_dir()
+    {
+        return xdg_cache_home() / "vmk" / "gradle-build-cache";
+    }
+
+    static std::filesystem::path build_cache_init_script()
+    {
+        return build_cache_dir().parent_path() / INIT_SCRIPT;
+    }
+
+    /// Writes the init script placing the local build cache under `XDG_CACHE_HOME`.
+    ///
+    /// The local cache directory can only be configured in the settings, an init script does that without touching
+    /// the project. It is only rewritten when it changes, since it is an input of the configuration cache.
+    static void write_build_cache_init_script()
+    {
+        auto cache_dir = build_cache_dir();
+        std::filesystem::create_directories(cache_dir);
+
+        auto escaped = std::string{};
+        for (auto c : cache_dir.string()) {
+            if (c == '\\' || c == '\'') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(c);
+        }
+
+        auto content = std::format(
+            "settingsEvaluated {{ settings ->\n"
+            "    settings.buildCache {{\n"
+            "        local {{\n"
+            "            directory = new File('{}')\n"
+            "        }}\n"
+            "    }}\n"
+            "}}\n",
+            escaped);
+
+        auto script  = build_cache_init_script();
+        auto current = std::ostringstream{};
+        if (std::filesystem::is_regular_file(script)) {
+            current << std::ifstream{ script }.rdbuf();
+        }
+        if (current.view() != content) {
+            std::ofstream{ script } << content;
+        }
+    }
+
+    /// Latest `--profile` report of the root project.
+    std::filesystem::path latest_profile() const
+    {
+        auto dir    = root().path() / PROFILE_DIR;
+        auto result = std::filesystem::path{};
+        if (!std::filesystem::is_directory(dir)) {
+            return result;
+        }
+
+        auto newest = std::filesystem::file_time_type::min();
+        for (const auto& entry : std::filesystem::directory_iterator{ dir }) {
+            if (entry.path().extension() == ".html" && entry.last_write_time() > newest) {
+                newest = entry.last_write_time();
+                result = entry.path();
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::string> profile_summary() const
+    {
+        auto report = latest_profile();
+        if (report.empty()) {
+            return {};
+        }
+
+        auto result = std::vector<std::string>{};
+        for (const auto& [phase, duration] : details::gradle_profile_summary(read_html_table(report))) {
+            result.push_back(std::format("⏱ {}: {}", phase, duration));
+        }
+        result.push_back(std::format("⏱ report: {}", report.string()));
+        return result;
+    }
+
+public:
+
+    gradle(work_dir wd, env::environment::optional env_)
+        : gradle{ task_type::build, wd, env_ }
+    {
+    }
+
+    gradle(task_type current_stage, work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+        , my_task{ current_stage }
+    {
+    }
+
+private:
+
+    Stage get_stage() const override
+    {
+        return Stage{ my_task };
+    }
+
+    arguments_type get_arguments(targets_type targets) const override
+    {
+        auto task = my_task == task_type::test ? "test"s : "assemble"s;
+
+        auto result = arguments_type{};
+        if (targets.empty()) {
+            result.push_back(task);
+        }
+        for (auto target : targets) {
+            result.push_back(std::format(":{}:{}", target, task));
+        }
+
+        std::ranges::copy(transform_args(performance_arguments), std::back_inserter(result));
+        result.push_back(std::string{ DAEMON_IDLE_TIMEOUT });
+        result.push_back("--init-script"s);
+        result.push_back(build_cache_init_script().string());
+        return result;
+    }
+
+    execution_result execute_step(std::string target, arguments_type arguments) const override
+    {
+        write_build_cache_init_script();
+        auto result = parent::execute_step(target, arguments);
+
+        if (result) {
+            std::ranges::copy(profile_summary(), std::back_inserter(result.output));
+        }
+        details::prune_gradle_profiles(root().path() / PROFILE_DIR, PROFILES_KEPT);
+        return result;
+    }
+
+    builder_base::ptr get_next_builder() const override
+    {
+        if (my_task != task_type::build) {
+            return nullptr;
+        }
+        return std::make_unique<gradle>(task_type::test, root(), environment());
+    }
+
+    std::string get_name() const override
+    {
+        return std::format("{} «{}»", gradle_spec::name, my_task);
+    }
+};
+
+} // namespace vb::maker::builders
+
+#endif // INCLUDED_GRADLE_HPP
@@ -0,0 +1,145 @@
+#ifndef INCLUDED_INSTALL_HPP
+#define INCLUDED_INSTALL_HPP
+
+#include "../builder.hpp"
+#include "../install_tree.hpp"
+#include "../state.hpp"
+#include "../tasks.hpp"
+#include <util/environment.hpp>
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vb::maker::builders {
+
+using namespace std::literals;
+
+struct install_spec
+{
+    static constexpr auto stage       = task_type::install;
+    static constexpr auto name        = "install"sv;
+    static constexpr auto build_file  = std::array{ "CMakeLists.txt"sv, "meson.build"sv };
+    static constexpr auto command     = "cmake"sv;
+    static constexpr auto build_dir   = true;
+    static constexpr auto import_vars = std::array{ "CMAKE_BUILD_TYPE", "DESTDIR", "VMK_INSTALL", "VMK_INSTALL_STRIP" };
+};
+
+/// Installs the build with `cmake --install` or `meson install`, through a staging tree.
+///
+/// Only runs when asked for with `---install`. The tool installs into `«build dir»/.vmk/install`, where it only
+/// rewrites the files that changed, the debug information is stripped or split there on all the cores, and the tree
+/// is then placed under `DESTDIR`, or `/`, as reflinks or copies, never as hard links into the staging tree.
+struct install : basic_builder<install_spec, install>
+{
+    using parent = basic_builder<install_spec, install>;
+    using parent::create;
+
+    static constexpr auto ENABLE_VAR = "VMK_INSTALL"sv;
+    static constexpr auto STRIP_VAR  = "VMK_INSTALL_STRIP"sv;
+    static constexpr auto STAGING    = "install"sv;
+
+    install(work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+    {
+    }
+
+    /// Installs the build in `build_dir`, that of a preset, instead of the one `BUILD_DIR` names.
+    install(work_dir wd, env::environment::optional env_, std::filesystem::path build_dir)
+        : basic_builder{ wd, env_ }
+        , my_build_dir{ std::move(build_dir) }
+    {
+    }
+
+    /// Enables the stage, `---install --strip` or `---install --split-debug` select what happens to the debug
+    /// information.
+    static void apply(env::environment& env, const std::vector<std::string_view>& options)
+    {
+        env.set(ENABLE_VAR) = "1";
+        for (auto option : options) {
+            if (option == "--strip"sv) {
+                env.set(STRIP_VAR) = "strip";
+            } else if (option == "--split-debug"sv) {
+                env.set(STRIP_VAR) = "split";
+            }
+        }
+    }
+
+private:
+
+    std::optional<std::filesystem::path> my_build_dir;
+
+    std::filesystem::path build_dir() const
+    {
+        return my_build_dir.value_or(build_dir_path());
+    }
+
+    bool is_meson() const
+    {
+        return std::filesystem::is_directory(build_dir() / "meson-info");
+    }
+
+    std::filesystem::path staging() const
+    {
+        return state_path(build_dir()) / STAGING;
+    }
+
+    bool get_required() const override
+    {
+        return !value_of(environment(), ENABLE_VAR).empty();
+    }
+
+    std::string get_command(targets_type) const override
+    {
+        return is_meson() ? "meson"s : "cmake"s;
+    }
+
+    arguments_type get_arguments(targets_type) const override
+    {
+        if (is_meson()) {
+            return { "install"s, "-C"s, build_dir().string(), "--no-rebuild"s, "--destdir"s, staging().string() };
+        }
+        auto result = arguments_type{ "--install"s, build_dir().string() };
+        if (auto configuration = value_of(environment(), "CMAKE_BUILD_TYPE"); !configuration.empty()) {
+            result.push_back("--config"s);
+            result.push_back(configuration);
+        }
+        return result;
+    }
+
+    execution_result execute_step(std::string command, arguments_type arguments) const override
+    {
+        auto env           = environment();
+        env.set("DESTDIR") = staging().string();
+        auto result        = root().execute(command, arguments, env);
+        if (!result) {
+            return result;
+        }
+
+        auto destination = value_of(environment(), "DESTDIR");
+        auto errors      = std::vector<std::string>{};
+        auto mode        = install_tree::mode_of(value_of(environment(), STRIP_VAR));
+        auto stripped    = install_tree::strip(staging(), mode, errors);
+        auto placed      = install_tree::sync(staging(), destination.empty() ? "/"s : destination);
+        placed.stripped  = stripped;
+        for (auto& error : errors) {
+            placed.errors.push_back(std::move(error));
+        }
+
+        result.output.push_back(placed.summary());
+        if (!placed.errors.empty()) {
+            result.status       = execution_result::FAILURE;
+            result.exit_code    = 1;
+            result.error_output = std::move(placed.errors);
+        }
+        return result;
+    }
+};
+
+}
+
+#endif // INCLUDED_INSTALL_HPP
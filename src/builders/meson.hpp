@@ -2,10 +2,28 @@
 #ifndef INCLUDED_MESON_HPP
 #define INCLUDED_MESON_HPP
 
+#include "bench.hpp"
 #include "builder.hpp"
 #include "ninja.hpp"
+#include "../hash.hpp"
+#include "../metrics.hpp"
+#include "../state.hpp"
+#include "../worktree_sharing.hpp"
+#include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
 namespace vb::maker::builders {
 
 struct meson_spec
@@ -18,24 +36,256 @@ struct meson_spec
     static constexpr auto creates = builder_base::COMPILE_COMMANDS;
 };
 
+struct meson_test_spec
+{
+    static constexpr auto stage       = task_type::test;
+    static constexpr auto name        = "Meson test"sv;
+    static constexpr auto build_file  = "meson.build"sv;
+    static constexpr auto command     = "meson"sv;
+    static constexpr auto build_dir   = true;
+    static constexpr auto import_vars = std::array{ "MESON_TESTTHREADS" };
+};
+
+/// Runs `meson test`, skipping tests whose executable did not change since they last passed.
+///
+/// The tests are read from the introspection data in `meson-info/intro-tests.json`, the same that
+/// `meson introspect --tests` prints, and the outcome of each run from `meson-logs/testlog.json`.
+struct meson_test : basic_builder<meson_test_spec, meson_test>
+{
+    using parent = basic_builder<meson_test_spec, meson_test>;
+    using parent::create;
+
+    static constexpr auto INTROSPECTION = "meson-info/intro-tests.json"sv;
+    static constexpr auto TEST_LOG      = "meson-logs/testlog.json"sv;
+    static constexpr auto STATE_FILE    = "meson-tests.json"sv;
+
+    struct test_info
+    {
+        std::string name;
+        std::string fingerprint;
+    };
+
+    struct test_state
+    {
+        std::string fingerprint;
+        double      duration = 0.0;
+        bool        passed   = false;
+    };
+
+    using state_type = std::map<std::string, test_state>;
+
+    meson_test(work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+    {
+    }
+
+private:
+
+    mutable std::optional<std::vector<test_info>> my_tests;
+
+    /// Identifies the executable and command line of a test, changes whenever the test is relinked.
+    static std::string test_fingerprint(const nlohmann::json& command)
+    {
+        auto result = fingerprint{};
+        for (const auto& arg : command) {
+            result.add(arg.get<std::string>());
+        }
+
+        if (!command.empty()) {
+            auto executable = std::filesystem::path{ command.front().get<std::string>() };
+            auto error      = std::error_code{};
+            if (auto size = std::filesystem::file_size(executable, error); !error) {
+                result.add(static_cast<std::uint64_t>(size));
+            }
+            if (auto time = std::filesystem::last_write_time(executable, error); !error) {
+                result.add(static_cast<std::uint64_t>(time.time_since_epoch().count()));
+            }
+        }
+        return result.hex();
+    }
+
+    /// The introspection data is only read once per run.
+    const std::vector<test_info>& tests() const
+    {
+        if (my_tests.has_value()) {
+            return *my_tests;
+        }
+
+        my_tests.emplace();
+        auto introspection = get_build_dir() / INTROSPECTION;
+        if (!std::filesystem::is_regular_file(introspection)) {
+            return *my_tests;
+        }
+
+        for (const auto& test : nlohmann::json::parse(std::ifstream{ introspection })) {
+            my_tests->push_back(test_info{ test.at("name").get<std::string>(), test_fingerprint(test.at("cmd")) });
+        }
+        return *my_tests;
+    }
+
+    state_type load_state() const
+    {
+        auto file   = state_dir(get_build_dir()) / STATE_FILE;
+        auto result = state_type{};
+        if (!std::filesystem::is_regular_file(file)) {
+            return result;
+        }
+
+        auto content = nlohmann::json::parse(std::ifstream{ file }, nullptr, false);
+        if (content.is_discarded()) {
+            return result;
+        }
+
+        for (const auto& [name, entry] : content.items()) {
+            result.emplace(
+                name,
+                test_state{ entry.value("fingerprint", ""s), entry.value("duration", 0.0), entry.value("passed", false) });
+        }
+        return result;
+    }
+
+    void save_state(const state_type& state) const
+    {
+        auto content = nlohmann::json::object();
+        for (const auto& [name, entry] : state) {
+            content[name] = { { "fingerprint", entry.fingerprint },
+                              { "duration", entry.duration },
+                              { "passed", entry.passed } };
+        }
+        write_atomically(state_dir(get_build_dir()) / STATE_FILE, content.dump(1));
+    }
+
+    /// Tests that must run, in the order of the introspection data; meson runs them by their `priority`, and then in
+    /// that order, whatever order they are named in.
+    ///
+    /// When targets are given only the tests with the same names are considered.
+    std::vector<std::string> selected_tests(targets_type targets) const
+    {
+        auto state    = load_state();
+        auto selected = std::vector<std::string>{};
+
+        for (const auto& test : tests()) {
+            if (!targets.empty() && !std::ranges::contains(targets, std::string_view{ test.name })) {
+                continue;
+            }
+
+            auto previous = state.find(test.name);
+            if (previous == state.end() || !previous->second.passed ||
+                previous->second.fingerprint != test.fingerprint) {
+                selected.push_back(test.name);
+            }
+        }
+        return selected;
+    }
+
+    std::string test_processes() const
+    {
+        if (auto threads = value_of(environment(), "MESON_TESTTHREADS"); !threads.empty()) {
+            return threads;
+        }
+        return std::to_string(std::max(1U, std::thread::hardware_concurrency()));
+    }
+
+    /// Records the outcome of the tests that ran from meson's own log.
+    state_type update_state(const std::vector<std::string>& ran) const
+    {
+        auto state = load_state();
+        auto log   = std::ifstream{ get_build_dir() / TEST_LOG };
+
+        for (auto line = std::string{}; std::getline(log, line);) {
+            auto entry = nlohmann::json::parse(line, nullptr, false);
+            if (entry.is_discarded() || !entry.contains("name")) {
+                continue;
+            }
+
+            auto name = entry["name"].get<std::string>();
+            if (std::ranges::find(ran, name) == ran.end()) {
+                continue;
+            }
+
+            auto found = std::ranges::find(tests(), name, &test_info::name);
+            if (found == tests().end()) {
+                continue;
+            }
+
+            auto result   = entry.value("result", ""s);
+            state[name] = test_state{ found->fingerprint,
+                                      entry.value("duration", 0.0),
+                                      result == "OK" || result == "EXPECTEDFAIL" || result == "SKIP" };
+        }
+        return state;
+    }
+
+    bool get_required() const override
+    {
+        return !tests().empty() && !selected_tests({}).empty();
+    }
+
+    arguments_type get_arguments(targets_type targets) const override
+    {
+        auto result = arguments_builder(
+            "test"sv, "-C"sv, get_build_dirname(environment()), "--no-rebuild"sv, "--num-processes"sv,
+            test_processes());
+        std::ranges::copy(selected_tests(targets), std::back_inserter(result));
+        return result;
+    }
+
+    execution_result execute_step(std::string target, arguments_type arguments) const override
+    {
+        auto ran = std::ranges::to<std::vector>(arguments | std::views::filter([&](const auto& argument) {
+                                                     return std::ranges::contains(tests(), argument, &test_info::name);
+                                                 }));
+        if (ran.empty()) {
+            // Without test names meson would run all of them.
+            auto result = execution_result{ execution_result::SUCCESS };
+            result.output.push_back(std::format("🧪 no test to run, {} skipped as unchanged", tests().size()));
+            return result;
+        }
+
+        // A log left by an earlier run would be read as the outcome of this one.
+        auto error = std::error_code{};
+        std::filesystem::remove(get_build_dir() / TEST_LOG, error);
+        auto result = parent::execute_step(target, arguments);
+
+        auto state = update_state(ran);
+        save_state(state);
+
+        auto failed = std::ranges::count_if(ran, [&](const auto& name) {
+            auto found = state.find(name);
+            return found == state.end() || !found->second.passed;
+        });
+        result.output.push_back(std::format(
+            "🧪 {} tests ran, {} skipped as unchanged, {} failed", ran.size(), tests().size() - ran.size(), failed));
+        result.metrics[std::string{ metric::TESTS }]        = static_cast<double>(ran.size());
+        result.metrics[std::string{ metric::TESTS_FAILED }] = static_cast<double>(failed);
+        return result;
+    }
+
+    builder_base::ptr get_next_builder() const override
+    {
+        return bench::create(root(), environment());
+    }
+};
+
 struct meson : basic_builder<meson_spec, meson>
 {
     using basic_builder<meson_spec, meson>::create;
 
     meson(work_dir wd, env::environment::optional env_)
         : basic_builder{ wd, env_ }
-    {}
+    {
+        worktree_sharing::apply(environment(), root().path());
+    }
 
 private:
-    arguments_type get_arguments(std::string_view) const override  {
+    arguments_type get_arguments(targets_type) const override  {
         return arguments_builder("setup", get_build_dirname(environment()));
     }
 
     // TODO: This is duplicate code.
     builder_base::ptr get_next_builder() const override
     {
-        auto new_env = environment();
-        return builder_base::ptr{std::make_unique<ninja>(root(), environment(), get_build_dir())};
+        return builder_base::ptr{std::make_unique<ninja>(root(), environment(), get_build_dir(), meson_test::create)};
     }
 };
 
@@ -2,10 +2,24 @@
 #define INCLUDED_NINJA_HPP
 
 #include "../builder.hpp"
+#include "../compile_profile.hpp"
+#include "../explain.hpp"
+#include "../metrics.hpp"
+#include "../output_cache.hpp"
 #include "tasks.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <ranges>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace vb::maker::builders {
 
@@ -18,7 +32,7 @@ struct ninja_spec
     static constexpr std::string_view name        = "ninja";
     static constexpr std::string_view build_file  = "build.ninja";
     static constexpr std::string_view command     = "ninja";
-    static constexpr auto             import_vars = std::array{ "BUILD_TARGET", "NINJA_FILE" };
+    static constexpr auto             import_vars = std::array{ "BUILD_TARGET", "NINJA_FILE", "VMK_NINJA_EXPLAIN", "VMK_OUTPUT_CACHE", "VMK_PROFILE_COMPILE" };
 };
 
 struct ninja : basic_builder<ninja_spec, ninja>
@@ -26,7 +40,8 @@ struct ninja : basic_builder<ninja_spec, ninja>
     using parent = basic_builder<ninja_spec, ninja>;
     using basic_builder<ninja_spec, ninja>::create;
 
-    static constexpr auto BUILD_FILE_VAR = "NINJA_FILE";
+    static constexpr auto BUILD_FILE_VAR   = "NINJA_FILE";
+    static constexpr auto OUTPUT_CACHE_VAR = "VMK_OUTPUT_CACHE";
 
     fs::path build_file() const
     {
@@ -43,17 +58,190 @@ struct ninja : basic_builder<ninja_spec, ninja>
     }
 
 
-    ninja(work_dir wd, env::environment::optional env_,  std::filesystem::path work_dir) : 
+    ninja(work_dir wd, env::environment::optional env_,  std::filesystem::path work_dir, builder_base::factory next_step = nullptr) : 
         basic_builder{wd, env_.value_or(env::environment())},
-        my_working_dir{work_dir}
+        my_working_dir{work_dir},
+        my_next_step{next_step}
     {}
 
 private:
     std::optional<std::filesystem::path> my_working_dir{};
 
-    arguments_type get_arguments(std::string_view target) const override
+    /// Stage that follows the build, e.g. the tests of the generator that created the `build.ninja`.
+    builder_base::factory my_next_step = nullptr;
+
+    /// Cache of build outputs selected by `VMK_OUTPUT_CACHE`, only for build directories created by a generator.
+    cache_backend::ptr output_cache() const
+    {
+        if (!my_working_dir.has_value()) {
+            return nullptr;
+        }
+        auto cache = make_cache_backend(value_of(environment(), OUTPUT_CACHE_VAR));
+        if (cache) {
+            cache->report_to([this](std::string_view message) { root().emit(message); });
+        }
+        return cache;
+    }
+
+    /// `.ninja_log` gets one line per edge that ran, appended at the end.
+    fs::path ninja_log() const
     {
-        auto args = parent::arguments_builder(target);
+        return my_working_dir.value_or(root().path()) / ".ninja_log";
+    }
+
+    static constexpr auto SLOWEST_TARGETS = std::size_t{ 10 };
+
+    /// Lines appended to the log after `offset`, nothing if ninja recompacted it meanwhile.
+    static std::optional<std::vector<std::string>> log_entries_since(const fs::path& log, std::uintmax_t offset)
+    {
+        auto error = std::error_code{};
+        auto size  = fs::file_size(log, error);
+        if (error || size < offset) {
+            return std::nullopt;
+        }
+
+        auto input = std::ifstream{ log, std::ios::binary };
+        input.seekg(static_cast<std::streamoff>(offset));
+        auto result = std::vector<std::string>{};
+        for (auto line = std::string{}; std::getline(input, line);) {
+            // A new log starts with its version header.
+            if (!line.starts_with('#')) {
+                result.push_back(std::move(line));
+            }
+        }
+        return result;
+    }
+
+    /// The entries are `start end mtime output hash`, with times in milliseconds.
+    static std::vector<std::pair<std::string, double>> slowest_targets(const std::vector<std::string>& entries)
+    {
+        auto result = std::vector<std::pair<std::string, double>>{};
+        for (std::string_view entry : entries) {
+            auto fields = std::ranges::to<std::vector<std::string_view>>(
+                entry | std::views::split('\t') | std::views::transform([](auto field) {
+                    return std::string_view{ field.begin(), field.end() };
+                }));
+            if (fields.size() < 4) {
+                continue;
+            }
+            auto start = 0L;
+            auto end   = 0L;
+            std::from_chars(fields[0].data(), fields[0].data() + fields[0].size(), start);
+            std::from_chars(fields[1].data(), fields[1].data() + fields[1].size(), end);
+            result.emplace_back(std::string{ fields[3] }, static_cast<double>(end - start) / 1000.0);
+        }
+
+        auto count = std::min(result.size(), SLOWEST_TARGETS);
+        std::ranges::partial_sort(result, result.begin() + static_cast<std::ptrdiff_t>(count), std::ranges::greater{}, &std::pair<std::string, double>::second);
+        result.resize(count);
+        return result;
+    }
+
+    /// Set by `vmk explain`, empty otherwise.
+    std::string explain_mode() const
+    {
+        return value_of(environment(), rebuild_explanation::ENABLE_VAR);
+    }
+
+    /// Runs ninja and summarizes its explanations as they come, instead of keeping every line.
+    execution_result explain(const std::string& command, const arguments_type& arguments) const
+    {
+        auto explanation = rebuild_explanation{};
+        auto result      = execution_result{};
+
+        result.exit_code =
+            root().stream_lines(command, arguments, environment(), root().path(), [&](std::string_view line, std_io stream) {
+                if (stream == std_io::OUT) {
+                    root().emit(line);
+                } else if (!explanation.add(line)) {
+                    result.error_output.emplace_back(line);
+                }
+            });
+        result.status    = result.exit_code != 0         ? execution_result::FAILURE
+                         : result.error_output.empty() ? execution_result::SUCCESS
+                                                       : execution_result::SOFT_FAILURE;
+        result.output    = explanation.summary();
+        return result;
+    }
+
+    /// Runs ninja and aggregates the timings the compilers reported, the gcc reports as they come on the output and
+    /// the clang traces once the build is done.
+    execution_result profile_compile(const std::string& command, const arguments_type& arguments) const
+    {
+        auto profile = compile_profile{};
+        auto result  = execution_result{};
+
+        result.exit_code =
+            root().stream_lines(command, arguments, environment(), root().path(), [&](std::string_view line, std_io stream) {
+                if (stream == std_io::ERR || !profile.add_report_line(line)) {
+                    root().emit(line, stream);
+                }
+            });
+        result.status    = result.exit_code != 0 ? execution_result::FAILURE : execution_result::SUCCESS;
+        profile.merge(compile_profile::read_traces(compile_profile::find_traces(my_working_dir.value_or(root().path()))));
+        result.output = profile.summary();
+        return result;
+    }
+
+    execution_result execute_step(std::string target, arguments_type arguments) const override
+    {
+        if (!explain_mode().empty()) {
+            return explain(target, arguments);
+        }
+        if (!value_of(environment(), compile_profile::ENABLE_VAR).empty()) {
+            return profile_compile(target, arguments);
+        }
+
+        auto error      = std::error_code{};
+        auto log_offset = fs::file_size(ninja_log(), error);
+        if (error) {
+            log_offset = 0;
+        }
+
+        auto result = build(target, arguments);
+        if (auto entries = log_entries_since(ninja_log(), log_offset); entries.has_value()) {
+            result.metrics[std::string{ metric::NINJA_EDGES }] = static_cast<double>(entries->size());
+            result.slowest_targets = slowest_targets(*entries);
+        }
+        return result;
+    }
+
+    execution_result build(std::string target, arguments_type arguments) const
+    {
+        auto cache = output_cache();
+        if (!cache) {
+            return parent::execute_step(target, arguments);
+        }
+
+        auto key = output_cache_key(root().path(), *my_working_dir, environment());
+        if (key.has_value() && restore_outputs(*cache, *key, *my_working_dir)) {
+            root().emit(std::format("♻ restored build outputs for {}", *key));
+        }
+
+        auto result = parent::execute_step(target, arguments);
+        if (result) {
+            store_outputs(*cache, key, *my_working_dir);
+        }
+        return result;
+    }
+
+    std::optional<fs::path> get_build_directory(targets_type) const override
+    {
+        return my_working_dir;
+    }
+
+    builder_base::ptr get_next_builder() const override
+    {
+        if (my_next_step == nullptr) {
+            return nullptr;
+        }
+        return my_next_step(root(), environment());
+    }
+
+    /// All the targets go to the same ninja, so that it schedules them together.
+    arguments_type get_arguments(targets_type targets) const override
+    {
+        auto args = parent::arguments_builder();
         auto dir = my_working_dir.value_or(work_dir().path());
         if (my_working_dir.has_value() && build_file().empty()) {
             args.push_back("-C"s);
@@ -62,8 +250,15 @@ private:
             args.push_back("-f"s);
             args.push_back(work_dir().path() / build_file());
         }
-        if (!target.empty()) {
-            args.push_back(std::string{ target });
+        if (auto mode = explain_mode(); !mode.empty()) {
+            args.push_back("-d"s);
+            args.push_back("explain"s);
+            if (mode == rebuild_explanation::DRY_RUN) {
+                args.push_back("-n"s);
+            }
+        }
+        for (auto target : targets | std::views::filter([](auto target) { return !target.empty(); })) {
+            args.emplace_back(target);
         }
         return args;
     }
@@ -0,0 +1,309 @@
+#ifndef INCLUDED_PACKAGE_HPP
+#define INCLUDED_PACKAGE_HPP
+
+#include "../builder.hpp"
+#include "../cpack_report.hpp"
+#include "../state.hpp"
+#include "../tasks.hpp"
+#include "cmake_preset.hpp"
+#include "install.hpp"
+#include <util/environment.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace vb::maker::builders {
+
+using namespace std::literals;
+
+struct package_spec
+{
+    static constexpr auto stage       = task_type::package;
+    static constexpr auto name        = "cpack"sv;
+    static constexpr auto build_file  = "CMakeLists.txt"sv;
+    static constexpr auto command     = "cpack"sv;
+    static constexpr auto build_dir   = true;
+    static constexpr auto import_vars = std::array{ "CMAKE_BUILD_TYPE", "VMK_PACKAGE", "VMK_PACKAGE_GENERATORS" };
+};
+
+/// Packages a cmake project with cpack, the generators or package presets at the same time.
+///
+/// Only runs when asked for with `---package`. With package presets, the ones named as targets, or all of them, are
+/// used; otherwise the generators of `--generators=TGZ,DEB` or of the `CPackConfig.cmake` of the build. Each one is a
+/// cpack run of its own, and `CPACK_THREADS` shares the cores between them for the xz and zstd compression.
+struct package : basic_builder<package_spec, package>
+{
+    using parent = basic_builder<package_spec, package>;
+    using parent::create;
+
+    static constexpr auto ENABLE_VAR     = "VMK_PACKAGE"sv;
+    static constexpr auto GENERATORS_VAR = "VMK_PACKAGE_GENERATORS"sv;
+    static constexpr auto CONFIG         = "CPackConfig.cmake"sv;
+
+    package(work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+    {
+    }
+
+    /// Packages the build in `build_dir`, that of a preset, with the `presets` the earlier stages already read.
+    package(
+        work_dir                               wd,
+        env::environment::optional             env_,
+        std::filesystem::path                  build_dir,
+        std::shared_ptr<const presets_storage> presets)
+        : basic_builder{ wd, env_ }
+        , my_build_dir{ std::move(build_dir) }
+        , my_presets{ std::move(presets) }
+    {
+    }
+
+    /// Enables the stage, `---package --generators=TGZ,DEB` replaces the generators of the project.
+    ///
+    /// Returns the error for a generator given twice, its two runs would write over each other.
+    static std::optional<std::string> apply(env::environment& env, const std::vector<std::string_view>& options)
+    {
+        static constexpr auto generators = "--generators="sv;
+
+        env.set(ENABLE_VAR) = "1";
+        auto given = std::vector<std::string_view>{};
+        for (auto option : options) {
+            if (!option.starts_with(generators)) {
+                continue;
+            }
+            for (auto generator : option.substr(generators.size()) | std::views::split(',')) {
+                auto name = std::string_view{ generator };
+                if (name.empty()) {
+                    continue;
+                }
+                if (std::ranges::contains(given, name)) {
+                    return std::format("The cpack generator «{}» is given twice to ---package", name);
+                }
+                given.push_back(name);
+            }
+        }
+
+        if (!given.empty()) {
+            auto value = std::string{};
+            for (auto name : given) {
+                value += value.empty() ? std::string{ name } : std::format(",{}", name);
+            }
+            env.set(GENERATORS_VAR) = value;
+        }
+        return std::nullopt;
+    }
+
+private:
+
+    /// The options that start a run of their own, the others are shared by all of them.
+    static constexpr auto RUN_OPTIONS = std::array{ "--preset"sv, "-G"sv };
+
+    /// A cpack run, `--preset «name»` or `-G «generator»`, without option for the generators of the configuration.
+    struct run
+    {
+        std::string option;
+        std::string name;
+    };
+
+    std::optional<std::filesystem::path>           my_build_dir;
+    mutable std::shared_ptr<const presets_storage> my_presets;
+
+    /// Those of the earlier stages, or loaded on first use when the project was not built with presets.
+    const presets_storage& presets() const
+    {
+        if (!my_presets) {
+            my_presets = std::make_shared<const presets_storage>(
+                root().path() / cmake_preset::build_file[0], root().path() / cmake_preset::build_file[1]);
+        }
+        return *my_presets;
+    }
+
+    /// The build directory of the configure preset, or the one `BUILD_DIR` names.
+    std::filesystem::path build_dir() const
+    {
+        return my_build_dir.value_or(build_dir_path());
+    }
+
+    std::vector<std::string> package_presets(targets_type targets) const
+    {
+        auto all   = std::ranges::to<std::vector<std::string>>(presets().view_for(task_type::package));
+        auto named = std::ranges::to<std::vector<std::string>>(
+            all | std::views::filter([&](const auto& preset) { return std::ranges::contains(targets, preset); }));
+        return named.empty() ? all : named;
+    }
+
+    std::vector<std::string> generators() const
+    {
+        auto given = value_of(environment(), GENERATORS_VAR);
+        if (given.empty()) {
+            return cpack_report::generators_of(read_file(build_dir() / CONFIG));
+        }
+        auto result = std::vector<std::string>{};
+        for (auto generator : given | std::views::split(',')) {
+            if (!generator.empty()) {
+                result.emplace_back(std::string_view{ generator });
+            }
+        }
+        return result;
+    }
+
+    /// Where `current` works, the runs that would work in the same place follow each other.
+    cpack_report::destination destination_of(const run& current) const
+    {
+        if (current.option != "--preset"sv) {
+            auto generators = current.option.empty() ? std::vector<std::string>{} : std::vector{ current.name };
+            return { build_dir(), std::move(generators) };
+        }
+
+        auto dir        = presets().binary_dir(task_type::package, current.name, root().path()).value_or(build_dir());
+        auto generators = presets().package_generators(current.name);
+        if (generators.empty()) {
+            generators = cpack_report::generators_of(read_file(dir / CONFIG));
+        }
+        return { dir, std::move(generators) };
+    }
+
+    std::vector<std::vector<std::size_t>> groups_of(const std::vector<run>& runs) const
+    {
+        return cpack_report::groups_of(
+            std::ranges::to<std::vector>(runs | std::views::transform([this](const run& current) {
+                                             return destination_of(current);
+                                         })));
+    }
+
+    bool get_required() const override
+    {
+        return !value_of(environment(), ENABLE_VAR).empty() &&
+               (!package_presets({}).empty() || std::filesystem::is_regular_file(build_dir() / CONFIG));
+    }
+
+    /// A single cpack would take the same arguments, `execute_step` gives each preset or generator a run of its own.
+    arguments_type get_arguments(targets_type targets) const override
+    {
+        auto result = arguments_type{};
+        auto runs   = std::vector<run>{};
+        if (auto selected = package_presets(targets); !selected.empty()) {
+            for (auto& preset : selected) {
+                runs.push_back({ "--preset"s, std::move(preset) });
+            }
+        } else {
+            result = { "--config"s, (build_dir() / CONFIG).string(), "-B"s, build_dir().string() };
+            if (auto configuration = value_of(environment(), "CMAKE_BUILD_TYPE"); !configuration.empty()) {
+                result.insert(result.end(), { "-C"s, configuration });
+            }
+            for (auto& generator : generators()) {
+                runs.push_back({ "-G"s, std::move(generator) });
+            }
+        }
+
+        // The cores are shared by the runs that go at the same time.
+        auto threads = cpack_report::threads_for(groups_of(runs).size(), std::thread::hardware_concurrency());
+        result.insert(result.end(), { "-D"s, std::format("CPACK_THREADS={}", threads) });
+        for (auto& [option, name] : runs) {
+            result.insert(result.end(), { std::move(option), std::move(name) });
+        }
+        return result;
+    }
+
+    execution_result execute_step(std::string command, arguments_type arguments) const override
+    {
+        auto shared = arguments_type{};
+        auto runs   = std::vector<run>{};
+        for (auto it = arguments.begin(); it != arguments.end(); ++it) {
+            if (std::ranges::contains(RUN_OPTIONS, *it) && std::next(it) != arguments.end()) {
+                runs.push_back({ *it, *std::next(it) });
+                ++it;
+            } else {
+                shared.push_back(*it);
+            }
+        }
+        if (runs.empty()) {
+            runs.push_back({ ""s, "default"s });
+        }
+
+        auto groups  = groups_of(runs);
+        auto report  = cpack_report{};
+        auto failed  = false;
+        auto errors  = std::vector<std::string>{};
+        auto lock    = std::mutex{};
+        auto started = std::chrono::steady_clock::now();
+        {
+            auto threads = std::vector<std::jthread>{};
+            for (const auto& group : groups) {
+                threads.emplace_back([&, group] {
+                    for (auto index : group) {
+                        const auto& [option, name] = runs[index];
+                        auto all                   = shared;
+                        if (!option.empty()) {
+                            all.insert(all.end(), { option, name });
+                        }
+
+                        auto begin         = std::chrono::steady_clock::now();
+                        auto output        = std::vector<std::string>{};
+                        auto errors_of_run = std::vector<std::string>{};
+                        auto status        = root().stream_lines(
+                            command, all, environment(), root().path(), [&](std::string_view line, std_io stream) {
+                                if (stream == std_io::OUT) {
+                                    output.emplace_back(line);
+                                } else {
+                                    root().emit(line, stream);
+                                    errors_of_run.emplace_back(line);
+                                }
+                            });
+                        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+                        auto guard = std::lock_guard{ lock };
+                        report.add_run(name, output, seconds);
+                        if (status != 0) {
+                            failed = true;
+                            errors.push_back(std::format("cpack «{}» failed:", name));
+                            std::ranges::move(output, std::back_inserter(errors));
+                        } else if (!errors_of_run.empty()) {
+                            errors.push_back(std::format("cpack «{}»:", name));
+                        }
+                        std::ranges::move(errors_of_run, std::back_inserter(errors));
+                    }
+                });
+            }
+        }
+
+        auto result         = execution_result{ failed ? execution_result::FAILURE : execution_result::SUCCESS };
+        result.output       = report.summary();
+        result.error_output = std::move(errors);
+        result.output.push_back(std::format(
+            "📦 {} cpack runs, {} at the same time, in {:.1f}s",
+            runs.size(),
+            groups.size(),
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count()));
+        if (failed) {
+            result.exit_code = 1;
+        }
+        return result;
+    }
+
+    /// The packages are installed too, when `---install` asks for it.
+    builder_base::ptr get_next_builder() const override
+    {
+        if (my_build_dir.has_value()) {
+            return std::make_unique<install>(root(), environment(), *my_build_dir);
+        }
+        return install::create(root(), environment());
+    }
+};
+
+}
+
+#endif // INCLUDED_PACKAGE_HPP
@@ -0,0 +1,297 @@
+#ifndef INCLUDED_PGO_HPP
+#define INCLUDED_PGO_HPP
+
+#include "../builder.hpp"
+#include "../output_cache.hpp"
+#include "../state.hpp"
+#include "../tasks.hpp"
+#include "bench.hpp"
+#include <util/environment.hpp>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace vb::maker::builders {
+
+using namespace std::literals;
+
+struct pgo_spec
+{
+    static constexpr auto stage       = task_type::DYNAMIC;
+    static constexpr auto stages      = std::array{ task_type::configuration, task_type::build, task_type::test };
+    static constexpr auto name        = "PGO"sv;
+    static constexpr auto build_file  = "CMakeLists.txt"sv;
+    static constexpr auto command     = "cmake"sv;
+    static constexpr auto build_dir   = true;
+    static constexpr auto import_vars = std::array{ "CFLAGS", "CXX", "CXXFLAGS", "LLVM_PROFDATA", "VMK_PGO" };
+};
+
+/// Profile guided optimization of a cmake project, as a chain of builders.
+///
+/// Enabled by `VMK_PGO`. An instrumented release is configured and built in `«build dir»-generate`, trained by running
+/// its tests, its benchmarks or the command in `VMK_PGO`, and the profiles are merged with `llvm-profdata` for clang;
+/// gcc reads its `.gcda` files as they are. The optimized release is then built in the build dir and benchmarked
+/// against the usual build of the same commit.
+class pgo : public basic_builder<pgo_spec, pgo>
+{
+public:
+
+    using parent = basic_builder<pgo_spec, pgo>;
+    using parent::create;
+
+    static constexpr auto ENABLE_VAR       = "VMK_PGO"sv;
+    static constexpr auto BUILD_DIR_SUFFIX = "-pgo"sv;
+    static constexpr auto GENERATE_SUFFIX  = "-generate"sv;
+    static constexpr auto PROFILES         = "pgo-profiles"sv;
+    static constexpr auto MERGED           = "pgo.profdata"sv;
+    static constexpr auto VARIANT          = "pgo"sv;
+
+    enum class phase
+    {
+        configure_instrumented,
+        build_instrumented,
+        train,
+        merge,
+        configure_optimized,
+        build_optimized
+    };
+
+    pgo(work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+    {
+    }
+
+    pgo(phase current, work_dir wd, env::environment::optional env_)
+        : basic_builder{ wd, env_ }
+        , my_phase{ current }
+    {
+    }
+
+    /// The flags building the instrumented variant, writing its profiles to `profiles` when it runs.
+    static std::vector<std::string>
+    generate_flags(bool clang, const std::filesystem::path& profiles, const std::filesystem::path& build_dir)
+    {
+        if (clang) {
+            // Where the profiles go is set when training, with LLVM_PROFILE_FILE.
+            return { "-fprofile-instr-generate"s };
+        }
+        return { std::format("-fprofile-generate={}", profiles.string()),
+                 "-fprofile-update=atomic"s,
+                 std::format("-fprofile-prefix-path={}", build_dir.string()) };
+    }
+
+    /// The flags building the optimized variant from the profiles, code the training did not reach is still optimized.
+    static std::vector<std::string>
+    use_flags(bool clang, const std::filesystem::path& profiles, const std::filesystem::path& build_dir)
+    {
+        if (clang) {
+            return { std::format("-fprofile-instr-use={}", (profiles.parent_path() / MERGED).string()),
+                     "-Wno-profile-instr-unprofiled"s,
+                     "-Wno-profile-instr-out-of-date"s };
+        }
+        return { std::format("-fprofile-use={}", profiles.string()),
+                 "-fprofile-partial-training"s,
+                 std::format("-fprofile-prefix-path={}", build_dir.string()),
+                 "-Wno-missing-profile"s };
+    }
+
+private:
+
+    phase my_phase = phase::configure_instrumented;
+
+    bool is_clang() const
+    {
+        auto compiler = value_of(environment(), "CXX");
+        auto version  = details::tool_output(compiler.empty() ? "c++"sv : std::string_view{ compiler }, "--version"sv);
+        return version.has_value() && !version->empty() && version->front().contains("clang"sv);
+    }
+
+    std::filesystem::path instrumented_dir() const
+    {
+        return root().path() / (get_build_dirname(environment()) + std::string{ GENERATE_SUFFIX });
+    }
+
+    std::filesystem::path profiles_dir() const
+    {
+        return state_path(instrumented_dir()) / PROFILES;
+    }
+
+    /// A release of its own, with the single configuration generator the flags apply to.
+    arguments_type configure_arguments(const std::filesystem::path& dir, const std::vector<std::string>& flags) const
+    {
+        auto build_type = value_of(environment(), "CMAKE_BUILD_TYPE");
+        auto result     = arguments_type{
+            "-S"s, root().path().string(), "-B"s, dir.string(), "-G"s, "Ninja"s,
+            std::format("-DCMAKE_BUILD_TYPE={}", build_type.empty() ? "Release"s : build_type) };
+        for (auto [option, variable] : std::array{ std::pair{ "CMAKE_C_FLAGS"sv, "CFLAGS"sv },
+                                                   std::pair{ "CMAKE_CXX_FLAGS"sv, "CXXFLAGS"sv } }) {
+            auto all = value_of(environment(), variable);
+            for (const auto& flag : flags) {
+                all += all.empty() ? flag : std::format(" {}", flag);
+            }
+            result.push_back(std::format("-D{}={}", option, all));
+        }
+        return result;
+    }
+
+    std::string get_command(targets_type) const override
+    {
+        switch (my_phase) {
+        case phase::train:
+            return training_command().empty() ? "ctest"s : "sh"s;
+        case phase::merge: {
+            auto tool = value_of(environment(), "LLVM_PROFDATA");
+            return tool.empty() ? "llvm-profdata"s : tool;
+        }
+        default:
+            return "cmake"s;
+        }
+    }
+
+    /// The command given with `--pgo=«command»`, empty to train with the tests or the benchmarks.
+    std::string training_command() const
+    {
+        auto value = value_of(environment(), ENABLE_VAR);
+        return value == "1"sv ? ""s : value;
+    }
+
+    arguments_type get_arguments(targets_type targets) const override
+    {
+        switch (my_phase) {
+        case phase::configure_instrumented:
+            return configure_arguments(instrumented_dir(), generate_flags(is_clang(), profiles_dir(), instrumented_dir()));
+        case phase::build_instrumented:
+            return { "--build"s, instrumented_dir().string() };
+        case phase::train:
+            if (auto command = training_command(); !command.empty()) {
+                return { "-c"s, command };
+            }
+            if (!value_of(environment(), bench::ENABLE_VAR).empty()) {
+                return { "--test-dir"s, instrumented_dir().string(), "-L"s, std::string{ bench::LABEL } };
+            }
+            return { "--test-dir"s, instrumented_dir().string(), "--output-on-failure"s };
+        case phase::merge:
+            return { "merge"s,
+                     std::format("--output={}", (profiles_dir().parent_path() / MERGED).string()),
+                     profiles_dir().string() };
+        case phase::configure_optimized:
+            return configure_arguments(build_dir_path(), use_flags(is_clang(), profiles_dir(), build_dir_path()));
+        case phase::build_optimized: {
+            auto result = arguments_type{ "--build"s, build_dir_path().string() };
+            if (!targets.empty()) {
+                result.push_back("--target"s);
+                for (auto target : targets) {
+                    result.emplace_back(target);
+                }
+            }
+            return result;
+        }
+        }
+        return {};
+    }
+
+    static std::size_t count_files(const std::filesystem::path& dir, std::string_view extension)
+    {
+        auto result = std::size_t{ 0 };
+        auto error  = std::error_code{};
+        for (auto it = std::filesystem::recursive_directory_iterator{ dir, error };
+             it != std::filesystem::recursive_directory_iterator{};
+             it.increment(error)) {
+            if (it->path().extension() == extension) {
+                ++result;
+            }
+        }
+        return result;
+    }
+
+    execution_result execute_step(std::string command, arguments_type arguments) const override
+    {
+        if (my_phase != phase::train) {
+            auto result = parent::execute_step(command, arguments);
+            if (result && my_phase == phase::merge) {
+                result.output.push_back(std::format(
+                    "🔥 {} raw profiles merged into {}", count_files(profiles_dir(), ".profraw"sv), MERGED));
+            }
+            return result;
+        }
+
+        // Profiles of an older build would not match the code anymore.
+        auto error = std::error_code{};
+        std::filesystem::remove_all(profiles_dir(), error);
+        std::filesystem::create_directories(profiles_dir());
+
+        auto env                     = environment();
+        env.set("LLVM_PROFILE_FILE") = (profiles_dir() / "%p-%m.profraw").string();
+        auto result                  = root().execute(command, arguments, env);
+        auto profiles                = count_files(profiles_dir(), is_clang() ? ".profraw"sv : ".gcda"sv);
+        if (result && profiles == 0) {
+            result.status    = execution_result::FAILURE;
+            result.exit_code = 1;
+            result.error_output.push_back("the training wrote no profile, did it run the instrumented build?"s);
+        }
+        result.output.push_back(std::format("🔥 training wrote {} profiles", profiles));
+        return result;
+    }
+
+    /// gcc reads the profiles the instrumented build wrote, only clang's need to be merged.
+    bool get_required() const override
+    {
+        return my_phase != phase::merge || is_clang();
+    }
+
+    Stage get_stage() const override
+    {
+        switch (my_phase) {
+        case phase::configure_instrumented:
+        case phase::configure_optimized:
+            return Stage{ task_type::configuration };
+        case phase::train:
+            return Stage{ task_type::test };
+        default:
+            return Stage{ task_type::build };
+        }
+    }
+
+    std::optional<std::filesystem::path> get_build_directory(targets_type) const override
+    {
+        switch (my_phase) {
+        case phase::build_instrumented:
+            return instrumented_dir();
+        case phase::build_optimized:
+            return build_dir_path();
+        default:
+            return std::nullopt;
+        }
+    }
+
+    std::string get_name() const override
+    {
+        static constexpr auto names = std::array{ "instrumented"sv, "instrumented"sv, "training"sv,
+                                                  "profiles"sv,     "optimized"sv,    "optimized"sv };
+        return std::format("PGO «{}»", names[std::to_underlying(my_phase)]);
+    }
+
+    /// The phases follow each other, the optimized build is then benchmarked against the usual one.
+    builder_base::ptr get_next_builder() const override
+    {
+        if (my_phase == phase::build_optimized) {
+            auto env                    = environment();
+            env.set(bench::ENABLE_VAR)  = "1";
+            env.set(bench::VARIANT_VAR) = VARIANT;
+            return bench::create(root(), env);
+        }
+        return std::make_unique<pgo>(phase{ std::to_underlying(my_phase) + 1 }, root(), environment());
+    }
+};
+
+}
+
+#endif // INCLUDED_PGO_HPP
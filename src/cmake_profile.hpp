@@ -0,0 +1,212 @@
+#ifndef INCLUDED_CMAKE_PROFILE_HPP
+#define INCLUDED_CMAKE_PROFILE_HPP
+
+#include "builder.hpp"
+#include "result.hpp"
+#include "state.hpp"
+#include "timings.hpp"
+#include <nlohmann/json.hpp>
+#include <util/environment.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Where the time of a cmake configuration goes, from the trace `--profiling-format=google-trace` writes.
+///
+/// Enabled by `VMK_PROFILE_CONFIGURE`, which makes the configuration run even when it is up to date. The calls are
+/// aggregated by what they do: the packages searched for, the compilation checks, the modules included, every other
+/// command or function by name. Each file is charged the time spent in its own lines, excluding the calls nested in
+/// them, so the files add up to the whole configuration.
+class cmake_profile
+{
+public:
+
+    static constexpr auto ENABLE_VAR = "VMK_PROFILE_CONFIGURE"sv;
+    static constexpr auto FILE       = "cmake-profile.json"sv;
+
+    using entries_type = timings;
+
+    static bool enabled(const env::environment& env)
+    {
+        return !value_of(env, ENABLE_VAR).empty();
+    }
+
+    static std::array<std::string, 2> arguments(const std::filesystem::path& output)
+    {
+        return { "--profiling-format=google-trace"s, std::format("--profiling-output={}", output.string()) };
+    }
+
+    /// Adds the profile cmake wrote to `output` to the result of the configuration stage.
+    static void report(execution_result& result, const std::filesystem::path& output)
+    {
+        auto trace = nlohmann::json::parse(read_file(output), nullptr, false);
+        if (trace.is_discarded()) {
+            return;
+        }
+
+        auto profile = cmake_profile{};
+        profile.add(trace);
+        std::ranges::copy(profile.summary(), std::back_inserter(result.output));
+        result.traces.push_back(output);
+    }
+
+    /// Adds the events of a trace, either a bare array of events or an object with `traceEvents`.
+    void add(const nlohmann::json& trace)
+    {
+        const auto& events = trace.is_object() ? trace.value("traceEvents", nlohmann::json::array()) : trace;
+        if (!events.is_array()) {
+            return;
+        }
+
+        auto calls = std::vector<call>{};
+        for (const auto& event : events) {
+            if (event.value("ph", ""s) != "X") {
+                continue;
+            }
+            const auto& args = event.contains("args") ? event["args"] : nlohmann::json::object();
+            calls.push_back({ event.value("name", ""s),
+                              args.value("functionArgs", ""s),
+                              args.value("location", ""s),
+                              event.value("ts", 0.0),
+                              event.value("dur", 0.0) });
+        }
+        std::ranges::sort(calls, [](const call& left, const call& right) {
+            return std::pair{ left.start, -left.duration } < std::pair{ right.start, -right.duration };
+        });
+
+        // The calls nested in another one start after it and end before it does.
+        auto open = std::vector<std::size_t>{};
+        auto self = std::vector<double>{};
+        for (auto [index, current] : calls | std::views::enumerate) {
+            while (!open.empty() && calls[open.back()].start + calls[open.back()].duration <= current.start) {
+                open.pop_back();
+            }
+            if (!open.empty()) {
+                self[open.back()] -= current.duration;
+            }
+            self.push_back(current.duration);
+            open.push_back(static_cast<std::size_t>(index));
+        }
+
+        for (auto [index, current] : calls | std::views::enumerate) {
+            auto seconds = current.duration / 1e6;
+            add_timing(entries_for(current.name), key_of(current), seconds);
+            add_timing(my_files, file_of(current.location), std::max(self[static_cast<std::size_t>(index)], 0.0) / 1e6);
+        }
+    }
+
+    const entries_type& packages() const
+    {
+        return my_packages;
+    }
+
+    const entries_type& checks() const
+    {
+        return my_checks;
+    }
+
+    const entries_type& includes() const
+    {
+        return my_includes;
+    }
+
+    const entries_type& commands() const
+    {
+        return my_commands;
+    }
+
+    const entries_type& files() const
+    {
+        return my_files;
+    }
+
+    std::vector<std::string> summary(std::size_t limit = 5) const
+    {
+        auto result = std::vector<std::string>{};
+        for (const auto& [title, entries] : { std::pair{ "find_package"sv, &my_packages },
+                                              std::pair{ "try_compile"sv, &my_checks },
+                                              std::pair{ "include()"sv, &my_includes },
+                                              std::pair{ "commands and functions"sv, &my_commands },
+                                              std::pair{ "files, own time"sv, &my_files } }) {
+            if (entries->empty()) {
+                continue;
+            }
+            result.push_back(std::format("🐢 slowest {}:", title));
+            for (const auto& [name, found] : slowest(*entries, limit)) {
+                result.push_back(std::format("    {:>8.2f}s {:>5}×  {}", found.seconds, found.count, name));
+            }
+        }
+        return result;
+    }
+
+private:
+
+    struct call
+    {
+        std::string name;
+        std::string arguments;
+        std::string location;
+        double      start    = 0.0;
+        double      duration = 0.0;
+    };
+
+    entries_type my_packages;
+    entries_type my_checks;
+    entries_type my_includes;
+    entries_type my_commands;
+    entries_type my_files;
+
+    entries_type& entries_for(std::string_view name)
+    {
+        if (name == "find_package"sv) {
+            return my_packages;
+        }
+        if (name == "try_compile"sv || name == "try_run"sv) {
+            return my_checks;
+        }
+        if (name == "include"sv) {
+            return my_includes;
+        }
+        return my_commands;
+    }
+
+    /// The package or module for `find_package` and `include`, where the check is for `try_compile`.
+    static std::string key_of(const call& current)
+    {
+        if (current.name == "find_package"sv || current.name == "include"sv) {
+            auto arguments = std::string_view{ current.arguments };
+            return std::string{ arguments.substr(0, arguments.find(' ')) };
+        }
+        if (current.name == "try_compile"sv || current.name == "try_run"sv) {
+            return file_of(current.location);
+        }
+        return current.name;
+    }
+
+    /// `/path/CMakeLists.txt:12` without the line.
+    static std::string file_of(std::string_view location)
+    {
+        auto colon = location.rfind(':');
+        if (colon != location.npos && location.find_first_not_of("0123456789"sv, colon + 1) == location.npos) {
+            location = location.substr(0, colon);
+        }
+        return location.empty() ? "«cmake»"s : std::string{ location };
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_CMAKE_PROFILE_HPP
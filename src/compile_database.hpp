@@ -0,0 +1,353 @@
+#ifndef INCLUDED_COMPILE_DATABASE_HPP
+#define INCLUDED_COMPILE_DATABASE_HPP
+
+#include "hash.hpp"
+#include "state.hpp"
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <print>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace details {
+
+/// SAX consumer that hands each element of a top level JSON array to a callback, one at a time.
+///
+/// Only one entry is ever kept in memory, which matters for databases of tens of megabytes.
+class array_element_reader
+{
+public:
+
+    using json     = nlohmann::json;
+    using callback = std::function<void(json&&)>;
+
+    explicit array_element_reader(callback consumer)
+        : my_consumer{ std::move(consumer) }
+    {
+    }
+
+    bool null()
+    {
+        return value(nullptr);
+    }
+
+    bool boolean(bool flag)
+    {
+        return value(flag);
+    }
+
+    bool number_integer(json::number_integer_t number)
+    {
+        return value(number);
+    }
+
+    bool number_unsigned(json::number_unsigned_t number)
+    {
+        return value(number);
+    }
+
+    bool number_float(json::number_float_t number, const json::string_t&)
+    {
+        return value(number);
+    }
+
+    bool string(json::string_t& text)
+    {
+        return value(std::move(text));
+    }
+
+    bool binary(json::binary_t& data)
+    {
+        return value(json::binary(std::move(data)));
+    }
+
+    bool start_object(std::size_t)
+    {
+        return open(json::object());
+    }
+
+    bool end_object()
+    {
+        return close();
+    }
+
+    bool start_array(std::size_t)
+    {
+        if (my_depth++ == 0) {
+            return true;
+        }
+        return open(json::array(), false);
+    }
+
+    bool end_array()
+    {
+        if (--my_depth == 0) {
+            return true;
+        }
+        return close(false);
+    }
+
+    bool key(json::string_t& name)
+    {
+        my_key = std::move(name);
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& error)
+    {
+        my_error = std::format("at {}: {}", position, error.what());
+        return false;
+    }
+
+    const std::optional<std::string>& error() const
+    {
+        return my_error;
+    }
+
+private:
+
+    callback                   my_consumer;
+    std::vector<json>          my_stack;
+    std::vector<std::string>   my_keys;
+    std::string                my_key;
+    std::size_t                my_depth = 0;
+    std::optional<std::string> my_error;
+
+    bool open(json&& container, bool count_depth = true)
+    {
+        if (count_depth) {
+            ++my_depth;
+        }
+        if (my_depth < 2) {
+            return false; // The database must be an array.
+        }
+        my_keys.push_back(std::move(my_key));
+        my_stack.push_back(std::move(container));
+        return true;
+    }
+
+    bool close(bool count_depth = true)
+    {
+        if (count_depth) {
+            --my_depth;
+        }
+        auto done = std::move(my_stack.back());
+        my_stack.pop_back();
+        my_key = std::move(my_keys.back());
+        my_keys.pop_back();
+        return value(std::move(done));
+    }
+
+    bool value(json&& item)
+    {
+        if (my_stack.empty()) {
+            if (my_depth == 1) {
+                my_consumer(std::move(item));
+            }
+            return true;
+        }
+
+        auto& parent = my_stack.back();
+        if (parent.is_object()) {
+            parent[my_key] = std::move(item);
+        } else {
+            parent.push_back(std::move(item));
+        }
+        return true;
+    }
+};
+
+} // namespace details
+
+/// Calls `consumer` for each entry of a compilation database, without loading it all.
+inline bool for_each_compile_command(const std::filesystem::path& database, const details::array_element_reader::callback& consumer)
+{
+    auto input  = std::ifstream{ database, std::ios::binary };
+    auto reader = details::array_element_reader{ consumer };
+    if (!nlohmann::json::sax_parse(input, &reader)) {
+        std::println("⚠ could not read {}: {}", database.string(), reader.error().value_or("not an array"s));
+        return false;
+    }
+    return true;
+}
+
+/// Merges the compilation databases of all build directories into one at the root of the project.
+///
+/// clangd only looks for `compile_commands.json` in the source tree and its parents. With several presets or profiles
+/// there are several databases, the merged one keeps the first entry found for each file, preferring the database of
+/// the current build directory. Nothing is done when the inputs did not change since the last merge, and the result
+/// only replaces the existing file, atomically, if its content changed; otherwise clangd would index everything again.
+class compile_database_merger
+{
+public:
+
+    static constexpr auto DATABASE    = "compile_commands.json"sv;
+    static constexpr auto INPUTS_FILE = "compile_commands.inputs"sv;
+    static constexpr auto OUTPUT_FILE = "compile_commands.output"sv;
+    static constexpr auto MAX_DEPTH   = 3;
+
+    explicit compile_database_merger(std::filesystem::path root, std::filesystem::path preferred_build_dir = {})
+        : my_root{ std::move(root) }
+        , my_preferred{ std::move(preferred_build_dir) }
+    {
+    }
+
+    /// All databases found in build directories, the preferred build directory first.
+    std::vector<std::filesystem::path> databases() const
+    {
+        auto result = std::vector<std::filesystem::path>{};
+        auto error  = std::error_code{};
+        for (const auto& entry : std::filesystem::directory_iterator{ my_root, error }) {
+            if (entry.is_directory() && entry.path().filename().string().starts_with("build")) {
+                collect(entry.path(), 0, result);
+            }
+        }
+        if (!my_preferred.empty() && !my_preferred.filename().string().starts_with("build")) {
+            collect(my_preferred, 0, result);
+        }
+
+        std::ranges::sort(result);
+        std::ranges::stable_partition(result, [&](const auto& path) {
+            return !my_preferred.empty() && is_inside(path, my_preferred);
+        });
+        return result;
+    }
+
+    /// True when the root database is missing or a database changed since the last merge.
+    ///
+    /// The configuration stage is not the only one writing them: it can be skipped, and ninja runs cmake again from
+    /// the build stage when a `CMakeLists.txt` changes.
+    bool stale() const
+    {
+        auto inputs = databases();
+        return !inputs.empty() && (!std::filesystem::exists(my_root / DATABASE) ||
+                                   read_file(state_dir(inputs.front().parent_path()) / INPUTS_FILE) !=
+                                       inputs_signature(inputs));
+    }
+
+    /// Returns true if the root database was rewritten.
+    bool merge() const
+    {
+        auto inputs = databases();
+        if (inputs.empty()) {
+            return false;
+        }
+
+        auto state       = state_dir(inputs.front().parent_path());
+        auto inputs_file = state / INPUTS_FILE;
+        auto output_file = state / OUTPUT_FILE;
+        auto signature   = inputs_signature(inputs);
+        auto output      = my_root / DATABASE;
+        if (std::filesystem::exists(output) && read_file(inputs_file) == signature) {
+            return false;
+        }
+
+        auto temporary = output;
+        temporary += ".vmk.tmp";
+
+        auto content = fingerprint{};
+        {
+            auto out   = std::ofstream{ temporary, std::ios::binary | std::ios::trunc };
+            auto seen  = std::set<std::string>{};
+            auto first = true;
+            auto write = [&](std::string_view text) {
+                out << text;
+                content.add(text);
+            };
+
+            write("[\n"sv);
+            for (const auto& input : inputs) {
+                for_each_compile_command(input, [&](nlohmann::json&& entry) {
+                    if (!entry.is_object() || !seen.insert(source_of(entry)).second) {
+                        return;
+                    }
+                    write(first ? "  "sv : ",\n  "sv);
+                    write(entry.dump());
+                    first = false;
+                });
+            }
+            write("\n]\n"sv);
+        }
+
+        write_atomically(inputs_file, signature);
+
+        if (std::filesystem::is_regular_file(output) && read_file(output_file) == content.hex()) {
+            std::filesystem::remove(temporary);
+            return false;
+        }
+
+        std::filesystem::rename(temporary, output);
+        write_atomically(output_file, content.hex());
+        return true;
+    }
+
+private:
+
+    std::filesystem::path my_root;
+    std::filesystem::path my_preferred;
+
+    static bool is_inside(const std::filesystem::path& path, const std::filesystem::path& dir)
+    {
+        auto relative = path.lexically_relative(dir);
+        return !relative.empty() && *relative.begin() != "..";
+    }
+
+    static void collect(const std::filesystem::path& dir, int depth, std::vector<std::filesystem::path>& found)
+    {
+        if (depth > MAX_DEPTH || dir.filename() == ".vmk") {
+            return;
+        }
+
+        if (auto database = dir / DATABASE; std::filesystem::is_regular_file(database)) {
+            if (std::ranges::find(found, database) == found.end()) {
+                found.push_back(database);
+            }
+        }
+
+        auto error = std::error_code{};
+        for (const auto& entry : std::filesystem::directory_iterator{ dir, error }) {
+            if (entry.is_directory() && !entry.is_symlink()) {
+                collect(entry.path(), depth + 1, found);
+            }
+        }
+    }
+
+    static std::string source_of(const nlohmann::json& entry)
+    {
+        auto file = std::filesystem::path{ entry.value("file", ""s) };
+        if (file.is_relative()) {
+            file = std::filesystem::path{ entry.value("directory", ""s) } / file;
+        }
+        return file.lexically_normal().string();
+    }
+
+    /// Which databases, and their size and modification time.
+    static std::string inputs_signature(const std::vector<std::filesystem::path>& inputs)
+    {
+        auto result = fingerprint{};
+        for (const auto& input : inputs) {
+            auto error = std::error_code{};
+            result.add(input.string());
+            result.add(static_cast<std::uint64_t>(std::filesystem::file_size(input, error)));
+            result.add(static_cast<std::uint64_t>(
+                std::filesystem::last_write_time(input, error).time_since_epoch().count()));
+        }
+        return result.hex();
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_COMPILE_DATABASE_HPP
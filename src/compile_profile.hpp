@@ -0,0 +1,257 @@
+#ifndef INCLUDED_COMPILE_PROFILE_HPP
+#define INCLUDED_COMPILE_PROFILE_HPP
+
+#include "builder.hpp"
+#include "output_cache.hpp"
+#include "parallel.hpp"
+#include "timings.hpp"
+#include <nlohmann/json.hpp>
+#include <util/environment.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Where the compilers spend their time, aggregated over all the translation units of a build.
+///
+/// Enabled by `VMK_PROFILE_COMPILE`. clang is given `-ftime-trace` and writes a trace next to each object, gcc is
+/// given `-ftime-report` and prints a report per translation unit that ninja forwards on its output. The build goes
+/// to its own directory, with ccache disabled, so the profiling flags never end up in the usual build or cache.
+class compile_profile
+{
+public:
+
+    static constexpr auto ENABLE_VAR       = "VMK_PROFILE_COMPILE"sv;
+    static constexpr auto BUILD_DIR_SUFFIX = "-profile"sv;
+    static constexpr auto CLANG_FLAG       = "-ftime-trace"sv;
+    static constexpr auto GCC_FLAG         = "-ftime-report"sv;
+
+    static constexpr auto flag_variables = std::array{ "CFLAGS"sv, "CXXFLAGS"sv };
+
+    /// The profiling flag understood by the compiler that printed `version`.
+    static std::string_view flag_for(std::string_view version)
+    {
+        return version.contains("clang"sv) ? CLANG_FLAG : GCC_FLAG;
+    }
+
+    /// Sets up the environment of a configuration stage to profile the compilations.
+    static void apply(env::environment& env)
+    {
+        env.set(ENABLE_VAR)       = "1";
+        env.set("CCACHE_DISABLE") = "1";
+
+        auto compiler = value_of(env, "CXX");
+        auto version  = details::tool_output(compiler.empty() ? "c++"sv : std::string_view{ compiler }, "--version"sv);
+        auto flag     = flag_for(version.has_value() && !version->empty() ? version->front() : ""s);
+        for (auto name : flag_variables) {
+            env.import(name);
+            auto flags = value_of(env, name);
+            if (!flags.contains(flag)) {
+                flags += flags.empty() ? std::string{ flag } : std::format(" {}", flag);
+            }
+            env.set(name) = flags;
+        }
+    }
+
+    /// Adds a clang `-ftime-trace` trace, durations there are in microseconds.
+    void add_trace(const nlohmann::json& trace)
+    {
+        auto events = trace.find("traceEvents");
+        if (events == trace.end() || !events->is_array()) {
+            return;
+        }
+
+        ++my_units;
+        for (const auto& event : *events) {
+            if (event.value("ph", ""s) != "X") {
+                continue;
+            }
+            auto name    = event.value("name", ""s);
+            auto seconds = event.value("dur", 0.0) / 1e6;
+            auto detail  = event.contains("args") ? event["args"].value("detail", ""s) : ""s;
+
+            if (name == "Frontend") {
+                my_frontend += seconds;
+            } else if (name == "Backend") {
+                my_backend += seconds;
+            } else if (name == "InstantiateClass" || name == "InstantiateFunction") {
+                add_timing(my_templates, detail, seconds);
+            } else if (name == "Source") {
+                add_timing(my_includes, detail, seconds);
+            }
+        }
+    }
+
+    /// A line of a gcc `-ftime-report`: ` phase parsing   :   0.32 ( 64%)   0.10 ( 71%)   0.43 ( 65%)    58M ( 73%)`.
+    ///
+    /// Returns false if `line` is not part of a report.
+    bool add_report_line(std::string_view line)
+    {
+        if (line.starts_with("Time variable"sv)) {
+            ++my_units;
+            return true;
+        }
+
+        auto colon = line.find(" : "sv);
+        if (!line.starts_with(' ') || colon == line.npos) {
+            return false;
+        }
+        auto name = line.substr(0, colon);
+        name.remove_prefix(std::min(name.find_first_not_of(" |"sv), name.size()));
+        name = name.substr(0, name.find_last_not_of(' ') + 1);
+
+        // usr, sys and wall times, without the percentages between them.
+        auto times = std::vector<double>{};
+        for (auto word : line.substr(colon + 3) | std::views::split(' ')) {
+            auto text = std::string_view{ word.begin(), word.end() };
+            auto time = 0.0;
+            if (text.empty() || text.starts_with('(') || text.ends_with(')')) {
+                continue;
+            }
+            if (std::from_chars(text.data(), text.data() + text.size(), time).ptr != text.data() + text.size()) {
+                break;
+            }
+            times.push_back(time);
+        }
+        if (times.size() < 3) {
+            return false;
+        }
+
+        auto wall = times[2];
+        if (name.starts_with("phase "sv)) {
+            if (name == "phase setup"sv || name == "phase parsing"sv || name == "phase lang. deferred"sv) {
+                my_frontend += wall;
+            } else {
+                my_backend += wall;
+            }
+        } else if (name != "TOTAL"sv) {
+            add_timing(my_passes, name, wall);
+        }
+        return true;
+    }
+
+    void merge(const compile_profile& other)
+    {
+        my_units += other.my_units;
+        my_frontend += other.my_frontend;
+        my_backend += other.my_backend;
+        for (auto [mine, theirs] : { std::pair{ &my_templates, &other.my_templates },
+                                     std::pair{ &my_includes, &other.my_includes },
+                                     std::pair{ &my_passes, &other.my_passes } }) {
+            for (const auto& [name, found] : *theirs) {
+                auto& total = (*mine)[name];
+                total.seconds += found.seconds;
+                total.count += found.count;
+            }
+        }
+    }
+
+    std::size_t units() const
+    {
+        return my_units;
+    }
+
+    double frontend_seconds() const
+    {
+        return my_frontend;
+    }
+
+    double backend_seconds() const
+    {
+        return my_backend;
+    }
+
+    std::vector<std::string> summary(std::size_t limit = 10) const
+    {
+        auto result = std::vector<std::string>{};
+        if (my_units == 0) {
+            result.push_back("⏱ the compilers reported no timing, was the build up to date?"s);
+            return result;
+        }
+
+        auto total = my_frontend + my_backend;
+        result.push_back(std::format(
+            "⏱ {} translation units: frontend {:.1f}s ({:.0f}%), backend {:.1f}s ({:.0f}%)",
+            my_units,
+            my_frontend,
+            total > 0 ? 100 * my_frontend / total : 0.0,
+            my_backend,
+            total > 0 ? 100 * my_backend / total : 0.0));
+
+        for (const auto& [title, entries] : { std::pair{ "template instantiations"sv, &my_templates },
+                                              std::pair{ "includes"sv, &my_includes },
+                                              std::pair{ "compiler passes"sv, &my_passes } }) {
+            if (entries->empty()) {
+                continue;
+            }
+            result.push_back(std::format("⏱ most expensive {}:", title));
+            for (const auto& [name, found] : slowest(*entries, limit)) {
+                result.push_back(std::format("    {:>9.2f}s {:>6}×  {}", found.seconds, found.count, name));
+            }
+        }
+        return result;
+    }
+
+    /// Traces clang wrote in `build_dir`, the ones next to an object file.
+    static std::vector<std::filesystem::path> find_traces(const std::filesystem::path& build_dir)
+    {
+        auto result = std::vector<std::filesystem::path>{};
+        auto error  = std::error_code{};
+        for (auto it = std::filesystem::recursive_directory_iterator{ build_dir, error };
+             it != std::filesystem::recursive_directory_iterator{};
+             it.increment(error)) {
+            const auto& path = it->path();
+            if (it->is_regular_file() && path.extension() == ".json" &&
+                std::filesystem::exists(std::filesystem::path{ path }.replace_extension(".o"))) {
+                result.push_back(path);
+            }
+        }
+        return result;
+    }
+
+    /// Parses the traces on all the cores, each thread aggregates its own share before they are merged.
+    static compile_profile read_traces(const std::vector<std::filesystem::path>& traces)
+    {
+        auto partial = std::vector<compile_profile>(parallel_workers(traces.size()));
+        for_each_parallel(traces, [&partial](std::size_t worker, const std::filesystem::path& file) {
+            auto trace = nlohmann::json::parse(std::ifstream{ file }, nullptr, false);
+            if (!trace.is_discarded()) {
+                partial[worker].add_trace(trace);
+            }
+        });
+
+        auto result = compile_profile{};
+        for (const auto& profile : partial) {
+            result.merge(profile);
+        }
+        return result;
+    }
+
+private:
+
+    using entries_type = timings;
+
+    std::size_t  my_units    = 0;
+    double       my_frontend = 0.0;
+    double       my_backend  = 0.0;
+    entries_type my_templates;
+    entries_type my_includes;
+    entries_type my_passes;
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_COMPILE_PROFILE_HPP
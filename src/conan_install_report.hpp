@@ -0,0 +1,177 @@
+#ifndef INCLUDED_CONAN_INSTALL_REPORT_HPP
+#define INCLUDED_CONAN_INSTALL_REPORT_HPP
+
+#include "file_copy.hpp"
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// What `conan install` did for each dependency: downloaded its binary, built it from source, or found it in the cache.
+///
+/// The time of a package goes from the first to the last line conan logged for it, `zlib/1.3.1: …`, so the log has to
+/// be read as conan writes it. The binaries and package folders come from the graph of `--format json`.
+class conan_install_report
+{
+public:
+
+    using clock = std::chrono::steady_clock;
+
+    static constexpr auto BUILD    = "Build"sv;
+    static constexpr auto DOWNLOAD = "Download"sv;
+    static constexpr auto CACHE    = "Cache"sv;
+
+    struct package
+    {
+        std::string   reference;
+        std::string   binary;
+        double        seconds = 0.0;
+        std::uint64_t bytes   = 0;
+    };
+
+    /// The reference a line of the log is about, `zlib/1.3.1` in `zlib/1.3.1: Calling build()`.
+    static std::optional<std::string_view> reference_of(std::string_view line)
+    {
+        auto colon = line.find(": "sv);
+        if (colon == line.npos) {
+            return std::nullopt;
+        }
+        auto reference = line.substr(0, colon);
+        if (reference.empty() || !reference.contains('/') || reference.contains(' ')) {
+            return std::nullopt;
+        }
+        return reference;
+    }
+
+    /// conan writes its whole log on the error stream, the lines it marks with `ERROR:` are the actual errors.
+    static bool is_error(std::string_view line)
+    {
+        return line.starts_with("ERROR: "sv);
+    }
+
+    /// `zlib/1.3.1#b8bc2603…%1698222418.71` without the revision.
+    static std::string_view without_revision(std::string_view reference)
+    {
+        return reference.substr(0, reference.find('#'));
+    }
+
+    void add_log_line(std::string_view line, clock::time_point when = clock::now())
+    {
+        auto reference = reference_of(line);
+        if (!reference.has_value()) {
+            return;
+        }
+        auto found = my_seen.find(without_revision(*reference));
+        if (found == my_seen.end()) {
+            my_seen.emplace(std::string{ without_revision(*reference) }, std::pair{ when, when });
+        } else {
+            found->second.second = when;
+        }
+    }
+
+    /// Reads the nodes of the graph conan printed, the project itself has no reference and is left out.
+    void add_graph(const nlohmann::json& graph)
+    {
+        auto nodes = graph.contains("graph") ? graph["graph"].value("nodes", nlohmann::json::object())
+                                             : nlohmann::json::object();
+        for (const auto& [id, node] : nodes.items()) {
+            auto reference = string_of(node, "ref"sv);
+            auto binary    = string_of(node, "binary"sv);
+            if (reference.empty() || binary.empty() || binary == "Skip"sv) {
+                continue;
+            }
+
+            auto current  = package{ std::string{ without_revision(reference) }, binary };
+            auto folder   = string_of(node, "package_folder"sv);
+            current.bytes = folder.empty() ? 0 : directory_size(folder);
+            my_packages.push_back(std::move(current));
+        }
+    }
+
+    /// The packages, the slowest first.
+    std::vector<package> packages() const
+    {
+        auto result = my_packages;
+        for (auto& current : result) {
+            if (auto found = my_seen.find(current.reference); found != my_seen.end()) {
+                current.seconds = std::chrono::duration<double>(found->second.second - found->second.first).count();
+            }
+        }
+        std::ranges::stable_sort(result, std::ranges::greater{}, &package::seconds);
+        return result;
+    }
+
+    std::vector<std::string> built_from_source() const
+    {
+        return std::ranges::to<std::vector<std::string>>(
+            my_packages | std::views::filter([](const package& current) { return current.binary == BUILD; }) |
+            std::views::transform(&package::reference));
+    }
+
+    std::vector<std::string> summary() const
+    {
+        auto result = std::vector<std::string>{};
+        for (const auto& current : packages()) {
+            result.push_back(std::format(
+                "📦 {:<40} {:<18} {:>7.1f}s {:>9.1f} MiB",
+                current.reference,
+                describe(current.binary),
+                current.seconds,
+                static_cast<double>(current.bytes) / (1 << 20)));
+        }
+
+        if (auto built = built_from_source(); !built.empty()) {
+            result.push_back(std::format(
+                "⚠ built from source, no binary was found for: {}. Publishing binaries for them saves that time.",
+                std::ranges::to<std::string>(built | std::views::join_with(", "sv))));
+        }
+        return result;
+    }
+
+private:
+
+    /// First and last time each reference was logged.
+    using seen_type = std::map<std::string, std::pair<clock::time_point, clock::time_point>, std::less<>>;
+
+    std::vector<package> my_packages;
+    seen_type            my_seen;
+
+    /// conan writes `null` for what it does not know, e.g. the binary of the project itself.
+    static std::string string_of(const nlohmann::json& node, std::string_view key)
+    {
+        auto found = node.find(key);
+        return found != node.end() && found->is_string() ? found->get<std::string>() : ""s;
+    }
+
+    static std::string_view describe(std::string_view binary)
+    {
+        if (binary == BUILD) {
+            return "built from source"sv;
+        }
+        if (binary == DOWNLOAD) {
+            return "downloaded"sv;
+        }
+        if (binary == CACHE) {
+            return "in the cache"sv;
+        }
+        return binary;
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_CONAN_INSTALL_REPORT_HPP
@@ -0,0 +1,157 @@
+#ifndef INCLUDED_CPACK_REPORT_HPP
+#define INCLUDED_CPACK_REPORT_HPP
+
+#include "artifact_sizes.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// The packages written by the cpack runs of the package stage, with their compressed size and the time it took.
+///
+/// Every generator, or package preset, is a cpack run of its own. They run at the same time, so the time of a package
+/// is the time of its run, compression included.
+class cpack_report
+{
+public:
+
+    struct package
+    {
+        std::string   file;
+        std::string   run; ///< The generator or preset that wrote it.
+        double        seconds = 0.0;
+        std::uint64_t bytes   = 0;
+    };
+
+    /// The generators of `set(CPACK_GENERATOR "TGZ;DEB")` in a `CPackConfig.cmake`.
+    static std::vector<std::string> generators_of(std::string_view config)
+    {
+        static constexpr auto prefix = R"(set(CPACK_GENERATOR ")"sv;
+
+        auto result = std::vector<std::string>{};
+        auto start  = config.find(prefix);
+        if (start == config.npos) {
+            return result;
+        }
+        start += prefix.size();
+        auto value = config.substr(start, config.find('"', start) - start);
+        for (auto generator : value | std::views::split(';')) {
+            if (!generator.empty()) {
+                result.emplace_back(std::string_view{ generator });
+            }
+        }
+        return result;
+    }
+
+    /// The file of `CPack: - package: /build/app-1.0-Linux.tar.gz generated.`
+    static std::optional<std::string_view> package_of(std::string_view line)
+    {
+        static constexpr auto prefix = "CPack: - package: "sv;
+        static constexpr auto suffix = " generated."sv;
+        if (!line.starts_with(prefix) || !line.ends_with(suffix)) {
+            return std::nullopt;
+        }
+        return line.substr(prefix.size(), line.size() - prefix.size() - suffix.size());
+    }
+
+    /// The compression threads of each of `runs` cpack runs sharing `cores`, the runs never get more than the cores.
+    static unsigned threads_for(std::size_t runs, unsigned cores)
+    {
+        return static_cast<unsigned>(std::max<std::size_t>(cores / std::max<std::size_t>(runs, 1), 1));
+    }
+
+    /// Where a cpack run works: `_CPack_Packages/«system»/«generator»` of its build directory, for each generator.
+    struct destination
+    {
+        std::filesystem::path    build_dir;
+        std::vector<std::string> generators;
+    };
+
+    /// The runs that can go at the same time, by index: the runs of a group would work in the same place, so they
+    /// follow each other.
+    static std::vector<std::vector<std::size_t>> groups_of(const std::vector<destination>& runs)
+    {
+        auto groups = std::vector<std::vector<std::size_t>>{};
+        for (auto index = std::size_t{ 0 }; index < runs.size(); ++index) {
+            // A run can join groups that were apart until then, they become one.
+            auto joined = std::vector<std::size_t>{ index };
+            std::erase_if(groups, [&](const std::vector<std::size_t>& group) {
+                auto overlaps = std::ranges::any_of(group, [&](std::size_t other) {
+                    return overlap(runs[index], runs[other]);
+                });
+                if (overlaps) {
+                    joined.insert(joined.end(), group.begin(), group.end());
+                }
+                return overlaps;
+            });
+            std::ranges::sort(joined);
+            groups.push_back(std::move(joined));
+        }
+        std::ranges::sort(groups);
+        return groups;
+    }
+
+    /// Adds the packages `run` reported in its `output`, it took `seconds`.
+    void add_run(std::string_view run, const std::vector<std::string>& output, double seconds)
+    {
+        for (const auto& line : output) {
+            if (auto file = package_of(line); file.has_value()) {
+                auto error = std::error_code{};
+                auto bytes = std::filesystem::file_size(*file, error);
+                my_packages.push_back({ std::string{ *file }, std::string{ run }, seconds, error ? 0 : bytes });
+            }
+        }
+    }
+
+    const std::vector<package>& packages() const
+    {
+        return my_packages;
+    }
+
+    std::vector<std::string> summary() const
+    {
+        auto result = std::vector<std::string>{};
+        auto total  = std::uint64_t{ 0 };
+        for (const auto& current : my_packages) {
+            total += current.bytes;
+        }
+        result.push_back(std::format("📦 {} packages, {}", my_packages.size(), artifact_sizes::human(total)));
+        for (const auto& current : my_packages) {
+            result.push_back(std::format(
+                "📦 {:<40} {:<8} {:>10} {:>7.1f}s",
+                std::filesystem::path{ current.file }.filename().string(),
+                current.run,
+                artifact_sizes::human(current.bytes),
+                current.seconds));
+        }
+        return result;
+    }
+
+private:
+
+    std::vector<package> my_packages;
+
+    static bool overlap(const destination& left, const destination& right)
+    {
+        return left.build_dir == right.build_dir &&
+               std::ranges::any_of(left.generators, [&](const std::string& generator) {
+                   return std::ranges::contains(right.generators, generator);
+               });
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_CPACK_REPORT_HPP
@@ -0,0 +1,143 @@
+#ifndef INCLUDED_EXPLAIN_HPP
+#define INCLUDED_EXPLAIN_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Aggregates the output of `ninja -d explain` into the root causes of a rebuild.
+///
+/// ninja explains every dirty output on its own, a touched header shows up once for each object including it. The
+/// lines are fed one at a time as ninja prints them and only the counters per cause are kept.
+class rebuild_explanation
+{
+public:
+
+    static constexpr auto ENABLE_VAR = "VMK_NINJA_EXPLAIN"sv;
+    static constexpr auto DRY_RUN    = "dry-run"sv;
+    static constexpr auto PREFIX     = "ninja explain: "sv;
+    static constexpr auto MANIFEST   = "build.ninja"sv;
+
+    /// Returns false if `line` is not an explanation.
+    bool add(std::string_view line)
+    {
+        if (!line.starts_with(PREFIX)) {
+            return false;
+        }
+        line.remove_prefix(PREFIX.size());
+
+        if (auto input = newer_input(line); !input.empty()) {
+            if (output_of(line).ends_with(MANIFEST)) {
+                my_manifest_inputs[std::string{ input }]++;
+            } else {
+                my_newer_inputs[std::string{ input }]++;
+            }
+        } else if (line.starts_with("command line changed for "sv)) {
+            ++my_command_changed;
+        } else if (line.starts_with("output "sv) && line.ends_with(" doesn't exist"sv)) {
+            ++my_missing_outputs;
+        } else if (line.starts_with("deps for "sv) || line.starts_with("stored deps info out of date"sv)) {
+            ++my_missing_deps;
+        } else if (!line.ends_with(" is dirty"sv)) {
+            // "is dirty" only propagates a cause already counted for an input.
+            ++my_other;
+        }
+        return true;
+    }
+
+    /// Causes, the most expensive first.
+    std::vector<std::string> summary(std::size_t limit = 20) const
+    {
+        auto causes = std::vector<std::pair<std::size_t, std::string>>{};
+        for (const auto& [input, count] : my_manifest_inputs) {
+            // Regenerating the manifest may change every command, it always comes first.
+            causes.emplace_back(
+                std::numeric_limits<std::size_t>::max(), std::format("{} regenerated because {} changed", MANIFEST, input));
+        }
+        for (const auto& [input, count] : my_newer_inputs) {
+            causes.emplace_back(count, std::format("{} {} newer than {} outputs", kind_of(input), input, count));
+        }
+        if (my_command_changed > 0) {
+            causes.emplace_back(my_command_changed, std::format("command line changed for {} edges", my_command_changed));
+        }
+        if (my_missing_outputs > 0) {
+            causes.emplace_back(my_missing_outputs, std::format("{} outputs do not exist", my_missing_outputs));
+        }
+        if (my_missing_deps > 0) {
+            causes.emplace_back(my_missing_deps, std::format("dependency information missing for {} outputs", my_missing_deps));
+        }
+        if (my_other > 0) {
+            causes.emplace_back(my_other, std::format("{} other explanations", my_other));
+        }
+
+        std::ranges::stable_sort(causes, std::ranges::greater{}, &std::pair<std::size_t, std::string>::first);
+        if (causes.size() > limit) {
+            causes.resize(limit);
+        }
+
+        auto result = std::vector<std::string>{};
+        if (causes.empty()) {
+            result.push_back("🔎 nothing to rebuild"s);
+        }
+        for (auto& [_, cause] : causes) {
+            result.push_back(std::format("🔎 {}", cause));
+        }
+        return result;
+    }
+
+private:
+
+    std::map<std::string, std::size_t, std::less<>> my_manifest_inputs;
+    std::map<std::string, std::size_t, std::less<>> my_newer_inputs;
+    std::size_t                                     my_command_changed = 0;
+    std::size_t                                     my_missing_outputs = 0;
+    std::size_t                                     my_missing_deps    = 0;
+    std::size_t                                     my_other           = 0;
+
+    /// `output X older than most recent input Y (1 vs 2)` and `recorded mtime of X older than most recent input Y (…)`.
+    static std::string_view newer_input(std::string_view line)
+    {
+        static constexpr auto marker = " older than most recent input "sv;
+
+        auto start = line.find(marker);
+        if (start == line.npos) {
+            return {};
+        }
+        auto input = line.substr(start + marker.size());
+        return input.substr(0, input.rfind(" ("sv));
+    }
+
+    static std::string_view output_of(std::string_view line)
+    {
+        for (auto prefix : { "output "sv, "recorded mtime of "sv }) {
+            if (line.starts_with(prefix)) {
+                line.remove_prefix(prefix.size());
+                return line.substr(0, line.find(" older than "sv));
+            }
+        }
+        return {};
+    }
+
+    static std::string_view kind_of(std::string_view input)
+    {
+        static constexpr auto headers = std::array{ ".h"sv, ".hh"sv, ".hpp"sv, ".hxx"sv, ".inc"sv, ".inl"sv, ".ipp"sv };
+        auto extension = std::filesystem::path{ input }.extension().string();
+        return std::ranges::contains(headers, extension) ? "header"sv : "input"sv;
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_EXPLAIN_HPP
@@ -0,0 +1,146 @@
+#ifndef INCLUDED_FILE_COPY_HPP
+#define INCLUDED_FILE_COPY_HPP
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <system_error>
+
+namespace vb::maker {
+
+enum class copy_mode
+{
+    /// Reflink when the filesystem supports it, a real copy otherwise. The copies never share data.
+    clone_or_copy,
+    /// Reflink, or a hard link when source and destination are on the same filesystem, or a copy.
+    clone_or_link,
+};
+
+/// How `copy_file` placed a file.
+enum class copy_method
+{
+    symlink,
+    clone,
+    link,
+    copy,
+};
+
+/// Creates `to` as a reflink (copy on write clone) of `from`.
+///
+/// Only works on filesystems that support `FICLONE` (btrfs, xfs, bcachefs…), returns false otherwise.
+inline bool clone_file(const std::filesystem::path& from, const std::filesystem::path& to)
+{
+    auto in = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+
+    struct stat info{};
+    ::fstat(in, &info);
+
+    auto out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, info.st_mode & 07777);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+
+    auto cloned = ::ioctl(out, FICLONE, in) == 0;
+    ::close(out);
+    ::close(in);
+
+    if (!cloned) {
+        auto error = std::error_code{};
+        std::filesystem::remove(to, error);
+    }
+    return cloned;
+}
+
+/// Places a copy of `from` in `to`, replacing whatever was there, using the cheapest method allowed by `mode`.
+inline copy_method copy_file(const std::filesystem::path& from, const std::filesystem::path& to, copy_mode mode)
+{
+    auto error = std::error_code{};
+    std::filesystem::remove(to, error);
+
+    if (std::filesystem::is_symlink(from)) {
+        std::filesystem::copy_symlink(from, to);
+        return copy_method::symlink;
+    }
+
+    if (clone_file(from, to)) {
+        return copy_method::clone;
+    }
+
+    if (mode == copy_mode::clone_or_link) {
+        std::filesystem::create_hard_link(from, to, error);
+        if (!error) {
+            return copy_method::link;
+        }
+    }
+
+    // libstdc++ uses copy_file_range/sendfile here, so the data does not go through user space.
+    std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing);
+    return copy_method::copy;
+}
+
+using copy_filter = std::function<bool(const std::filesystem::path& relative)>;
+
+/// Copies every file under `from` into `to`, keeping the relative layout.
+///
+/// Entries for which `skip` returns true are not copied, for directories their whole content is skipped.
+/// The visitor is called with the relative path of each copied file.
+inline void copy_tree(
+    const std::filesystem::path&                                 from,
+    const std::filesystem::path&                                 to,
+    copy_mode                                                    mode,
+    const copy_filter&                                           skip    = {},
+    const std::function<void(const std::filesystem::path&)>& visitor = {})
+{
+    std::filesystem::create_directories(to);
+
+    for (auto it = std::filesystem::recursive_directory_iterator{ from };
+         it != std::filesystem::recursive_directory_iterator{};
+         ++it) {
+        // Not `relative`, which resolves the symbolic links: a link would then be copied over its target.
+        auto relative = it->path().lexically_relative(from);
+        if (skip && skip(relative)) {
+            if (it->is_directory() && !it->is_symlink()) {
+                it.disable_recursion_pending();
+            }
+            continue;
+        }
+
+        if (it->is_directory() && !it->is_symlink()) {
+            std::filesystem::create_directories(to / relative);
+        } else {
+            copy_file(it->path(), to / relative, mode);
+            if (visitor) {
+                visitor(relative);
+            }
+        }
+    }
+}
+
+/// Bytes of the regular files under `dir`, the symbolic links are not followed.
+inline std::uint64_t directory_size(const std::filesystem::path& dir)
+{
+    auto result = std::uint64_t{ 0 };
+    auto error  = std::error_code{};
+    for (auto it = std::filesystem::recursive_directory_iterator{ dir, error };
+         it != std::filesystem::recursive_directory_iterator{};
+         it.increment(error)) {
+        if (it->is_regular_file() && !it->is_symlink()) {
+            result += it->file_size(error);
+        }
+    }
+    return result;
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_FILE_COPY_HPP
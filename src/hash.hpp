@@ -0,0 +1,64 @@
+#ifndef INCLUDED_HASH_HPP
+#define INCLUDED_HASH_HPP
+
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Stable 64 bits FNV-1a hash.
+///
+/// Used to name cache and state entries, so it must not change between runs or compilers.
+struct fingerprint
+{
+    static constexpr std::uint64_t OFFSET = 0xcbf29ce484222325ULL;
+    static constexpr std::uint64_t PRIME  = 0x100000001b3ULL;
+
+    std::uint64_t value = OFFSET;
+
+    constexpr fingerprint() = default;
+
+    constexpr explicit fingerprint(std::string_view data)
+    {
+        add(data);
+    }
+
+    constexpr fingerprint& add(std::string_view data)
+    {
+        for (auto c : data) {
+            value ^= static_cast<std::uint8_t>(c);
+            value *= PRIME;
+        }
+        // Separator, so that ("ab", "c") and ("a", "bc") differ.
+        value ^= 0xffU;
+        value *= PRIME;
+        return *this;
+    }
+
+    constexpr fingerprint& add(std::uint64_t number)
+    {
+        for (auto shift = 0; shift < 64; shift += 8) {
+            value ^= (number >> shift) & 0xffU;
+            value *= PRIME;
+        }
+        return *this;
+    }
+
+    std::string hex() const
+    {
+        return std::format("{:016x}", value);
+    }
+
+    constexpr bool operator==(const fingerprint&) const = default;
+};
+
+static_assert(fingerprint{ "a"sv }.value != fingerprint{ "b"sv }.value);
+static_assert(fingerprint{}.add("ab").add("c").value != fingerprint{}.add("a").add("bc").value);
+
+} // namespace vb::maker
+
+#endif // INCLUDED_HASH_HPP
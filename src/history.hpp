@@ -0,0 +1,457 @@
+#ifndef INCLUDED_HISTORY_HPP
+#define INCLUDED_HISTORY_HPP
+
+#include "output_cache.hpp"
+#include "worktree.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// One measurement of a run, a stage, a single target built by a stage, or the size of an artifact.
+///
+/// Records have a fixed size so that the history can be appended to and read in place from a memory mapping.
+struct history_record
+{
+    enum class kind : std::uint8_t
+    {
+        stage,
+        target,
+        artifact,
+    };
+
+    static constexpr auto NAME_SIZE = std::size_t{ 94 };
+    static constexpr auto SIZES     = std::size_t{ 6 };
+
+    std::int64_t                     time          = 0; ///< Start of the run, seconds since the epoch.
+    std::uint64_t                    commit        = 0; ///< First 64 bits of the commit that was built.
+    std::uint64_t                    configuration = 0; ///< See `configuration_fingerprint`.
+    double                           duration      = 0.0;
+    double                           cpu_seconds   = 0.0;
+    std::uint64_t                    max_rss_bytes = 0;
+    std::array<std::uint64_t, SIZES> sizes{}; ///< Of an artifact, see `artifact_size::measurements`.
+    kind                             type      = kind::stage;
+    std::uint8_t                     succeeded = 0;
+    std::array<char, NAME_SIZE>      name{};
+
+    /// Long names keep their end, the file name of a target is more telling than its directory.
+    void set_name(std::string_view value)
+    {
+        if (value.size() > NAME_SIZE) {
+            value = value.substr(value.size() - NAME_SIZE);
+        }
+        name.fill('\0');
+        std::ranges::copy(value, name.begin());
+    }
+
+    std::string_view get_name() const
+    {
+        return { name.data(), static_cast<std::size_t>(std::ranges::find(name, '\0') - name.begin()) };
+    }
+
+    static std::uint64_t commit_id(std::string_view hash)
+    {
+        auto result = std::uint64_t{};
+        auto digits = hash.substr(0, 16);
+        std::from_chars(digits.data(), digits.data() + digits.size(), result, 16);
+        return result;
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<history_record>);
+static_assert(sizeof(history_record) == 192);
+
+/// Append-only file of `history_record`, one per project.
+///
+/// The file is a small header followed by the records. Readers map it in memory and see the records that were there
+/// when it was opened; writers append whole records, so concurrent runs never interleave partial records.
+class history
+{
+public:
+
+    static constexpr auto FILE     = "history.bin"sv;
+    static constexpr auto MAGIC    = std::array{ 'V', 'M', 'K', 'H', 'I', 'S', 'T', '2' };
+    static constexpr auto HEADER   = sizeof(MAGIC) + sizeof(std::uint64_t);
+    static constexpr auto BASELINE = std::size_t{ 20 };
+
+    explicit history(std::filesystem::path file)
+        : my_file{ std::move(file) }
+    {
+        auto fd = ::open(my_file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat info{};
+        if (::fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) > HEADER) {
+            auto mapped = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                my_map  = static_cast<const char*>(mapped);
+                my_size = static_cast<std::size_t>(info.st_size);
+            }
+        }
+        ::close(fd);
+
+        if (my_map != nullptr && !is_valid()) {
+            unmap();
+        }
+    }
+
+    /// The history of the repository containing `root`.
+    static history of(const std::filesystem::path& root)
+    {
+        return history{ repository_state_dir(root) / FILE };
+    }
+
+    history(const history&)            = delete;
+    history& operator=(const history&) = delete;
+
+    history(history&& other) noexcept
+        : my_file{ std::move(other.my_file) }
+        , my_map{ std::exchange(other.my_map, nullptr) }
+        , my_size{ std::exchange(other.my_size, 0) }
+    {
+    }
+
+    ~history()
+    {
+        unmap();
+    }
+
+    std::span<const history_record> records() const
+    {
+        if (my_map == nullptr) {
+            return {};
+        }
+        return { reinterpret_cast<const history_record*>(my_map + HEADER), (my_size - HEADER) / sizeof(history_record) };
+    }
+
+    /// Appends `added` to the file, the mapping still shows the records of when it was opened.
+    void append(std::span<const history_record> added) const
+    {
+        if (added.empty()) {
+            return;
+        }
+
+        create();
+        auto fd = ::open(my_file.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error{ errno, std::generic_category(), std::format("Could not open {}", my_file.string()) };
+        }
+
+        auto content = std::string_view{ reinterpret_cast<const char*>(added.data()), added.size_bytes() };
+        auto written = ::write(fd, content.data(), content.size());
+        ::close(fd);
+        if (written != static_cast<::ssize_t>(content.size())) {
+            throw std::system_error{ errno, std::generic_category(), std::format("Could not write {}", my_file.string()) };
+        }
+    }
+
+    /// The latest successful records of the same measurement, oldest first.
+    std::vector<history_record> baseline(const history_record& current, std::size_t count = BASELINE) const
+    {
+        auto result = std::vector<history_record>{};
+        for (const auto& record : records() | std::views::reverse) {
+            if (result.size() == count) {
+                break;
+            }
+            if (record.succeeded != 0 && record.type == current.type &&
+                record.configuration == current.configuration && record.get_name() == current.get_name()) {
+                result.push_back(record);
+            }
+        }
+        std::ranges::reverse(result);
+        return result;
+    }
+
+private:
+
+    std::filesystem::path my_file;
+    const char*           my_map  = nullptr;
+    std::size_t           my_size = 0;
+
+    /// Creates the file with its header if it does not exist yet, or replaces one written in an older format.
+    ///
+    /// The header is written to a temporary file which is then linked in place; the link fails when another run
+    /// created the file first, so the file never gets two headers, nor records before its header. An older file is
+    /// renamed over instead, two runs doing it at once may lose the records of one of them.
+    void create() const
+    {
+        auto existing = std::filesystem::exists(my_file);
+        if (existing) {
+            auto in    = std::ifstream{ my_file, std::ios::binary };
+            auto found = std::string(HEADER, '\0');
+            if (in.read(found.data(), static_cast<std::streamsize>(found.size())) && found == header()) {
+                return;
+            }
+        }
+
+        std::filesystem::create_directories(my_file.parent_path());
+        auto temporary = my_file.string() + ".XXXXXX";
+        auto fd        = ::mkstemp(temporary.data());
+        if (fd < 0) {
+            throw std::system_error{ errno, std::generic_category(), std::format("Could not create {}", temporary) };
+        }
+
+        auto content = header();
+        auto written = ::write(fd, content.data(), content.size());
+        ::fchmod(fd, 0644);
+        ::close(fd);
+
+        auto placed = written != static_cast<::ssize_t>(content.size()) ? -1
+                    : existing ? ::rename(temporary.c_str(), my_file.c_str())
+                               : ::link(temporary.c_str(), my_file.c_str());
+        auto error  = errno;
+        ::unlink(temporary.c_str());
+        if (placed != 0 && error != EEXIST) {
+            throw std::system_error{ error, std::generic_category(), std::format("Could not create {}", my_file.string()) };
+        }
+    }
+
+    /// The magic followed by the size of the records, a file written with other records is not read.
+    static std::string header()
+    {
+        auto record_size = std::uint64_t{ sizeof(history_record) };
+        auto result      = std::string{ MAGIC.data(), MAGIC.size() };
+        result.append(reinterpret_cast<const char*>(&record_size), sizeof(record_size));
+        return result;
+    }
+
+    bool is_valid() const
+    {
+        return std::string_view{ my_map, HEADER } == header();
+    }
+
+    void unmap()
+    {
+        if (my_map != nullptr) {
+            ::munmap(const_cast<char*>(my_map), my_size);
+            my_map  = nullptr;
+            my_size = 0;
+        }
+    }
+};
+
+/// How a measurement compares to its baseline.
+struct regression
+{
+    static constexpr auto MIN_SAMPLES  = std::size_t{ 5 };
+    static constexpr auto SIGMAS       = 3.0;
+    static constexpr auto MIN_INCREASE = 0.15;
+    static constexpr auto MIN_SECONDS  = 0.5;
+
+    double mean   = 0.0;
+    double stddev = 0.0;
+
+    static regression of(std::span<const history_record> samples)
+    {
+        auto result = regression{};
+        if (samples.empty()) {
+            return result;
+        }
+        for (const auto& sample : samples) {
+            result.mean += sample.duration;
+        }
+        result.mean /= static_cast<double>(samples.size());
+        for (const auto& sample : samples) {
+            result.stddev += (sample.duration - result.mean) * (sample.duration - result.mean);
+        }
+        result.stddev = std::sqrt(result.stddev / static_cast<double>(samples.size()));
+        return result;
+    }
+
+    /// Slower than 3σ above the mean, and by more than 15%: a noisy stage alone is not a regression, and neither is a
+    /// few milliseconds over a stage that never varies.
+    static bool is_slower(const history_record& current, std::span<const history_record> samples)
+    {
+        if (samples.size() < MIN_SAMPLES) {
+            return false;
+        }
+        auto base = of(samples);
+        return current.duration > base.mean + SIGMAS * base.stddev &&
+               current.duration > base.mean * (1.0 + MIN_INCREASE) && current.duration - base.mean > MIN_SECONDS;
+    }
+};
+
+/// Warnings for the measurements of the current run that are slower than their baseline.
+inline std::vector<std::string> find_regressions(const history& past, std::span<const history_record> current)
+{
+    auto result = std::vector<std::string>{};
+    for (const auto& record : current) {
+        if (record.succeeded == 0) {
+            continue;
+        }
+        auto samples = past.baseline(record);
+        if (regression::is_slower(record, samples)) {
+            auto base = regression::of(samples);
+            result.push_back(std::format(
+                "🐢 {} {} took {:.1f}s, {:.0f}% more than its usual {:.1f}s ± {:.1f}s",
+                record.type == history_record::kind::stage ? "stage"sv : "target"sv,
+                record.get_name(),
+                record.duration,
+                (record.duration / base.mean - 1.0) * 100.0,
+                base.mean,
+                base.stddev));
+        }
+    }
+    return result;
+}
+
+/// Collects the measurements of the current run, appended to the history when the run ends.
+class history_recorder
+{
+public:
+
+    history_recorder(std::filesystem::path root, std::uint64_t configuration)
+        : my_root{ std::move(root) }
+        , my_configuration{ configuration }
+        , my_time{ std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count() }
+    {
+    }
+
+    void add(
+        history_record::kind type,
+        std::string_view     name,
+        double               duration,
+        bool                 succeeded,
+        double               cpu_seconds   = 0.0,
+        std::uint64_t        max_rss_bytes = 0)
+    {
+        auto record          = history_record{};
+        record.time          = my_time;
+        record.configuration = my_configuration;
+        record.duration      = duration;
+        record.cpu_seconds   = cpu_seconds;
+        record.max_rss_bytes = max_rss_bytes;
+        record.type          = type;
+        record.succeeded     = succeeded ? 1 : 0;
+        record.set_name(name);
+        my_records.push_back(record);
+    }
+
+    void add_sizes(std::string_view name, const std::array<std::uint64_t, history_record::SIZES>& sizes)
+    {
+        add(history_record::kind::artifact, name, 0.0, true);
+        my_records.back().sizes = sizes;
+    }
+
+    /// Appends the run to the history, and returns the warnings about what got slower.
+    std::vector<std::string> finish()
+    {
+        if (my_records.empty()) {
+            return {};
+        }
+
+        auto head   = details::tool_output("git"sv, "-C"sv, my_root.string(), "rev-parse"sv, "HEAD"sv);
+        auto commit = head.has_value() && !head->empty() ? history_record::commit_id(head->front()) : 0;
+        for (auto& record : my_records) {
+            record.commit = commit;
+        }
+
+        auto past     = history::of(my_root);
+        auto warnings = find_regressions(past, my_records);
+        try {
+            past.append(my_records);
+        } catch (const std::system_error& error) {
+            warnings.push_back(std::format("⚠ could not record the build history: {}", error.what()));
+        }
+        my_records.clear();
+        return warnings;
+    }
+
+private:
+
+    std::filesystem::path       my_root;
+    std::uint64_t               my_configuration;
+    std::int64_t                my_time;
+    std::vector<history_record> my_records;
+};
+
+/// Duration trend of every stage of the current configuration, and the slowest targets of the last run.
+inline std::vector<std::string> history_report(const history& past, std::uint64_t configuration)
+{
+    static constexpr auto bars = std::array{ "▁"sv, "▂"sv, "▃"sv, "▄"sv, "▅"sv, "▆"sv, "▇"sv, "█"sv };
+
+    auto result  = std::vector<std::string>{};
+    auto records = past.records();
+    auto stages  = std::map<std::string_view, std::vector<const history_record*>>{};
+    auto last    = std::int64_t{};
+    for (const auto& record : records) {
+        if (record.configuration != configuration) {
+            continue;
+        }
+        if (record.type == history_record::kind::stage) {
+            stages[record.get_name()].push_back(&record);
+        }
+        last = std::max(last, record.time);
+    }
+
+    if (stages.empty()) {
+        result.push_back("No history for this configuration yet."s);
+        return result;
+    }
+
+    for (const auto& [name, runs] : stages) {
+        auto recent    = runs | std::views::drop(runs.size() > history::BASELINE ? runs.size() - history::BASELINE : 0);
+        auto durations = std::ranges::to<std::vector>(recent | std::views::transform([](const auto* run) {
+                                                           return run->duration;
+                                                       }));
+        auto [low, high] = std::ranges::minmax(durations);
+        auto trend       = std::string{};
+        for (auto duration : durations) {
+            auto level = high > low ? (duration - low) / (high - low) : 0.0;
+            trend += bars[static_cast<std::size_t>(level * (bars.size() - 1))];
+        }
+        const auto& latest = *runs.back();
+        result.push_back(std::format(
+            "{:<40} {} last {:.1f}s, min {:.1f}s, max {:.1f}s over {} runs",
+            name, trend, latest.duration, low, high, durations.size()));
+    }
+
+    auto targets = std::ranges::to<std::vector>(
+        records | std::views::filter([&](const auto& record) {
+            return record.type == history_record::kind::target && record.time == last &&
+                   record.configuration == configuration;
+        }));
+    if (!targets.empty()) {
+        std::ranges::sort(targets, std::ranges::greater{}, &history_record::duration);
+        result.push_back("Slowest targets of the last run:"s);
+        for (const auto& target : targets) {
+            result.push_back(std::format("    {:>8.2f}s {}", target.duration, target.get_name()));
+        }
+    }
+    return result;
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_HISTORY_HPP
@@ -0,0 +1,322 @@
+#ifndef INCLUDED_HOTSPOTS_HPP
+#define INCLUDED_HOTSPOTS_HPP
+
+#include "state.hpp"
+#include <util/execution.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Headers that cost the most build time, from the dependencies ninja recorded and the time each edge took.
+///
+/// The compile times come from `.ninja_log` and must all be added before the dependencies: `ninja -t deps` prints every
+/// object followed by its inputs, the lines are consumed as they come and only the totals per header are kept.
+class header_hotspots
+{
+public:
+
+    static constexpr auto COMMAND  = "hotspots"sv;
+    static constexpr auto PCH_FILE = "pch_candidates.cmake"sv;
+    static constexpr auto PCH_VAR  = "VMK_PCH_CANDIDATES"sv;
+
+    /// A header is worth precompiling when at least this share of the translation units includes it.
+    static constexpr auto PCH_MIN_SHARE = 0.5;
+    static constexpr auto PCH_MAX_COUNT = std::size_t{ 20 };
+
+    struct header
+    {
+        std::filesystem::path path;
+        std::size_t           includers       = 0;
+        double                rebuild_seconds = 0.0;
+    };
+
+    header_hotspots(std::filesystem::path root, std::filesystem::path build_dir)
+        : my_root{ std::move(root) }
+        , my_build_dir{ std::move(build_dir) }
+    {
+    }
+
+    /// A `.ninja_log` entry: `start end mtime output hash`, with times in milliseconds. The last entry of an output wins.
+    void add_log_entry(std::string_view entry)
+    {
+        auto fields = std::array<std::string_view, 4>{};
+        for (auto& field : fields) {
+            auto tab = entry.find('\t');
+            if (tab == entry.npos && &field != &fields.back()) {
+                return;
+            }
+            field = entry.substr(0, tab);
+            entry = tab == entry.npos ? ""sv : entry.substr(tab + 1);
+        }
+
+        auto start = 0L;
+        auto end   = 0L;
+        std::from_chars(fields[0].data(), fields[0].data() + fields[0].size(), start);
+        std::from_chars(fields[1].data(), fields[1].data() + fields[1].size(), end);
+        my_durations.insert_or_assign(std::string{ fields[3] }, static_cast<double>(end - start) / 1000.0);
+    }
+
+    /// A line of `ninja -t deps`: `output: #deps 3, deps mtime 123 (VALID)`, then one indented line per input.
+    void add_deps_line(std::string_view line)
+    {
+        if (line.empty()) {
+            return;
+        }
+
+        if (!line.starts_with(' ')) {
+            auto output = line.substr(0, line.find(": #deps"sv));
+            auto found  = my_durations.find(output);
+            my_seconds  = found == my_durations.end() ? 0.0 : found->second;
+            my_is_unit  = false;
+            return;
+        }
+
+        auto input = std::filesystem::path{ line.substr(line.find_first_not_of(' ')) };
+        if (is_source(input)) {
+            if (!my_is_unit) {
+                my_is_unit = true;
+                ++my_units;
+            }
+            return;
+        }
+
+        auto& found = my_headers[(my_build_dir / input).lexically_normal()];
+        found.includers++;
+        found.rebuild_seconds += my_seconds;
+    }
+
+    std::size_t units() const
+    {
+        return my_units;
+    }
+
+    /// What touching each header costs: the compile time of all the translation units including it.
+    std::vector<header> by_rebuild_cost(std::size_t limit) const
+    {
+        return ranked(limit, [](const header& left, const header& right) {
+            return std::tuple{ left.rebuild_seconds, left.includers } > std::tuple{ right.rebuild_seconds, right.includers };
+        });
+    }
+
+    std::vector<header> by_inclusions(std::size_t limit) const
+    {
+        return ranked(limit, [](const header& left, const header& right) {
+            return std::tuple{ left.includers, left.rebuild_seconds } > std::tuple{ right.includers, right.rebuild_seconds };
+        });
+    }
+
+    /// Headers from outside the project included by most translation units, spelled as they would be included.
+    ///
+    /// Project headers are left out: touching a precompiled header rebuilds every target using it. So are the
+    /// implementation headers of libraries, they come with the public headers including them.
+    std::vector<std::string> pch_candidates() const
+    {
+        auto result = std::vector<std::string>{};
+        for (const auto& candidate : by_rebuild_cost(my_headers.size())) {
+            if (result.size() == PCH_MAX_COUNT) {
+                break;
+            }
+            if (static_cast<double>(candidate.includers) < PCH_MIN_SHARE * static_cast<double>(my_units) ||
+                is_inside(candidate.path, my_root) || is_private(candidate.path)) {
+                continue;
+            }
+            result.push_back(include_of(candidate.path));
+        }
+        return result;
+    }
+
+    /// Sets a list to pass to `target_precompile_headers`.
+    std::string pch_cmake() const
+    {
+        auto result = std::format(
+            "# Generated by `vmk {}`, use with:\n#   target_precompile_headers(«target» PRIVATE ${{{}}})\nset({}\n",
+            COMMAND,
+            PCH_VAR,
+            PCH_VAR);
+        for (const auto& candidate : pch_candidates()) {
+            result += std::format("    \"{}\"\n", candidate);
+        }
+        result += ")\n"sv;
+        return result;
+    }
+
+    std::vector<std::string> summary(std::size_t limit = 15) const
+    {
+        auto result = std::vector<std::string>{};
+        if (my_headers.empty()) {
+            result.push_back("🔥 ninja recorded no header dependencies, build first"s);
+            return result;
+        }
+
+        result.push_back(std::format("🔥 rebuild cost if touched, over {} translation units:", my_units));
+        for (const auto& found : by_rebuild_cost(limit)) {
+            result.push_back(std::format("    {:>9.1f}s {:>6} TUs  {}", found.rebuild_seconds, found.includers, display(found.path)));
+        }
+        result.push_back("🔥 most included:"s);
+        for (const auto& found : by_inclusions(limit)) {
+            result.push_back(std::format("    {:>6} TUs {:>9.1f}s  {}", found.includers, found.rebuild_seconds, display(found.path)));
+        }
+
+        auto candidates = pch_candidates();
+        if (candidates.empty()) {
+            result.push_back("📦 no precompiled header candidates"s);
+        } else {
+            result.push_back(std::format("📦 precompiled header candidates: {}", candidates));
+        }
+        return result;
+    }
+
+    /// The directory with ninja's dependency log under `build_dir`, the one written last if there are several.
+    static std::optional<std::filesystem::path> find_build_dir(const std::filesystem::path& build_dir)
+    {
+        auto result = std::optional<std::filesystem::path>{};
+        auto newest = std::filesystem::file_time_type::min();
+        auto consider = [&](const std::filesystem::path& dir) {
+            auto error = std::error_code{};
+            auto time  = std::filesystem::last_write_time(dir / ".ninja_deps", error);
+            if (!error && time > newest) {
+                newest = time;
+                result = dir;
+            }
+        };
+
+        consider(build_dir);
+        auto error = std::error_code{};
+        for (auto it = std::filesystem::recursive_directory_iterator{ build_dir, error };
+             it != std::filesystem::recursive_directory_iterator{};
+             it.increment(error)) {
+            if (it->is_directory() && !it->is_symlink()) {
+                consider(it->path());
+            }
+            if (it.depth() >= MAX_DEPTH || it->path().filename() == ".vmk") {
+                it.disable_recursion_pending();
+            }
+        }
+        return result;
+    }
+
+    /// Reads the logs of the ninja build in `build_dir` and writes the precompiled header candidates next to them.
+    static std::vector<std::string> analyze(const std::filesystem::path& root, const std::filesystem::path& build_dir)
+    {
+        auto hotspots = header_hotspots{ root, build_dir };
+
+        auto log = std::ifstream{ build_dir / ".ninja_log" };
+        for (auto line = std::string{}; std::getline(log, line);) {
+            if (!line.starts_with('#')) {
+                hotspots.add_log_entry(line);
+            }
+        }
+
+        execution ninja{ io_set::OUT };
+        ninja.execute("ninja"sv, std::array{ "-C"s, build_dir.string(), "-t"s, "deps"s });
+        for (const auto& line : ninja.lines<std_io::OUT>()) {
+            hotspots.add_deps_line(line);
+        }
+        ninja.wait();
+
+        auto result = hotspots.summary();
+        if (!hotspots.pch_candidates().empty()) {
+            auto file = state_dir(build_dir) / PCH_FILE;
+            write_atomically(file, hotspots.pch_cmake());
+            result.push_back(std::format("📦 include({}) and pass ${{{}}} to target_precompile_headers", file.string(), PCH_VAR));
+        }
+        return result;
+    }
+
+private:
+
+    static constexpr auto MAX_DEPTH = 3;
+
+    std::filesystem::path                      my_root;
+    std::filesystem::path                      my_build_dir;
+    std::map<std::string, double, std::less<>> my_durations;
+    std::map<std::filesystem::path, header>    my_headers;
+    std::size_t                                my_units   = 0;
+    double                                     my_seconds = 0.0;
+    bool                                       my_is_unit = false;
+
+    std::vector<header> ranked(std::size_t limit, auto compare) const
+    {
+        auto result = std::vector<header>{};
+        result.reserve(my_headers.size());
+        for (const auto& [path, found] : my_headers) {
+            result.push_back(found);
+            result.back().path = path;
+        }
+
+        auto count = std::min(limit, result.size());
+        std::ranges::partial_sort(result, result.begin() + static_cast<std::ptrdiff_t>(count), compare);
+        result.resize(count);
+        return result;
+    }
+
+    static bool is_source(const std::filesystem::path& input)
+    {
+        static constexpr auto sources =
+            std::array{ ".c"sv, ".cc"sv, ".cpp"sv, ".cxx"sv, ".c++"sv, ".C"sv, ".m"sv, ".mm"sv, ".cu"sv, ".cppm"sv, ".ixx"sv };
+        return std::ranges::contains(sources, input.extension().string());
+    }
+
+    static bool is_inside(const std::filesystem::path& path, const std::filesystem::path& dir)
+    {
+        auto relative = path.lexically_relative(dir);
+        return !relative.empty() && *relative.begin() != "..";
+    }
+
+    /// Headers meant to be included only by the other headers of their library.
+    static bool is_private(const std::filesystem::path& header)
+    {
+        static constexpr auto private_dirs = std::array{ "bits"sv, "detail"sv, "details"sv, "impl"sv, "internal"sv };
+        if (header.extension() == ".tcc") {
+            return true;
+        }
+        for (const auto& part : header.parent_path()) {
+            auto name = part.string();
+            if (std::ranges::contains(private_dirs, std::string_view{ name }) || name.starts_with("__") ||
+                name.ends_with("-linux-gnu")) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// `<vector>` for `/usr/include/c++/14/vector`, `<fmt/format.h>` for `…/include/fmt/format.h`.
+    static std::string include_of(const std::filesystem::path& header)
+    {
+        auto text = header.generic_string();
+        if (auto standard = text.rfind("/include/c++/"sv); standard != text.npos) {
+            auto name = std::string_view{ text }.substr(standard + "/include/c++/"sv.size());
+            if (auto version = name.find('/'); version != name.npos) {
+                return std::format("<{}>", name.substr(version + 1));
+            }
+        }
+        if (auto include = text.rfind("/include/"sv); include != text.npos) {
+            return std::format("<{}>", std::string_view{ text }.substr(include + "/include/"sv.size()));
+        }
+        return text;
+    }
+
+    std::string display(const std::filesystem::path& header) const
+    {
+        return is_inside(header, my_root) ? header.lexically_relative(my_root).generic_string() : include_of(header);
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_HOTSPOTS_HPP
@@ -0,0 +1,96 @@
+#ifndef INCLUDED_HTML_TABLE_HPP
+#define INCLUDED_HTML_TABLE_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+using table_row = std::vector<std::string>;
+
+namespace details {
+
+inline std::string strip_markup(std::string_view cell)
+{
+    auto result = std::string{};
+    auto in_tag = false;
+    for (auto c : cell) {
+        if (c == '<') {
+            in_tag = true;
+        } else if (c == '>') {
+            in_tag = false;
+        } else if (!in_tag) {
+            result.push_back(c == '\n' || c == '\t' ? ' ' : c);
+        }
+    }
+
+    static constexpr auto blanks = " \r"sv;
+    auto                  start  = result.find_first_not_of(blanks);
+    if (start == result.npos) {
+        return {};
+    }
+    return result.substr(start, result.find_last_not_of(blanks) - start + 1);
+}
+
+} // namespace details
+
+/// Extracts the text of every cell of every `<tr>` in a HTML document.
+///
+/// Tool reports (cargo `--timings`, gradle `--profile`) are plain HTML tables, this is just enough to read them
+/// without a HTML parser.
+inline std::vector<table_row> html_table_rows(std::string_view html)
+{
+    auto result = std::vector<table_row>{};
+
+    for (auto row_start = html.find("<tr"); row_start != html.npos; row_start = html.find("<tr", row_start)) {
+        auto row_end = html.find("</tr>", row_start);
+        auto row     = html.substr(row_start, row_end == html.npos ? html.npos : row_end - row_start);
+
+        auto cells = table_row{};
+        for (auto cell_start = row.find("<t", 3); cell_start != row.npos; cell_start = row.find("<t", cell_start)) {
+            if (row.substr(cell_start, 3) != "<td"sv && row.substr(cell_start, 3) != "<th"sv) {
+                ++cell_start;
+                continue;
+            }
+            auto content_start = row.find('>', cell_start);
+            if (content_start == row.npos) {
+                break;
+            }
+            ++content_start;
+            auto cell_end = row.find("</t", content_start);
+            cells.push_back(details::strip_markup(row.substr(content_start, cell_end - content_start)));
+            cell_start = cell_end;
+        }
+
+        if (!cells.empty()) {
+            result.push_back(std::move(cells));
+        }
+
+        if (row_end == html.npos) {
+            break;
+        }
+        row_start = row_end;
+    }
+    return result;
+}
+
+inline std::vector<table_row> read_html_table(const std::filesystem::path& report)
+{
+    if (!std::filesystem::is_regular_file(report)) {
+        return {};
+    }
+
+    auto content = std::ostringstream{};
+    content << std::ifstream{ report }.rdbuf();
+    return html_table_rows(content.view());
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_HTML_TABLE_HPP
@@ -0,0 +1,195 @@
+#ifndef INCLUDED_INSTALL_TREE_HPP
+#define INCLUDED_INSTALL_TREE_HPP
+
+#include "artifact_sizes.hpp"
+#include "file_copy.hpp"
+#include "output_cache.hpp"
+#include "parallel.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Moves a staged installation to its destination, and strips the debug information of what was installed.
+///
+/// The tools install into a staging tree next to the build, where they only rewrite what changed. From there every
+/// file goes to the destination as a reflink, or a copy when the filesystem cannot share data; files with the same size
+/// and modification time as the destination are left alone. Nothing is hard linked: the next install, or a strip,
+/// would then modify the installed file in place.
+class install_tree
+{
+public:
+
+    enum class strip_mode
+    {
+        none,
+        strip, ///< The debug sections are removed.
+        split, ///< The debug sections move to `«file».debug`, found through a `.gnu_debuglink`.
+    };
+
+    struct report
+    {
+        std::size_t   unchanged = 0;
+        std::size_t   cloned    = 0;
+        std::size_t   copied    = 0;
+        std::size_t   stripped  = 0;
+        std::uint64_t bytes     = 0; ///< Size of the files that were placed.
+        std::vector<std::string> errors;
+
+        std::string summary() const
+        {
+            return std::format(
+                "📦 {} files installed, {} reflinked, {} copied, {} unchanged{}",
+                cloned + copied,
+                cloned,
+                copied,
+                unchanged,
+                stripped == 0 ? ""s : std::format(", {} stripped", stripped));
+        }
+    };
+
+    static strip_mode mode_of(std::string_view name)
+    {
+        if (name == "strip"sv) {
+            return strip_mode::strip;
+        }
+        if (name == "split"sv) {
+            return strip_mode::split;
+        }
+        return strip_mode::none;
+    }
+
+    /// Whether `to` is already what `from` would be placed as.
+    static bool unchanged(const std::filesystem::path& from, const std::filesystem::path& to)
+    {
+        auto error = std::error_code{};
+        if (std::filesystem::is_symlink(from, error)) {
+            return std::filesystem::is_symlink(to, error) &&
+                   std::filesystem::read_symlink(from, error) == std::filesystem::read_symlink(to, error);
+        }
+        auto size = std::filesystem::file_size(to, error);
+        if (error || std::filesystem::is_symlink(to, error) || size != std::filesystem::file_size(from, error)) {
+            return false;
+        }
+        auto time = std::filesystem::last_write_time(to, error);
+        return !error && time == std::filesystem::last_write_time(from, error);
+    }
+
+    /// Places every file of `staging` at the same relative path under `destination`.
+    static report sync(const std::filesystem::path& staging, const std::filesystem::path& destination)
+    {
+        auto result = report{};
+        auto files  = std::vector<std::filesystem::path>{};
+        auto error  = std::error_code{};
+        for (auto it = std::filesystem::recursive_directory_iterator{ staging, error };
+             it != std::filesystem::recursive_directory_iterator{};
+             it.increment(error)) {
+            if (it->is_symlink(error) || !it->is_directory(error)) {
+                files.push_back(it->path().lexically_relative(staging));
+            }
+        }
+
+        auto lock = std::mutex{};
+        for_each_parallel(files, [&](const std::filesystem::path& relative) {
+            auto from = staging / relative;
+            auto to   = destination / relative;
+            if (unchanged(from, to)) {
+                auto guard = std::lock_guard{ lock };
+                ++result.unchanged;
+                return;
+            }
+
+            // The new file is written next to the installed one then renamed over it, so a program that is running
+            // keeps its own version and nothing ever sees a partial file.
+            auto failure   = std::error_code{};
+            auto temporary = to;
+            temporary += std::format(".{}.tmp", ::getpid());
+            std::filesystem::create_directories(to.parent_path(), failure);
+            try {
+                auto method = copy_file(from, temporary, copy_mode::clone_or_copy);
+                if (method != copy_method::symlink) {
+                    std::filesystem::last_write_time(temporary, std::filesystem::last_write_time(from), failure);
+                }
+                std::filesystem::rename(temporary, to);
+
+                auto size  = method == copy_method::symlink ? 0 : std::filesystem::file_size(from, failure);
+                auto guard = std::lock_guard{ lock };
+                result.bytes += size;
+                if (method == copy_method::clone) {
+                    ++result.cloned;
+                } else {
+                    ++result.copied;
+                }
+            } catch (const std::filesystem::filesystem_error& problem) {
+                std::filesystem::remove(temporary, failure);
+                auto guard = std::lock_guard{ lock };
+                result.errors.push_back(problem.what());
+            }
+        });
+        return result;
+    }
+
+    /// Strips, or splits, the executables and libraries of `tree` that still have debug information.
+    ///
+    /// Their modification time is kept, so the install tools still see them as up to date.
+    static std::size_t strip(const std::filesystem::path& tree, strip_mode mode, std::vector<std::string>& errors)
+    {
+        if (mode == strip_mode::none) {
+            return 0;
+        }
+
+        auto files = std::vector<std::filesystem::path>{};
+        for (const auto& artifact : artifact_sizes::scan(tree)) {
+            // The split debug files are nothing but debug information.
+            if (artifact.debug > 0 && !artifact.name.ends_with(".debug"sv)) {
+                files.push_back(tree / artifact.name);
+            }
+        }
+
+        auto lock     = std::mutex{};
+        auto stripped = std::atomic<std::size_t>{ 0 };
+        for_each_parallel(files, [&](const std::filesystem::path& file) {
+            auto failure = std::error_code{};
+            auto time    = std::filesystem::last_write_time(file, failure);
+            auto done    = mode == strip_mode::strip
+                               ? details::tool_output("strip"sv, "--strip-debug"sv, file.string()).has_value()
+                               : split_debug(file);
+            std::filesystem::last_write_time(file, time, failure);
+            if (done) {
+                ++stripped;
+            } else {
+                auto guard = std::lock_guard{ lock };
+                errors.push_back(std::format("could not strip {}", file.string()));
+            }
+        });
+        return stripped;
+    }
+
+private:
+
+    static bool split_debug(const std::filesystem::path& file)
+    {
+        auto debug = file.string() + ".debug";
+        return details::tool_output("objcopy"sv, "--only-keep-debug"sv, file.string(), debug).has_value() &&
+               details::tool_output(
+                   "objcopy"sv, "--strip-debug"sv, std::format("--add-gnu-debuglink={}", debug), file.string())
+                   .has_value();
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_INSTALL_TREE_HPP
@@ -0,0 +1,108 @@
+#ifndef INCLUDED_JOURNAL_HPP
+#define INCLUDED_JOURNAL_HPP
+
+#include "builder.hpp"
+#include "hash.hpp"
+#include "state.hpp"
+#include "tasks.hpp"
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <ranges>
+#include <string>
+#include <string_view>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Outcome of the stages of the previous runs, kept in the build directory.
+///
+/// Each stage is recorded with a fingerprint of its command line and of its input files. With `--resume` the stages
+/// that succeeded last time and whose fingerprint did not change are not run again, up to the first one that failed
+/// or changed; every stage after it runs as usual. Only pre-requisites and configuration stages can be skipped, the
+/// build tools already know what is up to date and tests must run to be of any use.
+///
+/// The command line is taken from the builder before the stage runs, which is why `get_arguments` must have no effect.
+class journal
+{
+public:
+
+    static constexpr auto FILE = "journal.json"sv;
+
+    explicit journal(std::filesystem::path build_dir)
+        : my_build_dir{ std::move(build_dir) }
+        , my_entries{ nlohmann::json::parse(read_file(my_build_dir / ".vmk" / FILE), nullptr, false) }
+    {
+        if (!my_entries.is_object()) {
+            my_entries = nlohmann::json::object();
+        }
+    }
+
+    static bool is_resumable(Stage stage)
+    {
+        return stage.type() == task_type::pre_requisites || stage.type() == task_type::configuration;
+    }
+
+    static std::string key_of(const builder_base& builder)
+    {
+        return std::format("{}/{}", builder.stage().name(), builder.name());
+    }
+
+    static std::string fingerprint_of(
+        const builder_base&            builder,
+        builder_base::targets_type     targets,
+        const std::ranges::range auto& extra_arguments)
+    {
+        auto result = fingerprint{};
+        for (const auto& argument : builder.command_line(targets)) {
+            result.add(argument);
+        }
+        for (const auto& argument : extra_arguments) {
+            result.add(std::string_view{ argument });
+        }
+        for (const auto& input : builder.inputs()) {
+            auto error = std::error_code{};
+            result.add(input.string());
+            result.add(static_cast<std::uint64_t>(std::filesystem::file_size(input, error)));
+            result.add(static_cast<std::uint64_t>(
+                std::filesystem::last_write_time(input, error).time_since_epoch().count()));
+        }
+        return result.hex();
+    }
+
+    /// True if the stage succeeded the last time it ran, with the same inputs.
+    bool is_done(
+        const builder_base&            builder,
+        builder_base::targets_type     targets,
+        const std::ranges::range auto& extra_arguments) const
+    {
+        auto entry = my_entries.find(key_of(builder));
+        return is_resumable(builder.stage()) && entry != my_entries.end() && entry->value("succeeded", false) &&
+               entry->value("fingerprint", ""s) == fingerprint_of(builder, targets, extra_arguments);
+    }
+
+    void record(
+        const builder_base&            builder,
+        builder_base::targets_type     targets,
+        const std::ranges::range auto& extra_arguments,
+        bool                           succeeded)
+    {
+        my_entries[key_of(builder)] = {
+            { "fingerprint", fingerprint_of(builder, targets, extra_arguments) },
+            { "succeeded", succeeded },
+        };
+        write_atomically(state_dir(my_build_dir) / FILE, my_entries.dump(2));
+    }
+
+private:
+
+    std::filesystem::path my_build_dir;
+    nlohmann::json        my_entries;
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_JOURNAL_HPP
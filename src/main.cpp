@@ -1,11 +1,27 @@
 #include "arguments.hpp"
+#include "artifact_sizes.hpp"
+#include "background.hpp"
 #include "builders.hpp"
+#include "cmake_profile.hpp"
+#include "compile_database.hpp"
+#include "compile_profile.hpp"
+#include "explain.hpp"
+#include "history.hpp"
+#include "hotspots.hpp"
+#include "journal.hpp"
+#include "metrics.hpp"
+#include "pipeline_trace.hpp"
+#include "ram_build_dir.hpp"
+#include "startup.hpp"
 #include "tasks.hpp"
+#include "worktree_sharing.hpp"
 #include <util/converters.hpp>
 #include <util/environment.hpp>
 #include <util/options.hpp>
 
+#include <chrono>
 #include <filesystem>
+#include <optional>
 #include <print>
 #include <ranges>
 #include <string_view>
@@ -14,51 +30,6 @@
 using namespace vb;
 using namespace std::literals;
 
-constexpr auto default_environment = std::array{
-    "CC"sv,
-    "CXX"sv,
-    "DISPLAY"sv,
-    "GID"sv,
-    "HOME"sv,
-    "HOST"sv,
-    "HOSTNAME"sv,
-    "LANG"sv,
-    "LC_ADDRESS"sv,
-    "LC_ALL"sv,
-    "LC_ALL"sv,
-    "LC_MEASUREMENT"sv,
-    "LC_MONETARY"sv,
-    "LC_NUMERIC"sv,
-    "LC_PAPER"sv,
-    "LC_TELEPHONE"sv,
-    "LC_TIME"sv,
-    "PATH"sv,
-    "SHELL"sv,
-    "SSH_AGENT_PID"sv,
-    "SSH_AUTO_SOCK"sv,
-    "TERM"sv,
-    "TTY"sv,
-    "UID"sv,
-    "USER"sv,
-    "USERNAME"sv,
-    "WAYLAND_DISPLAY"sv,
-    "XDG_CACHE_HOME"sv,
-    "XDG_CONFIG_DIRS"sv,
-    "XDG_CONFIG_HOME"sv,
-    "XDG_DATA_DIRS"sv,
-    "XDG_DATA_HOME"sv,
-    "XDG_DESKTOP_DIR"sv,
-    "XDG_DOCUMENTS_DIR"sv,
-    "XDG_DOWNLOAD_DIR"sv,
-    "XDG_MUSIC_DIR"sv,
-    "XDG_PICTURES_DIR"sv,
-    "XDG_PUBLICSHARE_DIR"sv,
-    "XDG_RUNTIME_DIR"sv,
-    "XDG_STATE_HOME"sv,
-    "XDG_TEMPLATES_DIR"sv,
-    "XDG_VIDEOS_DIR"sv,
-};
-
 int main(int argc, const char *argv[])
 {
     using namespace vb;
@@ -68,67 +39,287 @@ int main(int argc, const char *argv[])
 
     auto main_options = maker::Stage::main_arguments(args);
 
+    auto profile = maker::startup_profile{ maker::find_argument(main_options, "--startup-profile"sv).has_value() };
+
     if (auto found = maker::find_argument(main_options, "-h"sv, "--help"sv, "-?"sv); found.has_value()) {
-        std::println("Usage: {} «Options» ---«stage» options for stages", maker::command_from_args(all_arguments));
+        std::println("Usage: {} «Options» «targets…» ---«stage» options for stages", maker::command_from_args(all_arguments));
         for(auto stage : vb::maker::all_stages) {
             std::println("\t---{} : stage {} - {}",stage.option(), stage.name(), stage.information()); 
         }
+        std::println("\texplain [--dry-run] : {}", "As the only target: build, and summarize why ninja rebuilt what it did. With --dry-run nothing is built.");
+        std::println("\thistory : {}", "As the only target: show how long the stages took over the last runs, and the slowest targets.");
+        std::println("\thotspots : {}", "As the only target: rank the headers by the time their changes cost to rebuild, and suggest precompiled headers.");
+        std::println("\t--background[=pause] : {}", "Run the tools on the spare capacity only. With pause they are stopped while the machine is busy.");
         std::println("\t--list-env : {}", "Lists all the environment variables that are exported. Some builders may export additional variables.");
+        std::println("\t--metrics-file=«path» : {}", "Write the measurements of each stage to «path» in the Prometheus text format.");
+        std::println("\t--pgo[=«command»] : {}", "Build with profile guided optimization, trained by the tests, the benchmarks with ---bench, or «command».");
+        std::println("\t--profile-compile : {}", "Build in a separate directory with the compilers timing themselves, and show where the time went.");
+        std::println("\t--profile-configure : {}", "Profile the cmake configuration, and show the slowest packages, checks, modules and files.");
+        std::println("\t--ram-build-dir[=persist] : {}", "Keep the build directory in memory. With persist it is copied back to disk after each run.");
+        std::println("\t--resume : {}", "Do not run again the pre-requisites and configuration stages that succeeded with the same inputs.");
+        std::println("\t--share-worktrees : {}", "Make the compiler caches shared between all git worktrees of the repository.");
+        std::println("\t--startup-profile : {}", "Show where the time goes until the first tool is started.");
+        std::println("\t--trace=«path» : {}", "Write a Chrome trace of the stages to «path», with the traces the tools wrote merged in.");
         std::println("\t--help, -h, -? : {}", "This message");
 
         return 0;
     }
 
     if (auto found = maker::find_argument(main_options, "--list-env"sv); found.has_value()) {
-        std::println("Environment variables that are exported by default: {}", default_environment);
+        std::println("Environment variables that are exported by default: {}", maker::default_environment);
         return 0;
     }
 
-    auto target = std::string_view{};
+    auto targets = std::ranges::to<std::vector<std::string_view>>(
+        main_options | std::views::filter([](std::string_view option) {
+            return !option.starts_with('-');
+        }));
+    profile.mark("arguments");
+
+    auto root = std::filesystem::current_path();
+    root = maker::builders::git_root_locator(root).value_or(root);
+    auto current = maker::work_dir{root};
+    profile.mark("root");
+
+    auto factory = maker::detect_first_stage(current);
+    profile.mark("detection");
+
+    if (factory == nullptr) {
+        std::println(std::cerr, "Could not find an applicable builder for `{}`", current.path().string());
+        return 1;
+    }
 
     auto env = vb::env::environment{};
+    maker::import_default_environment(env);
 
-    for (auto var_name : default_environment) {
-        env.import(var_name);
+    if (auto found = maker::find_argument(main_options, "--share-worktrees"sv); found.has_value()) {
+        env.set(maker::worktree_sharing::ENABLE_VAR) = "1";
     }
 
-    if (!main_options.empty()) {
-        target = main_options.front();
+    // The options that change the build configuration come first, the history is kept by configuration.
+    auto profile_compile = maker::find_argument(main_options, "--profile-compile"sv).has_value();
+    if (profile_compile) {
+        auto normal_dir      = maker::value_of(env, "BUILD_DIR");
+        env.set("BUILD_DIR") = (normal_dir.empty() ? "build"s : normal_dir) + std::string{ maker::compile_profile::BUILD_DIR_SUFFIX };
+        maker::compile_profile::apply(env);
+    }
+    auto pgo_option = maker::filter_arguments(main_options, '=', "--pgo"sv);
+    auto pgo        = !std::ranges::empty(pgo_option);
+    if (pgo) {
+        auto training        = std::string_view{ *std::ranges::begin(pgo_option) };
+        auto normal_dir      = maker::value_of(env, "BUILD_DIR");
+        env.set("BUILD_DIR") = (normal_dir.empty() ? "build"s : normal_dir) + std::string{ maker::builders::pgo::BUILD_DIR_SUFFIX };
+        env.set(maker::builders::pgo::ENABLE_VAR) =
+            training.size() > "--pgo="sv.size() ? training.substr("--pgo="sv.size()) : "1"sv;
     }
 
-    auto root = std::filesystem::current_path();
-    root = maker::builders::git_root_locator(root).value_or(root);
+    auto build_dir  = maker::value_of(env, "BUILD_DIR");
+    auto build_path = root / (build_dir.empty() ? "build"s : build_dir);
 
-    auto builder = maker::builder{};
-    auto current = maker::work_dir{root};
-    for (auto stage : maker::all_stages) {
-        builder = maker::builders::select(current, stage, env);
-        if (builder) {
-            break;
+    // `history` is only recognized alone, `vmk history all` builds the targets `history` and `all`.
+    if (targets.size() == 1 && targets.front() == "history"sv) {
+        auto configuration = maker::configuration_fingerprint(build_path, env).value;
+        for (const auto& line : maker::history_report(maker::history::of(root), configuration)) {
+            std::println("{}", line);
         }
+        return 0;
     }
 
-    if (!builder) {
-        std::println(std::cerr, "Could not find an applicable builder for `{}`", current.path().string());
+    // Only alone as well, a target can have the same name.
+    if (targets.size() == 1 && targets.front() == maker::header_hotspots::COMMAND) {
+        auto ninja_dir = maker::header_hotspots::find_build_dir(build_path);
+        if (!ninja_dir.has_value()) {
+            std::println(std::cerr, "No ninja build found in `{}`", build_path.string());
+            return 1;
+        }
+        for (const auto& line : maker::header_hotspots::analyze(root, *ninja_dir)) {
+            std::println("{}", line);
+        }
+        return 0;
+    }
+
+    // `explain` is only recognized alone, `vmk explain all` builds the targets `explain` and `all`.
+    auto explain = targets.size() == 1 && targets.front() == "explain"sv;
+    if (explain) {
+        targets.clear();
+        env.set(maker::rebuild_explanation::ENABLE_VAR) =
+            maker::find_argument(main_options, "--dry-run"sv).has_value() ? maker::rebuild_explanation::DRY_RUN : "1"sv;
+    }
+
+    auto metrics = std::optional<maker::metrics_file>{};
+    auto metrics_option = maker::filter_arguments(main_options, '=', "--metrics-file"sv);
+    if (!std::ranges::empty(metrics_option)) {
+        auto path = maker::option_value(std::string_view{ *std::ranges::begin(metrics_option) }, "--metrics-file"sv);
+        if (path.empty()) {
+            std::println(std::cerr, "--metrics-file needs the path of the file to write: --metrics-file=«path»");
+            return 1;
+        }
+        metrics.emplace(std::filesystem::absolute(path), root);
+        env.set(maker::metrics_file::ENABLE_VAR) = metrics->path().string();
+    }
+
+    auto trace        = std::optional<maker::pipeline_trace>{};
+    auto trace_option = maker::filter_arguments(main_options, '=', "--trace"sv);
+    if (!std::ranges::empty(trace_option)) {
+        auto path = maker::option_value(std::string_view{ *std::ranges::begin(trace_option) }, "--trace"sv);
+        if (path.empty()) {
+            std::println(std::cerr, "--trace needs the path of the file to write: --trace=«path»");
+            return 1;
+        }
+        trace.emplace(std::filesystem::absolute(path));
+    }
+
+    if (auto found = maker::find_argument(main_options, "--profile-configure"sv); found.has_value()) {
+        env.set(maker::cmake_profile::ENABLE_VAR) = "1";
+    }
+    if (auto found = maker::find_argument(args, "---bench"sv); found.has_value()) {
+        maker::builders::bench::apply(env, maker::argument_list(maker::Stage{ maker::task_type::bench }.filter_arguments(args)));
+    }
+    if (auto found = maker::find_argument(args, "---pack"sv, "---package"sv); found.has_value()) {
+        auto error = maker::builders::package::apply(env, maker::argument_list(maker::Stage{ maker::task_type::package }.filter_arguments(args)));
+        if (error.has_value()) {
+            std::println(std::cerr, "{}", *error);
+            return 1;
+        }
+    }
+    if (auto found = maker::find_argument(args, "---install"sv); found.has_value()) {
+        maker::builders::install::apply(env, maker::argument_list(maker::Stage{ maker::task_type::install }.filter_arguments(args)));
+    }
+    auto configuration = maker::configuration_fingerprint(build_path, env).value;
+    profile.mark("environment");
+
+    auto background        = std::optional<maker::background_mode>{};
+    auto background_option = maker::filter_arguments(main_options, '=', "--background"sv);
+    if (!std::ranges::empty(background_option)) {
+        background.emplace(std::string_view{ *std::ranges::begin(background_option) }.ends_with(maker::background_mode::PAUSE));
+        for (const auto& note : background->notes()) {
+            std::println("⚠ {}", note);
+        }
+    }
+
+    auto in_memory  = std::optional<maker::ram_build_dir>{};
+    auto ram_option = maker::filter_arguments(main_options, '=', "--ram-build-dir"sv);
+    if (!std::ranges::empty(ram_option)) {
+        auto mode = std::string_view{ *std::ranges::begin(ram_option) };
+        in_memory.emplace(root, build_path, mode.ends_with(maker::ram_build_dir::PERSIST));
+        if (auto problem = in_memory->prepare(); problem.has_value()) {
+            std::println("⚠ {}", *problem);
+        }
+    }
+
+    auto builder = maker::builder{ pgo ? maker::builders::pgo::create(current, env) : factory->my_builder(current, env) };
+    if (pgo && !builder) {
+        std::println(std::cerr, "Profile guided optimization needs a cmake project in `{}`", current.path().string());
         return 1;
     }
+    profile.mark("builder");
+
+    auto journal = maker::journal{ build_path };
+    auto resume  = maker::find_argument(main_options, "--resume"sv).has_value();
+    auto history = maker::history_recorder{ root, configuration };
+    auto report_history = [&] {
+        if (explain) {
+            return;
+        }
+        for (const auto& line : history.finish()) {
+            std::println("{}", line);
+        }
+    };
 
     while (builder) {
-        if (builder.required()) {
+        auto arguments = maker::argument_list(builder.stage().filter_arguments(all_arguments));
+        if (resume && journal.is_done(builder, targets, arguments)) {
+            std::println("Resume after stage {} → {}", builder.stage(), builder);
+        } else if (builder.required()) {
+            resume = false;
             std::println("Running stage {} → {}:", builder.stage(), builder);
 
-            auto arguments = maker::argument_list(builder.stage().filter_arguments(all_arguments));
-            auto result = builder.run(target, arguments);
+            profile.mark("first spawn");
+            profile.report();
+
+            auto started = std::chrono::steady_clock::now();
+            auto usage   = maker::resource_usage::children();
+            auto ccache  = metrics && builder.stage().type() == maker::task_type::build
+                               ? maker::ccache_statistics::current()
+                               : std::nullopt;
+
+            auto result = builder.run(targets, arguments);
+            journal.record(builder, targets, arguments, static_cast<bool>(result));
+
+            auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            auto used     = maker::resource_usage::children();
+            auto cpu      = used.cpu_seconds - usage.cpu_seconds;
+
+            history.add(
+                maker::history_record::kind::stage, maker::journal::key_of(builder), duration,
+                static_cast<bool>(result), cpu, used.max_rss_bytes);
+            for (const auto& [name, seconds] : result.slowest_targets) {
+                history.add(maker::history_record::kind::target, name, seconds, static_cast<bool>(result));
+            }
+
+            if (trace) {
+                trace->add_stage(builder.name(), builder.stage().name(), started, duration, static_cast<bool>(result));
+                for (const auto& tool_trace : result.traces) {
+                    trace->add_tool_trace(tool_trace, started);
+                }
+                trace->write();
+            }
+
+            if (metrics) {
+                auto measured = maker::metrics_file::sample{ builder.name(), std::string{ builder.stage().name() }, result.metrics };
+                measured.values[std::string{ maker::metric::DURATION }]  = duration;
+                measured.values[std::string{ maker::metric::EXIT_CODE }] = result.exit_code;
+                measured.values[std::string{ maker::metric::CPU }]       = cpu;
+                measured.values[std::string{ maker::metric::MAX_RSS }]   = static_cast<double>(used.max_rss_bytes);
+                if (auto after = ccache ? maker::ccache_statistics::current() : std::nullopt; after.has_value()) {
+                    if (auto ratio = maker::ccache_statistics::hit_ratio(*ccache, *after); ratio.has_value()) {
+                        measured.values[std::string{ maker::metric::CCACHE_HIT_RATIO }] = *ratio;
+                    }
+                }
+                metrics->add(std::move(measured));
+                metrics->write();
+            }
 
             if (!result) {
                 std::println("🚫 Builder {} failled at stage {} \n{}", builder.name(), builder.stage(), result);
+                report_history();
                 return 1;
             }
+
+            for (const auto& line : result.output) {
+                std::println("  {}", line);
+            }
+
+            if (builder.stage().type() == maker::task_type::build) {
+                // A preset builds in its own binaryDir, not necessarily the BUILD_DIR of the environment.
+                auto artifacts = maker::artifact_sizes::scan(builder.build_directory(targets).value_or(build_path));
+                auto before    = maker::artifact_sizes::previous(maker::history::of(root), configuration);
+                for (const auto& line : maker::artifact_sizes::summary(artifacts, before)) {
+                    std::println("  {}", line);
+                }
+                maker::artifact_sizes::record(history, artifacts);
+            }
+
+            if (auto stage = builder.stage().type();
+                stage == maker::task_type::configuration || stage == maker::task_type::build) {
+                auto merger = maker::compile_database_merger{ root, build_path };
+                if ((stage == maker::task_type::configuration || merger.stale()) && merger.merge()) {
+                    std::println("  📚 {} updated", maker::compile_database_merger::DATABASE);
+                }
+            }
         } else {
             std::println("Skip stage {} → {}", builder.stage(), builder);
         }
 
+        if ((explain || profile_compile) && builder.stage().type() == maker::task_type::build) {
+            break;
+        }
         builder = builder.next_builder();
     }
+
+    report_history();
+
+    profile.mark("done");
+    profile.report();
     return 0;
 }
@@ -0,0 +1,223 @@
+#ifndef INCLUDED_METRICS_HPP
+#define INCLUDED_METRICS_HPP
+
+#include "output_cache.hpp"
+#include "state.hpp"
+#include "worktree.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Names of the measurements of a stage, builders add their own ones to `execution_result::metrics`.
+namespace metric {
+
+inline constexpr auto DURATION                = "stage_duration_seconds"sv;
+inline constexpr auto EXIT_CODE               = "stage_exit_code"sv;
+inline constexpr auto CPU                     = "stage_cpu_seconds"sv;
+inline constexpr auto MAX_RSS                 = "stage_max_rss_bytes"sv;
+inline constexpr auto CCACHE_HIT_RATIO        = "ccache_hit_ratio"sv;
+inline constexpr auto NINJA_EDGES             = "ninja_edges"sv;
+inline constexpr auto TESTS                   = "tests"sv;
+inline constexpr auto TESTS_FAILED            = "tests_failed"sv;
+inline constexpr auto CONAN_BUILT_FROM_SOURCE = "conan_packages_built_from_source"sv;
+
+} // namespace metric
+
+/// Resources used by the tools vmk started and waited for.
+struct resource_usage
+{
+    double        cpu_seconds   = 0.0;
+    std::uint64_t max_rss_bytes = 0;
+
+    static resource_usage children()
+    {
+        auto usage = rusage{};
+        ::getrusage(RUSAGE_CHILDREN, &usage);
+        auto seconds = [](timeval time) {
+            return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec) / 1e6;
+        };
+        return { seconds(usage.ru_utime) + seconds(usage.ru_stime), static_cast<std::uint64_t>(usage.ru_maxrss) * 1024 };
+    }
+};
+
+/// Hits and misses counted by ccache so far, nothing if ccache is not installed.
+struct ccache_statistics
+{
+    std::uint64_t hits   = 0;
+    std::uint64_t misses = 0;
+
+    static std::optional<ccache_statistics> current()
+    {
+        if (!find_program("ccache").has_value()) {
+            return std::nullopt;
+        }
+        auto lines = details::tool_output("ccache"sv, "--print-stats"sv);
+        if (!lines.has_value()) {
+            return std::nullopt;
+        }
+
+        auto result = ccache_statistics{};
+        for (std::string_view line : *lines) {
+            auto tab = line.find('\t');
+            if (tab == line.npos) {
+                continue;
+            }
+            auto name  = line.substr(0, tab);
+            auto value = std::uint64_t{};
+            auto text  = line.substr(tab + 1);
+            std::from_chars(text.data(), text.data() + text.size(), value);
+            if (name == "direct_cache_hit" || name == "preprocessed_cache_hit") {
+                result.hits += value;
+            } else if (name == "cache_miss") {
+                result.misses += value;
+            }
+        }
+        return result;
+    }
+
+    /// Hit ratio of the compilations between `before` and `after`, nothing if there were none.
+    static std::optional<double> hit_ratio(const ccache_statistics& before, const ccache_statistics& after)
+    {
+        auto hits  = after.hits - before.hits;
+        auto total = hits + (after.misses - before.misses);
+        if (total == 0) {
+            return std::nullopt;
+        }
+        return static_cast<double>(hits) / static_cast<double>(total);
+    }
+};
+
+/// Measurements of the stages of a run, written in the Prometheus text format 0.0.4.
+///
+/// Meant for node_exporter's textfile collector: the file is replaced atomically after every stage, so the collector
+/// never reads a partial file and a failed run still reports the stages it went through.
+class metrics_file
+{
+public:
+
+    static constexpr auto ENABLE_VAR = "VMK_METRICS_FILE"sv;
+
+    struct sample
+    {
+        std::string                                builder;
+        std::string                                stage;
+        std::map<std::string, double, std::less<>> values;
+    };
+
+    explicit metrics_file(std::filesystem::path file, std::filesystem::path root)
+        : my_file{ std::move(file) }
+        , my_root{ std::move(root) }
+    {
+    }
+
+    const std::filesystem::path& path() const
+    {
+        return my_file;
+    }
+
+    void add(sample measured)
+    {
+        my_samples.push_back(std::move(measured));
+    }
+
+    void write() const
+    {
+        if (!my_file.parent_path().empty()) {
+            std::filesystem::create_directories(my_file.parent_path());
+        }
+        write_atomically(my_file, render());
+    }
+
+    std::string render() const
+    {
+        auto result = std::string{};
+        for (const auto& [name, type, help] : families) {
+            // The header names the samples, suffix included, or the collector rejects the file.
+            auto sample_name = std::format("vmk_{}{}", name, type == "counter"sv ? "_total"sv : ""sv);
+            auto header_done = false;
+            for (const auto& measured : my_samples) {
+                auto found = measured.values.find(name);
+                if (found == measured.values.end()) {
+                    continue;
+                }
+                if (!header_done) {
+                    result += std::format("# TYPE {} {}\n# HELP {} {}\n", sample_name, type, sample_name, help);
+                    header_done = true;
+                }
+                result += std::format(
+                    "{}{{builder=\"{}\",stage=\"{}\",root=\"{}\"}} {}\n",
+                    sample_name,
+                    escape(measured.builder),
+                    escape(measured.stage),
+                    escape(my_root.string()),
+                    found->second);
+            }
+        }
+        return result;
+    }
+
+private:
+
+    struct family
+    {
+        std::string_view name;
+        std::string_view type;
+        std::string_view help;
+    };
+
+    static constexpr auto families = std::array{
+        family{ metric::DURATION, "gauge"sv, "Wall clock time of the stage."sv },
+        family{ metric::EXIT_CODE, "gauge"sv, "Exit code of the stage tool."sv },
+        family{ metric::CPU, "counter"sv, "User and system time of the tools started by the stage."sv },
+        family{ metric::MAX_RSS, "gauge"sv, "Peak resident set size of the largest tool run so far."sv },
+        family{ metric::CCACHE_HIT_RATIO, "gauge"sv, "Share of the compilations of the stage served by ccache."sv },
+        family{ metric::NINJA_EDGES, "counter"sv, "Build edges ninja ran."sv },
+        family{ metric::TESTS, "counter"sv, "Tests that ran."sv },
+        family{ metric::TESTS_FAILED, "counter"sv, "Tests that failed."sv },
+        family{ metric::CONAN_BUILT_FROM_SOURCE, "counter"sv, "Dependencies conan built from source, no binary was found for them."sv },
+    };
+
+    std::filesystem::path my_file;
+    std::filesystem::path my_root;
+    std::vector<sample>   my_samples;
+
+    static std::string escape(std::string_view value)
+    {
+        auto result = std::string{};
+        for (auto c : value) {
+            switch (c) {
+            case '\\':
+                result += "\\\\"sv;
+                break;
+            case '"':
+                result += "\\\""sv;
+                break;
+            case '\n':
+                result += "\\n"sv;
+                break;
+            default:
+                result += c;
+            }
+        }
+        return result;
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_METRICS_HPP
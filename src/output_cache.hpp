@@ -0,0 +1,526 @@
+#ifndef INCLUDED_OUTPUT_CACHE_HPP
+#define INCLUDED_OUTPUT_CACHE_HPP
+
+#include "file_copy.hpp"
+#include "hash.hpp"
+#include "state.hpp"
+#include <util/environment.hpp>
+#include <util/execution.hpp>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <print>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace details {
+
+/// Runs a short lived tool and returns its standard output, or nothing if it failed.
+inline std::optional<std::vector<std::string>> tool_output(
+    std::string_view                                  command,
+    std::convertible_to<std::string_view> auto... args)
+{
+    const auto arguments = std::array{ std::string_view{ args }... };
+
+    execution tool{ io_set::OUT | io_set::ERR };
+    tool.execute(command, arguments);
+
+    auto result = std::ranges::to<std::vector>(tool.lines<std_io::OUT>());
+    if (tool.wait() != 0) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+} // namespace details
+
+/// Identifies the sources of a clean checkout: the hash of the tree of `HEAD`.
+///
+/// Returns nothing when the working tree has local changes, their outputs can not be shared.
+inline std::optional<std::string> git_tree_hash(const std::filesystem::path& root)
+{
+    auto status = details::tool_output(
+        "git"sv, "-C"sv, root.string(), "status"sv, "--porcelain"sv, "--untracked-files=no"sv);
+    if (!status.has_value() || !status->empty()) {
+        return std::nullopt;
+    }
+
+    auto tree = details::tool_output("git"sv, "-C"sv, root.string(), "rev-parse"sv, "HEAD^{tree}"sv);
+    if (!tree.has_value() || tree->empty()) {
+        return std::nullopt;
+    }
+    return tree->front();
+}
+
+/// Environment that changes the content of a build directory.
+inline constexpr auto configuration_variables =
+    std::array{ "CC"sv,       "CXX"sv,         "CFLAGS"sv,           "CXXFLAGS"sv,  "LDFLAGS"sv,
+                "BUILD_DIR"sv, "CMAKE_BUILD_TYPE"sv, "CMAKE_GENERATOR"sv, "CURRENT_PROFILE"sv };
+
+/// Identifies a build configuration: the build directory and the variables that change its content.
+inline fingerprint configuration_fingerprint(const std::filesystem::path& build_dir, const env::environment& env)
+{
+    auto configuration = fingerprint{ std::filesystem::absolute(build_dir).string() };
+    for (auto name : configuration_variables) {
+        if (auto var = env.get(name); var.has_value() && var.value().has_value()) {
+            configuration.add(name).add(var.value().value_str());
+        }
+    }
+    return configuration;
+}
+
+/// Key of the outputs of building `root` in `build_dir`: a fingerprint of the configuration plus the tree hash.
+inline std::optional<std::string>
+output_cache_key(const std::filesystem::path& root, const std::filesystem::path& build_dir, const env::environment& env)
+{
+    auto tree = git_tree_hash(root);
+    if (!tree.has_value()) {
+        return std::nullopt;
+    }
+    return std::format("{}-{}", configuration_fingerprint(build_dir, env).hex(), *tree);
+}
+
+/// Storage for build directory snapshots.
+struct cache_backend
+{
+    using ptr      = std::unique_ptr<cache_backend>;
+    using reporter = std::function<void(std::string_view)>;
+
+    virtual ~cache_backend() = default;
+
+    /// Where the problems met by the backend go, the terminal when nothing is set.
+    void report_to(reporter to)
+    {
+        my_reporter = std::move(to);
+    }
+
+    virtual bool contains(std::string_view key) const                                = 0;
+    virtual bool store(std::string_view key, const std::filesystem::path& dir) const   = 0;
+    virtual bool restore(std::string_view key, const std::filesystem::path& dir) const = 0;
+
+    /// vmk's own state is never part of a snapshot.
+    static bool is_private(const std::filesystem::path& relative)
+    {
+        return !relative.empty() && *relative.begin() == ".vmk";
+    }
+
+protected:
+
+    void report(std::string_view message) const
+    {
+        if (my_reporter) {
+            my_reporter(message);
+        } else {
+            std::println("{}", message);
+        }
+    }
+
+private:
+
+    reporter my_reporter;
+};
+
+/// Snapshots kept as plain directories, one per key.
+///
+/// Storing hard links files when reflinks are not available, so a tool that later rewrites an output in place would
+/// change the snapshot. The manifest records size and modification time of every file, an entry whose files no longer
+/// match is considered corrupted and dropped. Restoring always clones or copies, so snapshots are never shared with
+/// the build directory.
+struct local_cache_backend : cache_backend
+{
+    static constexpr auto MANIFEST    = ".manifest"sv;
+    static constexpr auto MAX_ENTRIES = std::size_t{ 8 };
+
+    explicit local_cache_backend(std::filesystem::path dir, std::size_t max_entries = MAX_ENTRIES)
+        : my_dir{ std::move(dir) }
+        , my_max_entries{ max_entries }
+    {
+        std::filesystem::create_directories(my_dir);
+    }
+
+    bool contains(std::string_view key) const override
+    {
+        return std::filesystem::is_regular_file(entry(key) / MANIFEST);
+    }
+
+    bool store(std::string_view key, const std::filesystem::path& dir) const override
+    {
+        if (contains(key)) {
+            return true;
+        }
+
+        auto target   = entry(key);
+        auto manifest = std::ostringstream{};
+        try {
+            std::filesystem::remove_all(target);
+            copy_tree(dir, target, copy_mode::clone_or_link, &cache_backend::is_private, [&](const auto& relative) {
+                manifest << describe(target / relative) << ' ' << relative.string() << '\n';
+            });
+            // The manifest is written last, it marks the entry as complete.
+            write_atomically(target / MANIFEST, manifest.view());
+        } catch (const std::filesystem::filesystem_error& error) {
+            report(std::format("⚠ could not store build outputs in cache: {}", error.what()));
+            auto ignored = std::error_code{};
+            std::filesystem::remove_all(target, ignored);
+            return false;
+        }
+
+        evict();
+        return true;
+    }
+
+    bool restore(std::string_view key, const std::filesystem::path& dir) const override
+    {
+        if (!contains(key) || !is_intact(key)) {
+            return false;
+        }
+
+        try {
+            auto now = std::filesystem::file_time_type::clock::now();
+            copy_tree(
+                entry(key),
+                dir,
+                copy_mode::clone_or_copy,
+                [](const auto& relative) {
+                    return relative == MANIFEST;
+                },
+                [&](const auto& relative) {
+                    // Restored outputs must look newer than the sources the checkout just touched. The time of a
+                    // link would be that of its target, which may be outside of the build.
+                    auto error = std::error_code{};
+                    if (!std::filesystem::is_symlink(dir / relative, error)) {
+                        std::filesystem::last_write_time(dir / relative, now, error);
+                    }
+                });
+            auto error = std::error_code{};
+            std::filesystem::last_write_time(entry(key) / MANIFEST, now, error);
+        } catch (const std::filesystem::filesystem_error& error) {
+            report(std::format("⚠ could not restore build outputs from cache: {}", error.what()));
+            return false;
+        }
+        return true;
+    }
+
+private:
+
+    std::filesystem::path my_dir;
+    std::size_t           my_max_entries;
+
+    std::filesystem::path entry(std::string_view key) const
+    {
+        return my_dir / key;
+    }
+
+    static std::string describe(const std::filesystem::path& file)
+    {
+        auto error = std::error_code{};
+        if (std::filesystem::is_symlink(file)) {
+            return "0 0"s;
+        }
+        auto size = std::filesystem::file_size(file, error);
+        auto time = std::filesystem::last_write_time(file, error);
+        return std::format("{} {}", size, time.time_since_epoch().count());
+    }
+
+    bool is_intact(std::string_view key) const
+    {
+        auto manifest = std::ifstream{ entry(key) / MANIFEST };
+        for (auto line = std::string{}; std::getline(manifest, line);) {
+            auto separator = line.find(' ', line.find(' ') + 1);
+            if (separator == line.npos) {
+                continue;
+            }
+            if (describe(entry(key) / line.substr(separator + 1)) != line.substr(0, separator)) {
+                report(std::format("⚠ cache entry {} was modified after it was stored, dropping it", key));
+                auto error = std::error_code{};
+                std::filesystem::remove_all(entry(key), error);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Keeps only the most recently used entries.
+    void evict() const
+    {
+        auto entries = std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>>{};
+        for (const auto& item : std::filesystem::directory_iterator{ my_dir }) {
+            auto manifest = item.path() / MANIFEST;
+            auto error    = std::error_code{};
+            if (auto time = std::filesystem::last_write_time(manifest, error); !error) {
+                entries.emplace_back(time, item.path());
+            }
+        }
+
+        if (entries.size() <= my_max_entries) {
+            return;
+        }
+
+        std::ranges::sort(entries, std::ranges::greater{}, &decltype(entries)::value_type::first);
+        for (const auto& [_, path] : entries | std::views::drop(my_max_entries)) {
+            auto error = std::error_code{};
+            std::filesystem::remove_all(path, error);
+        }
+    }
+};
+
+/// Snapshots kept as tar archives behind a HTTP endpoint supporting `HEAD`, `GET` and `PUT`.
+///
+/// The transfer is done by `curl`, and the archives by `tar`.
+struct http_cache_backend : cache_backend
+{
+    explicit http_cache_backend(std::string url)
+        : my_url{ std::move(url) }
+    {
+        if (my_url.ends_with('/')) {
+            my_url.pop_back();
+        }
+    }
+
+    bool contains(std::string_view key) const override
+    {
+        return details::tool_output("curl"sv, "--fail"sv, "--silent"sv, "--head"sv, url(key)).has_value();
+    }
+
+    bool store(std::string_view key, const std::filesystem::path& dir) const override
+    {
+        if (contains(key)) {
+            return true;
+        }
+
+        auto archive = state_dir(dir) / "output-cache-upload.tar";
+        auto stored  = details::tool_output(
+                          "tar"sv, "-C"sv, dir.string(), "--exclude=./.vmk"sv, "-cf"sv, archive.string(), "."sv)
+                          .has_value() &&
+                      details::tool_output(
+                          "curl"sv, "--fail"sv, "--silent"sv, "--show-error"sv, "--upload-file"sv, archive.string(),
+                          url(key))
+                          .has_value();
+        auto error = std::error_code{};
+        std::filesystem::remove(archive, error);
+        return stored;
+    }
+
+    bool restore(std::string_view key, const std::filesystem::path& dir) const override
+    {
+        auto archive = state_dir(dir) / "output-cache-download.tar";
+        // `--touch` gives the extracted outputs the current time, see the local backend.
+        auto restored = details::tool_output(
+                            "curl"sv, "--fail"sv, "--silent"sv, "--show-error"sv, "--output"sv, archive.string(),
+                            url(key))
+                            .has_value() &&
+                        details::tool_output(
+                            "tar"sv, "-C"sv, dir.string(), "--touch"sv, "-xf"sv, archive.string())
+                            .has_value();
+        auto error = std::error_code{};
+        std::filesystem::remove(archive, error);
+        return restored;
+    }
+
+private:
+
+    std::string my_url;
+
+    std::string url(std::string_view key) const
+    {
+        return std::format("{}/{}.tar", my_url, key);
+    }
+};
+
+/// Creates the backend described by `VMK_OUTPUT_CACHE`: a `http://` or `https://` URL, or a local directory.
+inline cache_backend::ptr make_cache_backend(std::string_view spec)
+{
+    if (spec.empty()) {
+        return nullptr;
+    }
+    if (spec.starts_with("http://"sv) || spec.starts_with("https://"sv)) {
+        return std::make_unique<http_cache_backend>(std::string{ spec });
+    }
+    return std::make_unique<local_cache_backend>(std::filesystem::path{ spec });
+}
+
+/// Remembers which key the content of a build directory corresponds to.
+struct output_cache_marker
+{
+    static constexpr auto FILE = "output-cache-key"sv;
+
+    static std::string current(const std::filesystem::path& build_dir)
+    {
+        return read_file(state_dir(build_dir) / FILE);
+    }
+
+    static void set(const std::filesystem::path& build_dir, std::string_view key)
+    {
+        if (key.empty()) {
+            auto error = std::error_code{};
+            std::filesystem::remove(state_dir(build_dir) / FILE, error);
+        } else {
+            write_atomically(state_dir(build_dir) / FILE, key);
+        }
+    }
+};
+
+/// Makes the state ninja keeps in a restored build directory agree with the restored outputs.
+///
+/// The outputs are restored newer than the sources, but `.ninja_log` and `.ninja_deps` still hold the times the outputs
+/// had when they were built: ninja would take every edge for dirty and rebuild everything. `ninja -t restat` updates
+/// the build log, the deps log has no such tool and its times are rewritten here.
+struct ninja_state
+{
+    static constexpr auto MANIFEST        = "build.ninja"sv;
+    static constexpr auto DEPS_LOG        = ".ninja_deps"sv;
+    static constexpr auto DEPS_SIGNATURE  = "# ninjadeps\n"sv;
+    static constexpr auto DEPS_VERSION    = std::uint32_t{ 4 }; ///< Times in nanoseconds, since ninja 1.10.
+    static constexpr auto DEPS_RECORD_BIT = std::uint32_t{ 0x80000000 };
+
+    /// The time ninja sees for `file`, in nanoseconds, or nothing when it does not exist.
+    static std::optional<std::int64_t> mtime_of(const std::filesystem::path& file)
+    {
+        struct ::stat status{};
+        if (::stat(file.c_str(), &status) != 0) {
+            return std::nullopt;
+        }
+        return static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1'000'000'000 + status.st_mtim.tv_nsec;
+    }
+
+    /// Records the current time of each output in the deps log of `build_dir`. Returns the count of records updated.
+    static std::size_t retime_deps(const std::filesystem::path& build_dir)
+    {
+        auto file    = build_dir / DEPS_LOG;
+        auto content = read_file(file);
+        auto header  = DEPS_SIGNATURE.size() + sizeof(std::uint32_t);
+        if (content.size() < header || !std::string_view{ content }.starts_with(DEPS_SIGNATURE) ||
+            read<std::uint32_t>(content, DEPS_SIGNATURE.size()) != DEPS_VERSION) {
+            return 0;
+        }
+
+        auto paths   = std::vector<std::string_view>{};
+        auto updated = std::size_t{ 0 };
+        for (auto offset = header; offset + sizeof(std::uint32_t) <= content.size();) {
+            auto flagged = read<std::uint32_t>(content, offset);
+            auto size    = std::size_t{ flagged & ~DEPS_RECORD_BIT };
+            auto record  = offset + sizeof(std::uint32_t);
+            if (record + size > content.size() || size < sizeof(std::uint32_t)) {
+                // A record cut short by an interrupted build, ninja ignores it too.
+                break;
+            }
+
+            if ((flagged & DEPS_RECORD_BIT) == 0) {
+                // The path, padded with zeros, then a checksum; the ids are the order of these records.
+                auto path = std::string_view{ content }.substr(record, size - sizeof(std::uint32_t));
+                paths.push_back(path.substr(0, path.find('\0')));
+            } else if (size >= 3 * sizeof(std::uint32_t)) {
+                auto id = read<std::uint32_t>(content, record);
+                if (id < paths.size()) {
+                    if (auto time = mtime_of(build_dir / paths[id]); time.has_value()) {
+                        write(content, record + sizeof(std::uint32_t), static_cast<std::uint32_t>(*time & 0xffffffff));
+                        write(content, record + 2 * sizeof(std::uint32_t), static_cast<std::uint32_t>(*time >> 32));
+                        ++updated;
+                    }
+                }
+            }
+            offset = record + size;
+        }
+
+        if (updated > 0) {
+            write_atomically(file, content);
+        }
+        return updated;
+    }
+
+    /// Brings the logs of a restored ninja build directory up to date, does nothing for other build directories.
+    static void refresh(const std::filesystem::path& build_dir)
+    {
+        if (!std::filesystem::is_regular_file(build_dir / MANIFEST)) {
+            return;
+        }
+        details::tool_output("ninja"sv, "-C"sv, build_dir.string(), "-t"sv, "restat"sv);
+        retime_deps(build_dir);
+    }
+
+private:
+
+    template<typename VALUE>
+    static VALUE read(std::string_view content, std::size_t offset)
+    {
+        auto result = VALUE{};
+        std::memcpy(&result, content.data() + offset, sizeof(VALUE));
+        return result;
+    }
+
+    template<typename VALUE>
+    static void write(std::string& content, std::size_t offset, VALUE value)
+    {
+        std::memcpy(content.data() + offset, &value, sizeof(VALUE));
+    }
+};
+
+/// Removes the content of a build directory, but vmk's own state, before a snapshot replaces it.
+///
+/// Outputs the snapshot does not have, e.g. of targets removed since, would otherwise survive the restore.
+inline void clear_outputs(const std::filesystem::path& build_dir)
+{
+    auto error = std::error_code{};
+    for (const auto& entry : std::filesystem::directory_iterator{ build_dir, error }) {
+        if (!cache_backend::is_private(entry.path().lexically_relative(build_dir))) {
+            std::filesystem::remove_all(entry.path(), error);
+        }
+    }
+}
+
+/// Brings a build directory to the snapshot of `key`, unless it already corresponds to it. Returns whether it did.
+inline bool restore_outputs(const cache_backend& cache, std::string_view key, const std::filesystem::path& build_dir)
+{
+    if (output_cache_marker::current(build_dir) == key || !cache.contains(key)) {
+        return false;
+    }
+
+    clear_outputs(build_dir);
+    if (!cache.restore(key, build_dir)) {
+        output_cache_marker::set(build_dir, {});
+        return false;
+    }
+
+    ninja_state::refresh(build_dir);
+    output_cache_marker::set(build_dir, key);
+    return true;
+}
+
+/// Stores the outputs of a successful build. Builds of a modified tree (no key) only forget the previous key.
+inline void
+store_outputs(const cache_backend& cache, std::optional<std::string_view> key, const std::filesystem::path& build_dir)
+{
+    if (!key.has_value()) {
+        output_cache_marker::set(build_dir, {});
+        return;
+    }
+
+    if (cache.store(*key, build_dir)) {
+        output_cache_marker::set(build_dir, *key);
+    } else {
+        output_cache_marker::set(build_dir, {});
+    }
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_OUTPUT_CACHE_HPP
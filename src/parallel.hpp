@@ -0,0 +1,43 @@
+#ifndef INCLUDED_PARALLEL_HPP
+#define INCLUDED_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace vb::maker {
+
+/// Threads worth starting for `items` pieces of work: one per core, but never more than there is work, nor none.
+inline std::size_t parallel_workers(std::size_t items)
+{
+    return std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, std::max<std::size_t>(items, 1));
+}
+
+/// Runs `action` on each item from `parallel_workers(items.size())` threads, returns once all the items are done.
+///
+/// `action` is either called with the item, or with the index of the thread and the item, for the callers that keep
+/// a partial result per thread and merge them afterwards.
+template<typename ITEM, typename ACTION>
+void for_each_parallel(const std::vector<ITEM>& items, const ACTION& action)
+{
+    auto next    = std::atomic<std::size_t>{ 0 };
+    auto threads = std::vector<std::jthread>{};
+    for (auto worker = std::size_t{ 0 }; worker < parallel_workers(items.size()); ++worker) {
+        threads.emplace_back([&items, &next, &action, worker] {
+            for (auto index = next++; index < items.size(); index = next++) {
+                if constexpr (std::invocable<const ACTION&, std::size_t, const ITEM&>) {
+                    action(worker, items[index]);
+                } else {
+                    action(items[index]);
+                }
+            }
+        });
+    }
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_PARALLEL_HPP
@@ -0,0 +1,177 @@
+#ifndef INCLUDED_PIPELINE_HPP
+#define INCLUDED_PIPELINE_HPP
+
+#include "arguments.hpp"
+#include "builder.hpp"
+#include "builders.hpp"
+#include "startup.hpp"
+#include "tasks.hpp"
+#include "work_directory.hpp"
+#include <util/environment.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// A stage that would run, as known before running anything.
+struct planned_stage
+{
+    Stage       stage;
+    std::string builder;
+    bool        required = false;
+};
+
+/// Progress of a run, reported once before and once after each stage.
+struct stage_event
+{
+    enum class kind
+    {
+        started,
+        skipped,
+        finished,
+    };
+    using enum kind;
+
+    kind        what;
+    Stage       stage;
+    std::string builder;
+    std::size_t index = 0;
+
+    /// Only for `finished`.
+    const execution_result* result = nullptr;
+};
+
+struct pipeline_callbacks
+{
+    std::function<void(const stage_event&)> on_stage;
+
+    /// Lines printed by the tools, the terminal gets them when empty.
+    output_sink on_output;
+};
+
+/// The stages vmk runs for a project, for programs that drive vmk in-process instead of spawning it.
+///
+/// Nothing is printed unless the callbacks do, and a run can be stopped between two stages through its stop token.
+class pipeline
+{
+public:
+
+    /// Finds the project `dir` belongs to, nothing if no builder applies to it.
+    static std::optional<pipeline> detect(std::filesystem::path dir, env::environment env = {})
+    {
+        auto root    = builders::git_root_locator(dir).value_or(dir);
+        auto factory = detect_first_stage(work_dir{ root });
+        if (factory == nullptr) {
+            return std::nullopt;
+        }
+
+        import_default_environment(env);
+        return pipeline{ std::move(root), factory, std::move(env) };
+    }
+
+    const std::filesystem::path& root() const
+    {
+        return my_root;
+    }
+
+    const env::environment& environment() const
+    {
+        return my_env;
+    }
+
+    /// The stages from the first one found. Stages created by generators, e.g. the build after a configuration,
+    /// are only listed once their build files exist.
+    std::vector<planned_stage> plan() const
+    {
+        auto result = std::vector<planned_stage>{};
+        for (auto current = first_builder(nullptr); current; current = builder{ current.next_builder() }) {
+            result.push_back({ current.stage(), current.name(), current.required() });
+        }
+        return result;
+    }
+
+    /// Runs all the stages, stopping at the first failure. Returns the result of the last stage that ran.
+    execution_result run(
+        std::span<const std::string> targets,
+        const pipeline_callbacks&    callbacks = {},
+        std::stop_token              stop      = {}) const
+    {
+        auto target_views = std::ranges::to<std::vector<std::string_view>>(targets);
+        auto sink         = callbacks.on_output ? std::make_shared<const output_sink>(callbacks.on_output) : nullptr;
+        auto result       = execution_result{ execution_result::NOT_NEEDED };
+        auto notify       = [&](stage_event::kind what, const builder& current, std::size_t index,
+                              const execution_result* outcome = nullptr) {
+            if (callbacks.on_stage) {
+                callbacks.on_stage(stage_event{ what, current.stage(), current.name(), index, outcome });
+            }
+        };
+
+        auto index = std::size_t{ 0 };
+        for (auto current = first_builder(sink); current && !stop.stop_requested();
+             current      = builder{ current.next_builder() }, ++index) {
+            if (!current.required()) {
+                notify(stage_event::skipped, current, index);
+                continue;
+            }
+
+            notify(stage_event::started, current, index);
+            result = current.run(target_views, argument_container{});
+            notify(stage_event::finished, current, index, &result);
+            if (!result) {
+                break;
+            }
+        }
+        return result;
+    }
+
+    /// Runs the stages on their own thread, the callbacks are called from it.
+    ///
+    /// Like any `std::async` future, the returned one waits for the run when destroyed.
+    std::future<execution_result> run_async(
+        std::vector<std::string> targets,
+        pipeline_callbacks       callbacks = {},
+        std::stop_token          stop      = {}) const
+    {
+        return std::async(
+            std::launch::async,
+            [self = *this, targets = std::move(targets), callbacks = std::move(callbacks), stop = std::move(stop)] {
+                return self.run(targets, callbacks, stop);
+            });
+    }
+
+private:
+
+    std::filesystem::path    my_root;
+    const builders::factory* my_factory;
+    env::environment         my_env;
+
+    pipeline(std::filesystem::path root, const builders::factory* factory, env::environment env)
+        : my_root{ std::move(root) }
+        , my_factory{ factory }
+        , my_env{ std::move(env) }
+    {
+    }
+
+    builder first_builder(std::shared_ptr<const output_sink> sink) const
+    {
+        return builder{ my_factory->my_builder(work_dir{ my_root, std::move(sink) }, my_env) };
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_PIPELINE_HPP
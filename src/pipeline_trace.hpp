@@ -0,0 +1,120 @@
+#ifndef INCLUDED_PIPELINE_TRACE_HPP
+#define INCLUDED_PIPELINE_TRACE_HPP
+
+#include "state.hpp"
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <string_view>
+#include <utility>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// A Chrome trace of a whole vmk run, one event per stage, written by `--trace=«path»`.
+///
+/// The traces the tools write during a stage, e.g. cmake's profile, are folded in under the stage, each on its own
+/// row. Open it in `chrome://tracing` or https://ui.perfetto.dev.
+class pipeline_trace
+{
+public:
+
+    static constexpr auto PROCESS   = 1;
+    static constexpr auto STAGE_TID = 1;
+
+    using clock = std::chrono::steady_clock;
+
+    explicit pipeline_trace(std::filesystem::path path, clock::time_point start = clock::now())
+        : my_path{ std::move(path) }
+        , my_start{ start }
+    {
+    }
+
+    const std::filesystem::path& path() const
+    {
+        return my_path;
+    }
+
+    void add_stage(std::string_view builder, std::string_view stage, clock::time_point started, double seconds, bool succeeded)
+    {
+        my_events.push_back({
+            { "name", std::format("{} → {}", stage, builder) },
+            { "cat", "stage" },
+            { "ph", "X" },
+            { "ts", offset_of(started) },
+            { "dur", seconds * 1e6 },
+            { "pid", PROCESS },
+            { "tid", STAGE_TID },
+            { "args", { { "succeeded", succeeded } } },
+        });
+    }
+
+    /// Adds the events of the trace a tool wrote during the stage started at `started`.
+    ///
+    /// The tools use their own clocks, the events are moved so the earliest one is at the start of the stage.
+    void add_tool_trace(const nlohmann::json& trace, clock::time_point started)
+    {
+        const auto& events = trace.is_object() ? trace.value("traceEvents", nlohmann::json::array()) : trace;
+        if (!events.is_array()) {
+            return;
+        }
+
+        auto earliest = std::numeric_limits<double>::max();
+        for (const auto& event : events) {
+            if (event.contains("ts")) {
+                earliest = std::min(earliest, event.value("ts", 0.0));
+            }
+        }
+
+        auto tid   = STAGE_TID + ++my_tools;
+        auto shift = offset_of(started) - earliest;
+        for (auto event : events) {
+            if (event.contains("ts")) {
+                event["ts"] = event.value("ts", 0.0) + shift;
+            }
+            event["pid"] = PROCESS;
+            event["tid"] = tid;
+            my_events.push_back(std::move(event));
+        }
+    }
+
+    void add_tool_trace(const std::filesystem::path& file, clock::time_point started)
+    {
+        auto trace = nlohmann::json::parse(read_file(file), nullptr, false);
+        if (!trace.is_discarded()) {
+            add_tool_trace(trace, started);
+        }
+    }
+
+    nlohmann::json json() const
+    {
+        return { { "traceEvents", my_events }, { "displayTimeUnit", "ms" } };
+    }
+
+    void write() const
+    {
+        write_atomically(my_path, json().dump());
+    }
+
+private:
+
+    std::filesystem::path my_path;
+    clock::time_point     my_start;
+    nlohmann::json        my_events = nlohmann::json::array();
+    int                   my_tools  = 0;
+
+    /// Microseconds since the start of the run.
+    double offset_of(clock::time_point when) const
+    {
+        return std::chrono::duration<double, std::micro>(when - my_start).count();
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_PIPELINE_TRACE_HPP
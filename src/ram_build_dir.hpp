@@ -0,0 +1,258 @@
+#ifndef INCLUDED_RAM_BUILD_DIR_HPP
+#define INCLUDED_RAM_BUILD_DIR_HPP
+
+#include "file_copy.hpp"
+#include "state.hpp"
+#include "worktree.hpp"
+#include <nlohmann/json.hpp>
+
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Moves the build directory to memory, leaving a symbolic link in its place.
+///
+/// Enabled by `--ram-build-dir`. The directory goes to the first of `$XDG_RUNTIME_DIR` and `/dev/shm` with room
+/// for it, judging by the largest size it reached in the previous runs. When there is no room the build stays on
+/// disk. With `persist` the content is copied back to `«build dir».disk` at the end of each run, and restored from
+/// there when the memory was cleared by a reboot; otherwise the build starts over after a reboot.
+///
+/// The builds go under `vmk-«uid»` in those directories, private to the user, as `/dev/shm` is shared by everyone.
+class ram_build_dir
+{
+public:
+
+    static constexpr auto PERSIST     = "persist"sv;
+    static constexpr auto DISK_SUFFIX = ".disk"sv;
+    static constexpr auto SIZES_FILE  = "build-sizes.json"sv;
+    static constexpr auto GROWTH_ROOM = 1.25;
+
+    static std::vector<std::filesystem::path> default_ram_roots()
+    {
+        auto result = std::vector<std::filesystem::path>{};
+        if (auto runtime = std::getenv("XDG_RUNTIME_DIR"); runtime != nullptr && *runtime != '\0') {
+            result.emplace_back(runtime);
+        }
+        result.emplace_back("/dev/shm");
+        return result;
+    }
+
+    ram_build_dir(
+        std::filesystem::path              root,
+        std::filesystem::path              build_dir,
+        bool                               persist,
+        std::vector<std::filesystem::path> ram_roots = default_ram_roots())
+        : my_root{ std::move(root) }
+        , my_build_dir{ std::move(build_dir) }
+        , my_persist{ persist }
+        , my_ram_roots{ std::move(ram_roots) }
+    {
+    }
+
+    ram_build_dir(const ram_build_dir&)            = delete;
+    ram_build_dir& operator=(const ram_build_dir&) = delete;
+
+    /// Records the size reached, and copies the build back to disk when persisting.
+    ~ram_build_dir()
+    {
+        try {
+            finish();
+        } catch (const std::exception&) {
+            // Nothing else can be done on the way out, the next run starts from whatever is left.
+        }
+    }
+
+    std::filesystem::path disk_copy() const
+    {
+        return std::filesystem::path{ my_build_dir }.concat(DISK_SUFFIX);
+    }
+
+    /// Where the build directory is in memory, nothing if it is still on disk.
+    const std::optional<std::filesystem::path>& location() const
+    {
+        return my_location;
+    }
+
+    /// Makes the build directory point to memory. Returns why it stays on disk, if it does.
+    std::optional<std::string> prepare()
+    {
+        auto error = std::error_code{};
+        if (std::filesystem::is_symlink(my_build_dir)) {
+            if (auto target = std::filesystem::read_symlink(my_build_dir); std::filesystem::is_directory(target)) {
+                my_location = target;
+                return std::nullopt;
+            }
+
+            // The memory was cleared by a reboot, the build is placed again from what is left on disk.
+            std::filesystem::remove(my_build_dir);
+            if (my_persist && std::filesystem::is_directory(disk_copy())) {
+                std::filesystem::rename(disk_copy(), my_build_dir);
+            }
+        }
+
+        auto on_disk  = std::filesystem::is_directory(my_build_dir) ? directory_size(my_build_dir) : 0;
+        auto expected = static_cast<std::uint64_t>(static_cast<double>(std::max(on_disk, recorded_size())) * GROWTH_ROOM);
+        auto relative = my_build_dir.lexically_relative(my_root);
+        if (relative.empty() || *relative.begin() == "..") {
+            relative = my_build_dir.filename();
+        }
+
+        auto target = std::optional<std::filesystem::path>{};
+        for (const auto& ram_root : my_ram_roots) {
+            if (!std::filesystem::is_directory(ram_root) || free_space(ram_root) < expected) {
+                continue;
+            }
+            if (auto own = private_dir(ram_root); own.has_value()) {
+                target = *own / repository_id(my_root) / relative;
+                break;
+            }
+        }
+        if (!target.has_value()) {
+            return std::format("no room for {} MiB in memory, building on disk", expected >> 20);
+        }
+
+        std::filesystem::create_directories(*target);
+        if (std::filesystem::is_directory(my_build_dir)) {
+            mirror(my_build_dir, *target);
+            if (my_persist) {
+                std::filesystem::remove_all(disk_copy(), error);
+                std::filesystem::rename(my_build_dir, disk_copy());
+            } else {
+                std::filesystem::remove_all(my_build_dir);
+            }
+        }
+        std::filesystem::create_directories(my_build_dir.parent_path());
+        std::filesystem::create_directory_symlink(*target, my_build_dir);
+        my_location = target;
+        return std::nullopt;
+    }
+
+    void finish()
+    {
+        if (!my_location.has_value() || !std::filesystem::is_directory(*my_location)) {
+            return;
+        }
+
+        auto sizes = nlohmann::json::parse(read_file(sizes_file()), nullptr, false);
+        if (!sizes.is_object()) {
+            sizes = nlohmann::json::object();
+        }
+        auto& recorded = sizes[my_build_dir.string()];
+        recorded       = std::max(recorded.is_number() ? recorded.get<std::uint64_t>() : 0, directory_size(*my_location));
+        write_atomically(sizes_file(), sizes.dump(2));
+
+        if (my_persist) {
+            mirror(*my_location, disk_copy());
+        }
+        my_location.reset();
+    }
+
+    /// Makes `to` a copy of `from`, only copying the files whose size or modification time differ.
+    ///
+    /// The modification times are kept, the build tools compare them.
+    static void mirror(const std::filesystem::path& from, const std::filesystem::path& to)
+    {
+        std::filesystem::create_directories(to);
+        for (auto it = std::filesystem::recursive_directory_iterator{ from };
+             it != std::filesystem::recursive_directory_iterator{};
+             ++it) {
+            auto target = to / it->path().lexically_relative(from);
+            if (it->is_symlink()) {
+                copy_file(it->path(), target, copy_mode::clone_or_copy);
+            } else if (it->is_directory()) {
+                std::filesystem::create_directories(target);
+            } else if (auto error = std::error_code{};
+                       std::filesystem::file_size(target, error) != it->file_size() ||
+                       std::filesystem::last_write_time(target, error) != it->last_write_time()) {
+                copy_file(it->path(), target, copy_mode::clone_or_copy);
+                std::filesystem::last_write_time(target, it->last_write_time());
+            }
+        }
+
+        // What the build removed goes away too.
+        auto removed = std::vector<std::filesystem::path>{};
+        for (auto it = std::filesystem::recursive_directory_iterator{ to };
+             it != std::filesystem::recursive_directory_iterator{};
+             ++it) {
+            if (!std::filesystem::exists(std::filesystem::symlink_status(from / it->path().lexically_relative(to)))) {
+                removed.push_back(it->path());
+                if (it->is_directory() && !it->is_symlink()) {
+                    it.disable_recursion_pending();
+                }
+            }
+        }
+        for (const auto& path : removed) {
+            std::filesystem::remove_all(path);
+        }
+    }
+
+private:
+
+    std::filesystem::path                my_root;
+    std::filesystem::path                my_build_dir;
+    bool                                 my_persist;
+    std::vector<std::filesystem::path>   my_ram_roots;
+    std::optional<std::filesystem::path> my_location;
+
+    std::filesystem::path sizes_file() const
+    {
+        return repository_state_dir(my_root) / SIZES_FILE;
+    }
+
+    /// The largest size the build directory reached so far.
+    std::uint64_t recorded_size() const
+    {
+        auto sizes = nlohmann::json::parse(read_file(sizes_file()), nullptr, false);
+        if (!sizes.is_object()) {
+            return 0;
+        }
+        return sizes.value(my_build_dir.string(), std::uint64_t{ 0 });
+    }
+
+    /// `vmk-«uid»` in `ram_root`, only readable by the user. Nothing when it is not a directory of the user with those
+    /// permissions, someone else may have created it first to get at the builds.
+    static std::optional<std::filesystem::path> private_dir(const std::filesystem::path& ram_root)
+    {
+        auto dir = ram_root / std::format("vmk-{}", ::getuid());
+        if (::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+            return std::nullopt;
+        }
+
+        struct stat info{};
+        if (::lstat(dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != ::getuid() ||
+            (info.st_mode & 077) != 0) {
+            return std::nullopt;
+        }
+        return dir;
+    }
+
+    static std::uint64_t free_space(const std::filesystem::path& dir)
+    {
+        struct statvfs info{};
+        if (::statvfs(dir.c_str(), &info) != 0) {
+            return 0;
+        }
+        return static_cast<std::uint64_t>(info.f_bavail) * info.f_frsize;
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_RAM_BUILD_DIR_HPP
@@ -3,9 +3,12 @@
 
 #include "util/execution.hpp"
 
+#include <filesystem>
 #include <format>
 #include <iterator>
+#include <map>
 #include <ranges>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -29,6 +32,15 @@ struct execution_result
     int                      exit_code = 0;
     type                     status    = SUCCESS;
 
+    /// Measurements reported by the builder, see `metrics.hpp` for the names.
+    std::map<std::string, double, std::less<>> metrics;
+
+    /// The slowest targets the tool built and how long each took, in seconds.
+    std::vector<std::pair<std::string, double>> slowest_targets;
+
+    /// Chrome traces the tool wrote, to be merged into the trace of the whole run.
+    std::vector<std::filesystem::path> traces;
+
 public:
 
     constexpr explicit operator bool() const
@@ -71,6 +83,9 @@ public:
         for (const auto& current : { others... }) {
             std::ranges::copy(current.output, std::back_inserter(result.output));
             std::ranges::copy(current.error_output, std::back_inserter(result.error_output));
+            result.metrics.insert(current.metrics.begin(), current.metrics.end());
+            std::ranges::copy(current.slowest_targets, std::back_inserter(result.slowest_targets));
+            std::ranges::copy(current.traces, std::back_inserter(result.traces));
         }
         return result;
     }
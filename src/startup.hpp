@@ -0,0 +1,144 @@
+#ifndef INCLUDED_STARTUP_HPP
+#define INCLUDED_STARTUP_HPP
+
+#include "builders.hpp"
+#include "tasks.hpp"
+#include "work_directory.hpp"
+#include <util/environment.hpp>
+
+#include <array>
+#include <chrono>
+#include <print>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+constexpr auto default_environment = std::array{
+    "CC"sv,
+    "CXX"sv,
+    "DISPLAY"sv,
+    "GID"sv,
+    "HOME"sv,
+    "HOST"sv,
+    "HOSTNAME"sv,
+    "LANG"sv,
+    "LC_ADDRESS"sv,
+    "LC_ALL"sv,
+    "LC_MEASUREMENT"sv,
+    "LC_MONETARY"sv,
+    "LC_NUMERIC"sv,
+    "LC_PAPER"sv,
+    "LC_TELEPHONE"sv,
+    "LC_TIME"sv,
+    "PATH"sv,
+    "SHELL"sv,
+    "SSH_AGENT_PID"sv,
+    "SSH_AUTO_SOCK"sv,
+    "TERM"sv,
+    "TTY"sv,
+    "UID"sv,
+    "USER"sv,
+    "USERNAME"sv,
+    "VMK_SHARE_WORKTREES"sv,
+    "WAYLAND_DISPLAY"sv,
+    "XDG_CACHE_HOME"sv,
+    "XDG_CONFIG_DIRS"sv,
+    "XDG_CONFIG_HOME"sv,
+    "XDG_DATA_DIRS"sv,
+    "XDG_DATA_HOME"sv,
+    "XDG_DESKTOP_DIR"sv,
+    "XDG_DOCUMENTS_DIR"sv,
+    "XDG_DOWNLOAD_DIR"sv,
+    "XDG_MUSIC_DIR"sv,
+    "XDG_PICTURES_DIR"sv,
+    "XDG_PUBLICSHARE_DIR"sv,
+    "XDG_RUNTIME_DIR"sv,
+    "XDG_STATE_HOME"sv,
+    "XDG_TEMPLATES_DIR"sv,
+    "XDG_VIDEOS_DIR"sv,
+};
+
+/// Time spent by vmk before it starts the first tool, broken down by phase.
+///
+/// vmk is called from editor save hooks, this is the overhead users feel on every call.
+class startup_profile
+{
+public:
+
+    using clock = std::chrono::steady_clock;
+
+    explicit startup_profile(bool enabled = false, clock::time_point start = clock::now())
+        : my_enabled{ enabled }
+        , my_start{ start }
+        , my_last{ start }
+    {
+    }
+
+    void mark(std::string_view phase)
+    {
+        auto now = clock::now();
+        my_phases.emplace_back(phase, now - my_last);
+        my_last = now;
+    }
+
+    clock::duration total() const
+    {
+        return my_last - my_start;
+    }
+
+    const auto& phases() const
+    {
+        return my_phases;
+    }
+
+    /// Prints the breakdown once, the first time it is called after the first spawn.
+    void report()
+    {
+        if (!my_enabled || my_reported) {
+            return;
+        }
+        my_reported = true;
+
+        std::println("⏱ startup: {} until the first spawn", std::chrono::duration_cast<std::chrono::microseconds>(total()));
+        for (const auto& [phase, duration] : my_phases) {
+            std::println("    {:<20} {:>10}", phase, std::chrono::duration_cast<std::chrono::microseconds>(duration));
+        }
+    }
+
+private:
+
+    bool                                                   my_enabled;
+    bool                                                   my_reported = false;
+    clock::time_point                                      my_start;
+    clock::time_point                                      my_last;
+    std::vector<std::pair<std::string_view, clock::duration>> my_phases;
+};
+
+/// Finds the factory for the earliest stage applicable to `root`, looking only at the files.
+///
+/// Nothing is created here: the environment is only imported once a builder was found, and builders only read their
+/// own files (presets, conan profiles…) when they need them.
+inline const builders::factory* detect_first_stage(work_dir root)
+{
+    for (auto stage : all_stages) {
+        if (auto found = builders::detect(root, stage); found != nullptr) {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+inline void import_default_environment(env::environment& env)
+{
+    for (auto var_name : default_environment) {
+        env.import(var_name);
+    }
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_STARTUP_HPP
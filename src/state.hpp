@@ -0,0 +1,64 @@
+#ifndef INCLUDED_STATE_HPP
+#define INCLUDED_STATE_HPP
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Directory where vmk keeps its own bookkeeping inside a build directory, without creating it.
+inline std::filesystem::path state_path(std::filesystem::path build_dir)
+{
+    return build_dir / ".vmk";
+}
+
+/// Directory where vmk keeps its own bookkeeping inside a build directory.
+inline std::filesystem::path state_dir(std::filesystem::path build_dir)
+{
+    auto result = state_path(std::move(build_dir));
+    std::filesystem::create_directories(result);
+    return result;
+}
+
+inline std::string read_file(const std::filesystem::path& file)
+{
+    auto content = std::ostringstream{};
+    if (std::filesystem::is_regular_file(file)) {
+        content << std::ifstream{ file, std::ios::binary }.rdbuf();
+    }
+    return std::move(content).str();
+}
+
+/// Replaces `file` with `content` so that readers never see a partial file.
+///
+/// The content is written to a temporary sibling which is then renamed over the target.
+inline void write_atomically(const std::filesystem::path& file, std::string_view content)
+{
+    auto temporary = file;
+    temporary += std::format(".{}.tmp", ::getpid());
+
+    {
+        auto out = std::ofstream{ temporary, std::ios::binary | std::ios::trunc };
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!out.flush()) {
+            std::filesystem::remove(temporary);
+            throw std::system_error{ std::make_error_code(std::errc::io_error),
+                                     std::format("Could not write {}", temporary.string()) };
+        }
+    }
+
+    std::filesystem::rename(temporary, file);
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_STATE_HPP
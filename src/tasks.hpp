@@ -21,6 +21,7 @@ enum class task_type : std::size_t
     configuration,
     build,
     test,
+    bench,
     package,
     install,
     DONE,
@@ -134,7 +135,9 @@ private:
                        Information{ "configure"sv, "conf"sv, "Build configuration stage."sv } },
             std::pair{ task_type::build, Information{ "build"sv, "build"sv, "Build stage."sv } },
             std::pair{ task_type::test, Information{ "test"sv, "test"sv, "Test stage."sv } },
+            std::pair{ task_type::bench, Information{ "bench"sv, "bench"sv, "Benchmark stage."sv } },
             std::pair{ task_type::package, Information{ "package"sv, "pack"sv, "Packaging stage."sv } },
+            std::pair{ task_type::install, Information{ "install"sv, "install"sv, "Installation stage."sv } },
             std::pair{ task_type::DONE, Information{ "DONE"sv, ""sv, ""sv } },
             std::pair{ task_type::DYNAMIC, Information{ "dynamic"sv, ""sv, ""sv } }
         };
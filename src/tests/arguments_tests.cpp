@@ -31,4 +31,13 @@ TEST_CASE("Empty_argument_list", "[arguments][not_present]")
     CHECK_THAT(Stage{task_type::test}.filter_arguments(arg_list), Catch::Matchers::RangeEquals(std::vector<std::string_view>{}));
 }
 
+TEST_CASE("Option_value", "[arguments]")
+{
+    CHECK(option_value("--metrics-file=out/vmk.prom"sv, "--metrics-file"sv) == "out/vmk.prom"sv);
+    CHECK(option_value("--metrics-file="sv, "--metrics-file"sv).empty());
+    CHECK(option_value("--metrics-file"sv, "--metrics-file"sv).empty());
+    CHECK(option_value("--trace=/tmp/vmk.json"sv, "--trace"sv) == "/tmp/vmk.json"sv);
+    CHECK(option_value("--trace"sv, "--trace"sv).empty());
+}
+
 }
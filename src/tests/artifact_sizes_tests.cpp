@@ -0,0 +1,84 @@
+#include "artifact_sizes.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("artifact_sizes_read", "[artifact_sizes]")
+{
+    // The test program itself is an executable of this machine.
+    auto self = artifact_sizes::read("/proc/self/exe");
+    REQUIRE(self.has_value());
+    CHECK(self->file == std::filesystem::file_size("/proc/self/exe"));
+    CHECK(self->text > 0);
+    CHECK(self->rodata > 0);
+    CHECK(self->symbols > 0);
+    CHECK(self->text + self->rodata + self->data + self->debug <= self->file);
+
+    CHECK_FALSE(artifact_sizes::parse("#!/bin/sh\necho not an ELF file\n").has_value());
+}
+
+TEST_CASE("artifact_sizes_scan", "[artifact_sizes]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-artifacts-{}", ::getpid());
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "bin");
+    std::filesystem::create_directories(dir / "CMakeFiles");
+    std::filesystem::copy_file("/proc/self/exe", dir / "bin" / "app");
+    std::filesystem::copy_file("/proc/self/exe", dir / "CMakeFiles" / "a.out");
+    std::ofstream{ dir / "bin" / "script" } << "#!/bin/sh\n";
+    std::filesystem::permissions(dir / "bin" / "script", std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+
+    auto artifacts = artifact_sizes::scan(dir);
+    REQUIRE(artifacts.size() == 1);
+    CHECK(artifacts.front().name == "bin/app");
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("artifact_sizes_summary", "[artifact_sizes]")
+{
+    auto file = std::filesystem::temp_directory_path() / std::format("vmk-artifact-history-{}", ::getpid()) / history::FILE;
+    std::filesystem::remove_all(file.parent_path());
+
+    auto app     = artifact_size{ "bin/app", 2 << 20, 1 << 20, 1000, 100, 0, 50 };
+    auto library = artifact_size{ "lib/libcore.so", 1 << 20, 1 << 19, 1000, 100, 0, 50 };
+
+    for (const auto& artifact : { app, library }) {
+        auto record          = history_record{};
+        record.type          = history_record::kind::artifact;
+        record.configuration = 7;
+        record.succeeded     = 1;
+        record.sizes         = artifact.sizes();
+        record.set_name(artifact.name);
+        history{ file }.append(std::vector{ record });
+    }
+    CHECK(history{ file }.records().size() == 2);
+
+    auto before = artifact_sizes::previous(history{ file }, 7);
+    CHECK(before.at("bin/app")[0] == 2 << 20);
+    CHECK(before.at("bin/app")[1] == 1 << 20);
+    CHECK(artifact_sizes::previous(history{ file }, 8).empty());
+
+    auto grown = app;
+    grown.file += 1 << 20;
+    grown.text += 1 << 20;
+    auto summary = artifact_sizes::summary({ grown, library }, before);
+    REQUIRE(summary.size() == 2);
+    CHECK(summary[0].starts_with("📏 2 artifacts, 4.0 MiB (+1.0 MiB, +33.3%)"));
+    CHECK(summary[1].contains("bin/app"));
+    CHECK(summary[1].contains("text (+1.0 MiB, +100.0%)"));
+
+    auto unchanged = artifact_sizes::summary({ app, library }, before);
+    CHECK(unchanged.size() == 3);
+
+    std::filesystem::remove_all(file.parent_path());
+}
+
+} // namespace vb::maker
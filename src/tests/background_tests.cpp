@@ -0,0 +1,54 @@
+#include "background.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <map>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("background_cpu_times", "[background]")
+{
+    auto times = background_mode::parse_cpu_times(
+        "cpu  100 10 50 800 20 5 5 10 0 0\ncpu0 50 5 25 400 10 2 3 5 0 0\n");
+    REQUIRE(times.has_value());
+    CHECK(times->busy == 180);
+    CHECK(times->total == 1000);
+
+    CHECK_FALSE(background_mode::parse_cpu_times("intr 1 2 3").has_value());
+}
+
+TEST_CASE("background_process_stat", "[background]")
+{
+    auto stat = background_mode::parse_process_stat(
+        "4242 (cc1plus (x) y) R 4200 4242 4100 0 -1 4194304 5000 0 0 0 150 30 0 0 39 19 1 0 123 456 789");
+    REQUIRE(stat.has_value());
+    CHECK(stat->parent == 4200);
+    CHECK(stat->ticks == 180);
+
+    CHECK_FALSE(background_mode::parse_process_stat("4242 (short) R 1").has_value());
+}
+
+TEST_CASE("background_pause_hysteresis", "[background]")
+{
+    CHECK_FALSE(background_mode::should_pause(false, 0.4));
+    CHECK(background_mode::should_pause(false, 0.6));
+    CHECK(background_mode::should_pause(true, 0.4));
+    CHECK_FALSE(background_mode::should_pause(true, 0.1));
+}
+
+TEST_CASE("background_descendants", "[background]")
+{
+    auto processes = std::map<pid_t, background_mode::process_stat>{
+        { 10, { 1, 0 } }, { 20, { 10, 0 } }, { 30, { 20, 0 } }, { 40, { 1, 0 } }, { 50, { 20, 0 } },
+    };
+
+    auto found = background_mode::descendants(10, processes);
+    std::ranges::sort(found);
+    CHECK(found == std::vector<pid_t>{ 20, 30, 50 });
+    CHECK(background_mode::descendants(40, processes).empty());
+}
+
+} // namespace vb::maker
@@ -0,0 +1,160 @@
+#include "benchmarks.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("benchmarks_google_benchmark", "[benchmarks]")
+{
+    auto report = nlohmann::json::parse(R"({ "benchmarks": [
+        { "name": "BM_sort/64", "run_name": "BM_sort/64", "run_type": "iteration", "real_time": 1.0, "time_unit": "us" },
+        { "name": "BM_sort/64", "run_name": "BM_sort/64", "run_type": "iteration", "real_time": 3.0, "time_unit": "us" },
+        { "name": "BM_sort/64_mean", "run_name": "BM_sort/64", "run_type": "aggregate", "real_time": 2.0, "time_unit": "us" },
+        { "name": "BM_hash", "run_type": "iteration", "real_time": 50.0, "time_unit": "ns" }
+    ] })");
+
+    auto set = benchmark_set{ "abc" };
+    set.add_google_benchmark(report, "sorting/");
+
+    REQUIRE(set.results().size() == 2);
+    const auto& sort = set.results().at("sorting/BM_sort/64");
+    CHECK(sort.samples == 2);
+    CHECK(sort.mean == Catch::Approx(2000.0));
+    CHECK(sort.stddev == Catch::Approx(1414.2135));
+    CHECK(set.results().at("sorting/BM_hash").mean == Catch::Approx(50.0));
+}
+
+TEST_CASE("benchmarks_catch2", "[benchmarks]")
+{
+    auto report = R"(<?xml version="1.0" encoding="UTF-8"?>
+<Catch2TestRun name="tests">
+  <TestCase name="parsing">
+    <BenchmarkResults name="parse small" samples="100" resamples="100000" iterations="3" clockResolution="20" estimatedDuration="1000">
+      <!-- All values in nano seconds -->
+      <mean value="120.5" lowerBound="119" upperBound="122" ci="0.95"/>
+      <standardDeviation value="4.5" lowerBound="3" upperBound="6" ci="0.95"/>
+      <outliers variance="0.1" lowMild="0" lowSevere="0" highMild="2" highSevere="0"/>
+    </BenchmarkResults>
+    <BenchmarkResults name="parse large" samples="50" iterations="1">
+      <mean value="9000" lowerBound="8900" upperBound="9100" ci="0.95"/>
+    </BenchmarkResults>
+  </TestCase>
+</Catch2TestRun>)"sv;
+
+    auto set = benchmark_set{};
+    set.add_catch2(report);
+
+    REQUIRE(set.results().size() == 2);
+    CHECK(set.results().at("parse small").mean == Catch::Approx(120.5));
+    CHECK(set.results().at("parse small").stddev == Catch::Approx(4.5));
+    CHECK(set.results().at("parse small").samples == 100);
+    CHECK(set.results().at("parse large").stddev == 0.0);
+    CHECK(set.results().at("parse large").samples == 50);
+}
+
+TEST_CASE("benchmarks_comparison", "[benchmarks]")
+{
+    auto steady = std::array{ 100.0, 101.0, 99.0, 100.0, 100.5, 99.5 };
+    auto slower = std::array{ 110.0, 111.0, 109.0, 110.0, 110.5, 109.5 };
+    auto noisy  = std::array{ 60.0, 150.0, 90.0, 140.0, 75.0, 155.0 };
+
+    auto base = benchmark_set{ "base" };
+    base.add("steady", benchmark_result::of(steady));
+    base.add("regressed", benchmark_result::of(steady));
+    base.add("noisy", benchmark_result::of(steady));
+    base.add("removed", benchmark_result::of(steady));
+
+    auto current = benchmark_set{ "current" };
+    current.add("steady", benchmark_result::of(steady));
+    current.add("regressed", benchmark_result::of(slower));
+    current.add("noisy", benchmark_result::of(noisy));
+    current.add("added", benchmark_result::of(slower));
+
+    auto compared = benchmark_set::from_json(current.json()).compare(benchmark_set::from_json(base.json()));
+    REQUIRE(compared.size() == 3);
+    CHECK(compared[0].name == "noisy");
+    CHECK(compared[0].change > 0.05);
+    CHECK_FALSE(compared[0].significant);
+    CHECK(compared[1].name == "regressed");
+    CHECK(compared[1].change == Catch::Approx(0.1));
+    CHECK(compared[1].significant);
+    CHECK(compared[2].name == "steady");
+    CHECK(compared[2].change == Catch::Approx(0.0));
+    CHECK_FALSE(compared[2].significant);
+
+    auto halved = std::vector{ benchmark_comparison{ "a", 1.0 }, benchmark_comparison{ "b", -0.5 } };
+    CHECK(benchmark_set::mean_change(halved).value() == Catch::Approx(0.0));
+    CHECK_FALSE(benchmark_set::mean_change({}).has_value());
+}
+
+TEST_CASE("benchmarks_baseline", "[benchmarks]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-bench-baseline-{}", ::getpid());
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "project");
+    ::setenv("XDG_STATE_HOME", (dir / "state").c_str(), 1);
+
+    // The newest results are those of a variant, the plain baseline still is the older plain run.
+    auto stored = std::filesystem::file_time_type::clock::now();
+    for (auto name : { "aaaa"sv, "bbbb-pgo"sv }) {
+        benchmark_set{ std::string{ name } }.store(dir / "project");
+        auto file = benchmark_set::directory(dir / "project") / std::format("{}.json", name);
+        std::filesystem::last_write_time(file, stored);
+        stored += std::chrono::seconds{ 10 };
+    }
+
+    CHECK(benchmark_set::baseline(dir / "project", "cccc").value().commit() == "aaaa");
+    CHECK(benchmark_set::baseline(dir / "project", "cccc-pgo", {}, "pgo").value().commit() == "bbbb-pgo");
+    CHECK_FALSE(benchmark_set::baseline(dir / "project", "bbbb-lto", "bbbb", "lto").has_value());
+    CHECK_FALSE(benchmark_set::baseline(dir / "project", "cccc-pgo", "bbbb").has_value());
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("benchmarks_programs", "[benchmarks]")
+{
+    auto ctest = nlohmann::json::parse(R"({ "kind": "ctestInfo", "tests": [
+        { "name": "bench_parser", "command": [ "/build/bench_parser", "--quick" ],
+          "properties": [ { "name": "LABELS", "value": [ "benchmark" ] },
+                          { "name": "WORKING_DIRECTORY", "value": "/build/data" } ] },
+        { "name": "bench_missing", "properties": [] }
+    ] })");
+    auto from_ctest = benchmark_program::from_ctest(ctest);
+    REQUIRE(from_ctest.size() == 1);
+    CHECK(from_ctest[0].name == "bench_parser");
+    CHECK(from_ctest[0].command == std::vector{ "/build/bench_parser"s, "--quick"s });
+    CHECK(from_ctest[0].working_directory == "/build/data");
+
+    auto meson      = nlohmann::json::parse(R"([ { "name": "hashing", "cmd": [ "/build/hashing" ], "workdir": null } ])");
+    auto from_meson = benchmark_program::from_meson(meson);
+    REQUIRE(from_meson.size() == 1);
+    CHECK(from_meson[0].name == "hashing");
+    CHECK(from_meson[0].working_directory.empty());
+
+    CHECK(benchmark_program::kind_of("\0--benchmark_format=<console|json|csv>\0"sv) == benchmark_program::kind::google);
+    CHECK(benchmark_program::kind_of("\0--benchmark-samples\0"sv) == benchmark_program::kind::catch2);
+    CHECK(benchmark_program::kind_of("\0--help\0"sv) == benchmark_program::kind::plain);
+
+    // The option straddles two chunks of the file.
+    auto file = std::filesystem::temp_directory_path() / std::format("vmk-bench-kind-{}", ::getpid());
+    std::ofstream{ file, std::ios::binary } << std::string((1 << 16) - 5, '\0') << "--benchmark-samples" << '\0';
+    CHECK(benchmark_program::kind_of_file(file) == benchmark_program::kind::catch2);
+    std::ofstream{ file, std::ios::binary } << std::string(3 << 16, 'x');
+    CHECK(benchmark_program::kind_of_file(file) == benchmark_program::kind::plain);
+    std::filesystem::remove(file);
+}
+
+} // namespace vb::maker
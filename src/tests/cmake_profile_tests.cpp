@@ -0,0 +1,64 @@
+#include "cmake_profile.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <string_view>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("cmake_profile_arguments", "[cmake_profile]")
+{
+    auto arguments = cmake_profile::arguments("/b/.vmk/cmake-profile.json");
+    CHECK(arguments[0] == "--profiling-format=google-trace");
+    CHECK(arguments[1] == "--profiling-output=/b/.vmk/cmake-profile.json");
+}
+
+TEST_CASE("cmake_profile_categories", "[cmake_profile]")
+{
+    // CMakeLists.txt includes deps.cmake, which looks for Boost and runs a check.
+    auto trace = nlohmann::json::parse(R"([
+        { "ph": "X", "name": "include", "ts": 0, "dur": 5000000,
+          "args": { "functionArgs": "deps.cmake", "location": "/src/CMakeLists.txt:3" } },
+        { "ph": "X", "name": "find_package", "ts": 1000000, "dur": 3000000,
+          "args": { "functionArgs": "Boost REQUIRED", "location": "/src/deps.cmake:1" } },
+        { "ph": "X", "name": "try_compile", "ts": 1500000, "dur": 2000000,
+          "args": { "functionArgs": "HAS_FOO ...", "location": "/usr/share/cmake/FindBoost.cmake:900" } },
+        { "ph": "X", "name": "set", "ts": 6000000, "dur": 1000, "args": { "location": "/src/CMakeLists.txt:8" } },
+        { "ph": "X", "name": "set", "ts": 6100000, "dur": 1000, "args": { "location": "/src/CMakeLists.txt:9" } },
+        { "ph": "M", "name": "process_name" }
+    ])");
+
+    auto profile = cmake_profile{};
+    profile.add(trace);
+
+    REQUIRE(profile.packages().contains("Boost"));
+    CHECK(profile.packages().at("Boost").seconds == Catch::Approx(3.0));
+    REQUIRE(profile.includes().contains("deps.cmake"));
+    CHECK(profile.includes().at("deps.cmake").seconds == Catch::Approx(5.0));
+    REQUIRE(profile.checks().contains("/usr/share/cmake/FindBoost.cmake"));
+    CHECK(profile.commands().at("set").count == 2);
+
+    // The time of nested calls is only charged to the file they are in.
+    CHECK(profile.files().at("/src/CMakeLists.txt").seconds == Catch::Approx(2.002));
+    CHECK(profile.files().at("/src/deps.cmake").seconds == Catch::Approx(1.0));
+    CHECK(profile.files().at("/usr/share/cmake/FindBoost.cmake").seconds == Catch::Approx(2.0));
+
+    auto summary = profile.summary();
+    REQUIRE(summary.front() == "🐢 slowest find_package:");
+    CHECK(summary[1].ends_with("1×  Boost"));
+}
+
+TEST_CASE("cmake_profile_trace_object", "[cmake_profile]")
+{
+    auto profile = cmake_profile{};
+    profile.add(nlohmann::json::parse(R"({ "traceEvents": [
+        { "ph": "X", "name": "find_package", "ts": 0, "dur": 1000000, "args": { "functionArgs": "fmt" } }
+    ] })"));
+
+    CHECK(profile.packages().contains("fmt"));
+    CHECK(profile.files().contains("«cmake»"));
+}
+
+} // namespace vb::maker
@@ -0,0 +1,87 @@
+#include "compile_database.hpp"
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_range_equals.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace {
+
+void write_database(const std::filesystem::path& file, std::string_view content)
+{
+    std::filesystem::create_directories(file.parent_path());
+    std::ofstream{ file } << content;
+}
+
+} // namespace
+
+TEST_CASE("compile_database_streaming", "[compile_commands][json]")
+{
+    auto file = std::filesystem::temp_directory_path() / std::format("vmk-db-{}.json", ::getpid());
+    write_database(file, R"([{"file":"a.cpp","arguments":["g++","-c",["x",{"k":[1,2]}]]}, {"file":"b.cpp"}])");
+
+    auto files = std::vector<std::string>{};
+    REQUIRE(for_each_compile_command(file, [&](nlohmann::json&& entry) {
+        files.push_back(entry["file"].get<std::string>());
+        if (files.size() == 1) {
+            CHECK(entry["arguments"][2][1]["k"][1] == 2);
+        }
+    }));
+    CHECK_THAT(files, Catch::Matchers::RangeEquals(std::vector{ "a.cpp"s, "b.cpp"s }));
+
+    write_database(file, R"({"not":"an array"})");
+    CHECK_FALSE(for_each_compile_command(file, [](nlohmann::json&&) {}));
+    std::filesystem::remove(file);
+}
+
+TEST_CASE("compile_database_merge", "[compile_commands][json]")
+{
+    auto root = std::filesystem::temp_directory_path() / std::format("vmk-merge-{}", ::getpid());
+    std::filesystem::remove_all(root);
+
+    write_database(
+        root / "build/gcc" / compile_database_merger::DATABASE,
+        R"([{"directory":"/p/build/gcc","file":"/p/a.cpp","command":"g++ a"},
+            {"directory":"/p/build/gcc","file":"../../b.cpp","command":"g++ b"}])");
+    write_database(
+        root / "build/clang" / compile_database_merger::DATABASE,
+        R"([{"directory":"/p/build/clang","file":"/p/a.cpp","command":"clang++ a"}])");
+
+    auto merger = compile_database_merger{ root, root / "build/clang" };
+    REQUIRE(merger.merge());
+
+    auto commands = std::vector<std::string>{};
+    for_each_compile_command(root / compile_database_merger::DATABASE, [&](nlohmann::json&& entry) {
+        commands.push_back(entry["command"].get<std::string>());
+    });
+    CHECK_THAT(commands, Catch::Matchers::RangeEquals(std::vector{ "clang++ a"s, "g++ b"s }));
+
+    SECTION("unchanged inputs are not merged again")
+    {
+        auto written = std::filesystem::last_write_time(root / compile_database_merger::DATABASE);
+        CHECK_FALSE(merger.merge());
+        CHECK(std::filesystem::last_write_time(root / compile_database_merger::DATABASE) == written);
+    }
+
+    SECTION("a database written by the build is merged again")
+    {
+        CHECK_FALSE(merger.stale());
+        auto regenerated = root / "build/gcc" / compile_database_merger::DATABASE;
+        std::filesystem::last_write_time(regenerated, std::filesystem::last_write_time(regenerated) + 1s);
+        CHECK(merger.stale());
+        merger.merge();
+        CHECK_FALSE(merger.stale());
+    }
+
+    std::filesystem::remove_all(root);
+}
+
+}
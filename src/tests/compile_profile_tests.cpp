@@ -0,0 +1,61 @@
+#include "compile_profile.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <string_view>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("compile_profile_flag", "[compile_profile]")
+{
+    CHECK(compile_profile::flag_for("clang version 18.1.8") == "-ftime-trace");
+    CHECK(compile_profile::flag_for("Ubuntu clang version 17.0.6") == "-ftime-trace");
+    CHECK(compile_profile::flag_for("g++ (GCC) 14.2.1 20240910") == "-ftime-report");
+}
+
+TEST_CASE("compile_profile_gcc_report", "[compile_profile]")
+{
+    auto profile = compile_profile{};
+
+    CHECK_FALSE(profile.add_report_line("[1/2] Building CXX object a.o"));
+    CHECK(profile.add_report_line("Time variable                                   usr           sys          wall           GGC"));
+    CHECK(profile.add_report_line(" phase parsing                      :   0.32 ( 64%)   0.10 ( 71%)   0.43 ( 65%)    58M ( 73%)"));
+    CHECK(profile.add_report_line(" phase opt and generate             :   0.13 ( 26%)   0.04 ( 29%)   0.17 ( 26%)    20M ( 25%)"));
+    CHECK(profile.add_report_line(" template instantiation             :   0.06 ( 12%)   0.00 (  0%)   0.07 ( 10%)  9000k ( 11%)"));
+    CHECK(profile.add_report_line(" TOTAL                              :   0.50          0.14          0.65            80M"));
+
+    CHECK(profile.units() == 1);
+    CHECK(profile.frontend_seconds() == Catch::Approx(0.43));
+    CHECK(profile.backend_seconds() == Catch::Approx(0.17));
+    CHECK(profile.summary().back().ends_with("template instantiation"));
+}
+
+TEST_CASE("compile_profile_clang_traces", "[compile_profile]")
+{
+    auto trace = nlohmann::json::parse(R"({ "traceEvents": [
+        { "ph": "X", "name": "Frontend", "dur": 2000000 },
+        { "ph": "X", "name": "Backend", "dur": 1000000 },
+        { "ph": "X", "name": "InstantiateClass", "dur": 500000, "args": { "detail": "std::vector<int>" } },
+        { "ph": "X", "name": "Source", "dur": 700000, "args": { "detail": "/usr/include/c++/14/vector" } },
+        { "ph": "M", "name": "process_name" }
+    ] })");
+
+    auto first  = compile_profile{};
+    auto second = compile_profile{};
+    first.add_trace(trace);
+    second.add_trace(trace);
+    first.merge(second);
+
+    CHECK(first.units() == 2);
+    CHECK(first.frontend_seconds() == Catch::Approx(4.0));
+    CHECK(first.backend_seconds() == Catch::Approx(2.0));
+
+    auto summary = first.summary();
+    REQUIRE(summary.size() == 5);
+    CHECK(summary[2].ends_with("2×  std::vector<int>"));
+    CHECK(summary[4].ends_with("2×  /usr/include/c++/14/vector"));
+}
+
+} // namespace vb::maker
@@ -0,0 +1,66 @@
+#include "conan_install_report.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("conan_install_report_references", "[conan_install_report]")
+{
+    CHECK(conan_install_report::reference_of("zlib/1.3.1: Calling build()") == "zlib/1.3.1");
+    CHECK(conan_install_report::reference_of("fmt/10.2.1#f2b2ab7d: Downloaded package") == "fmt/10.2.1#f2b2ab7d");
+    CHECK_FALSE(conan_install_report::reference_of("======== Installing packages ========").has_value());
+    CHECK_FALSE(conan_install_report::reference_of("Requirements: none").has_value());
+    CHECK_FALSE(conan_install_report::reference_of("-------- Installing package zlib/1.3.1 (1 of 2) --------").has_value());
+
+    CHECK(conan_install_report::is_error("ERROR: Package 'zlib/1.3.1' not resolved"));
+    CHECK_FALSE(conan_install_report::is_error("zlib/1.3.1: Calling build()"));
+    CHECK_FALSE(conan_install_report::is_error("WARN: deprecated: Usage of deprecated Conan 1.X features"));
+}
+
+TEST_CASE("conan_install_report_packages", "[conan_install_report]")
+{
+    auto folder = std::filesystem::temp_directory_path() / "vmk_conan_report_package";
+    std::filesystem::create_directories(folder / "lib");
+    std::ofstream{ folder / "lib" / "libz.a" } << std::string(1000, 'z');
+
+    auto graph = nlohmann::json::parse(R"({ "graph": { "nodes": {
+        "0": { "ref": "conanfile", "binary": null },
+        "1": { "ref": "zlib/1.3.1#b8bc2603", "binary": "Build", "package_folder": ")" + folder.generic_string() + R"(" },
+        "2": { "ref": "fmt/10.2.1#f2b2ab7d", "binary": "Download", "package_folder": null },
+        "3": { "ref": "cmake/3.30.0#a1b2c3d4", "binary": "Skip" }
+    } } })");
+
+    auto start  = conan_install_report::clock::now();
+    auto report = conan_install_report{};
+    report.add_log_line("fmt/10.2.1: Retrieving package from remote 'conancenter'", start);
+    report.add_log_line("zlib/1.3.1: Calling build()", start + 1s);
+    report.add_log_line("fmt/10.2.1: Package installed", start + 2s);
+    report.add_log_line("zlib/1.3.1: Package 'abc' created", start + 31s);
+    report.add_graph(graph);
+
+    auto packages = report.packages();
+    REQUIRE(packages.size() == 2);
+    CHECK(packages[0].reference == "zlib/1.3.1");
+    CHECK(packages[0].seconds == Catch::Approx(30.0));
+    CHECK(packages[0].bytes == 1000);
+    CHECK(packages[1].reference == "fmt/10.2.1");
+    CHECK(packages[1].binary == conan_install_report::DOWNLOAD);
+    CHECK(packages[1].seconds == Catch::Approx(2.0));
+
+    CHECK(report.built_from_source() == std::vector{ "zlib/1.3.1"s });
+    auto summary = report.summary();
+    REQUIRE(summary.size() == 3);
+    CHECK(summary[0].contains("built from source"));
+    CHECK(summary[2].contains("zlib/1.3.1"));
+
+    std::filesystem::remove_all(folder);
+}
+
+} // namespace vb::maker
@@ -0,0 +1,76 @@
+#include "cpack_report.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("cpack_report_configuration", "[cpack_report]")
+{
+    auto config = R"(set(CPACK_BUILD_SOURCE_DIRS "/src;/build")
+set(CPACK_GENERATOR "TGZ;DEB")
+set(CPACK_PACKAGE_NAME "app"))"sv;
+    CHECK(cpack_report::generators_of(config) == std::vector{ "TGZ"s, "DEB"s });
+    CHECK(cpack_report::generators_of(R"(set(CPACK_PACKAGE_NAME "app"))"sv).empty());
+
+    CHECK(cpack_report::threads_for(1, 16) == 16);
+    CHECK(cpack_report::threads_for(3, 16) == 5);
+    CHECK(cpack_report::threads_for(4, 2) == 1);
+    CHECK(cpack_report::threads_for(0, 0) == 1);
+}
+
+TEST_CASE("cpack_report_groups", "[cpack_report]")
+{
+    auto runs = std::vector<cpack_report::destination>{
+        { "/build/release", { "TGZ"s, "DEB"s } },
+        { "/build/release", { "ZIP"s } },
+        { "/build/debug", { "TGZ"s } },
+        { "/build/release", { "DEB"s } },
+        { "/build/release", { "ZIP"s, "TGZ"s } },
+    };
+
+    // The DEB run follows the first one, the ZIP ones then join them through TGZ.
+    CHECK(cpack_report::groups_of(runs) == std::vector<std::vector<std::size_t>>{ { 0, 1, 3, 4 }, { 2 } });
+    runs.pop_back();
+    CHECK(cpack_report::groups_of(runs) == std::vector<std::vector<std::size_t>>{ { 0, 3 }, { 1 }, { 2 } });
+    CHECK(cpack_report::groups_of({}).empty());
+}
+
+TEST_CASE("cpack_report_packages", "[cpack_report]")
+{
+    auto folder = std::filesystem::temp_directory_path() / "vmk_cpack_report";
+    std::filesystem::create_directories(folder);
+    auto archive = folder / "app-1.0-Linux.tar.zst";
+    std::ofstream{ archive } << std::string(2048, 'p');
+
+    CHECK(cpack_report::package_of("CPack: - package: /b/app.deb generated.") == "/b/app.deb");
+    CHECK_FALSE(cpack_report::package_of("CPack: - checksum file: /b/app.deb.sha256 generated.").has_value());
+    CHECK_FALSE(cpack_report::package_of("CPack: Create package").has_value());
+
+    auto report = cpack_report{};
+    auto output = std::vector{ "CPack: Create package using TGZ"s,
+                               std::format("CPack: - package: {} generated.", archive.string()) };
+    report.add_run("TGZ", output, 2.5);
+    report.add_run("DEB", { "CPack: - package: /nowhere/app.deb generated."s }, 4.0);
+
+    REQUIRE(report.packages().size() == 2);
+    CHECK(report.packages()[0].bytes == 2048);
+    CHECK(report.packages()[0].run == "TGZ");
+    CHECK(report.packages()[0].seconds == Catch::Approx(2.5));
+    CHECK(report.packages()[1].bytes == 0);
+
+    auto summary = report.summary();
+    REQUIRE(summary.size() == 3);
+    CHECK(summary[0] == "📦 2 packages, 2.0 KiB");
+    CHECK(summary[1].contains("app-1.0-Linux.tar.zst"));
+    CHECK(summary[1].contains("2.5s"));
+}
+
+} // namespace vb::maker
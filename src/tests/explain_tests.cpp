@@ -0,0 +1,44 @@
+#include "explain.hpp"
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_range_equals.hpp>
+
+#include <format>
+#include <string>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("explain_summary", "[explain]")
+{
+    auto explanation = rebuild_explanation{};
+
+    CHECK_FALSE(explanation.add("[1/3] Building CXX object a.o"));
+    for (auto object : { "a.o"sv, "b.o"sv, "c.o"sv }) {
+        CHECK(explanation.add(std::format("ninja explain: output {} older than most recent input ../src/x.hpp (1 vs 2)", object)));
+        CHECK(explanation.add(std::format("ninja explain: {} is dirty", object)));
+    }
+    explanation.add("ninja explain: recorded mtime of d.o older than most recent input ../src/d.cpp (1 vs 2)");
+    explanation.add("ninja explain: command line changed for e.o");
+    explanation.add("ninja explain: command line changed for f.o");
+    explanation.add("ninja explain: output build.ninja older than most recent input ../CMakeLists.txt (1 vs 2)");
+
+    CHECK_THAT(
+        explanation.summary(),
+        Catch::Matchers::RangeEquals(std::vector{
+            "🔎 build.ninja regenerated because ../CMakeLists.txt changed"s,
+            "🔎 header ../src/x.hpp newer than 3 outputs"s,
+            "🔎 command line changed for 2 edges"s,
+            "🔎 input ../src/d.cpp newer than 1 outputs"s,
+        }));
+    CHECK(explanation.summary(1).size() == 1);
+}
+
+TEST_CASE("explain_nothing", "[explain]")
+{
+    CHECK_THAT(rebuild_explanation{}.summary(), Catch::Matchers::RangeEquals(std::vector{ "🔎 nothing to rebuild"s }));
+}
+
+}
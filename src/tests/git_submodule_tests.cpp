@@ -0,0 +1,84 @@
+#include "builders.hpp"
+#include "startup.hpp"
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_range_equals.hpp>
+
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace {
+
+/// Runs git with an identity and with file:// URLs allowed for submodules.
+int git(const std::filesystem::path& dir, std::string_view arguments)
+{
+    return std::system(std::format(
+                           "git -C '{}' -c user.name=vmk -c user.email=vmk@localhost -c protocol.file.allow=always {} "
+                           ">/dev/null 2>&1",
+                           dir.string(),
+                           arguments)
+                           .c_str());
+}
+
+} // namespace
+
+TEST_CASE("git_submodule_paths", "[builders][git]")
+{
+    auto paths = builders::details::submodule_paths(
+        "[submodule \"a\"]\n\tpath = deps/a\n\turl = https://example.com/a.git\n"
+        "[submodule \"b\"]\n    path=b \n    url = ../b\n");
+    CHECK_THAT(paths, Catch::Matchers::RangeEquals(std::vector{ "deps/a"s, "b"s }));
+}
+
+TEST_CASE("git_submodule_update", "[builders][git]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-submodule-{}", ::getpid());
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "library");
+    std::filesystem::create_directories(dir / "project");
+
+    REQUIRE(git(dir / "library", "init -q") == 0);
+    std::ofstream{ dir / "library" / "library.hpp" } << "#pragma once\n";
+    REQUIRE(git(dir / "library", "add library.hpp") == 0);
+    REQUIRE(git(dir / "library", "commit -q -m library") == 0);
+
+    REQUIRE(git(dir / "project", "init -q") == 0);
+    REQUIRE(git(dir / "project", std::format("submodule add -q file://{} deps/library", (dir / "library").string())) == 0);
+    REQUIRE(git(dir / "project", "commit -q -m project") == 0);
+    CHECK(builders::details::submodules_up_to_date(dir / "project"));
+
+    REQUIRE(git(dir, std::format("clone -q file://{} clone", (dir / "project").string())) == 0);
+    CHECK_FALSE(builders::details::submodules_up_to_date(dir / "clone"));
+
+    auto env = env::environment{};
+    import_default_environment(env);
+    env.set("GIT_CONFIG_COUNT")                     = "1";
+    env.set("GIT_CONFIG_KEY_0")                     = "protocol.file.allow";
+    env.set("GIT_CONFIG_VALUE_0")                   = "always";
+    env.set(builders::git_submodule::REFERENCE_VAR) = (dir / "reference").string();
+
+    auto submodules = builders::git_submodule{ work_dir{ dir / "clone" }, env };
+    REQUIRE(submodules.required());
+    CHECK(static_cast<bool>(submodules.run(builder_base::targets_type{}, argument_container{})));
+    CHECK_FALSE(submodules.required());
+    CHECK(std::filesystem::is_regular_file(dir / "clone" / "deps" / "library" / "library.hpp"));
+    CHECK(std::filesystem::is_directory(dir / "reference" / "refs" / "vmk"));
+
+    // The objects borrowed from the reference were copied, nothing points into it anymore.
+    auto module_objects = dir / "clone" / ".git" / "modules" / "deps" / "library" / "objects";
+    CHECK_FALSE(std::filesystem::exists(module_objects / "info" / "alternates"));
+
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace vb::maker
@@ -0,0 +1,94 @@
+#include "history.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace {
+
+history_record measured(std::string_view name, double duration, std::uint64_t configuration = 1)
+{
+    auto result          = history_record{};
+    result.configuration = configuration;
+    result.duration      = duration;
+    result.succeeded     = 1;
+    result.set_name(name);
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("history_records", "[history]")
+{
+    auto file = std::filesystem::temp_directory_path() / std::format("vmk-history-{}", ::getpid()) / history::FILE;
+    std::filesystem::remove_all(file.parent_path());
+
+    SECTION("appended records are read back")
+    {
+        history{ file }.append(std::vector{ measured("build/ninja", 10.0), measured("test/ctest", 2.0) });
+        history{ file }.append(std::vector{ measured("build/ninja", 11.0) });
+
+        auto past = history{ file };
+        REQUIRE(past.records().size() == 3);
+        CHECK(past.records()[2].get_name() == "build/ninja");
+        CHECK(past.baseline(measured("build/ninja", 0.0)).size() == 2);
+        CHECK(past.baseline(measured("build/ninja", 0.0, 2)).empty());
+    }
+
+    SECTION("runs creating the file at the same time write a single header")
+    {
+        {
+            auto runs = std::vector<std::jthread>{};
+            for (auto run = 0; run < 8; ++run) {
+                runs.emplace_back([&] { history{ file }.append(std::vector{ measured("build/ninja", 1.0) }); });
+            }
+        }
+        CHECK(history{ file }.records().size() == 8);
+    }
+
+    SECTION("long names keep their end")
+    {
+        auto record = measured(std::string(200, 'x') + "/main.cpp.o", 1.0);
+        CHECK(record.get_name().size() == history_record::NAME_SIZE);
+        CHECK(record.get_name().ends_with("/main.cpp.o"));
+    }
+
+    SECTION("a file that is not a history is ignored")
+    {
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream{ file } << std::string(512, 'x');
+        CHECK(history{ file }.records().empty());
+    }
+
+    SECTION("a history of another format is started over")
+    {
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream{ file } << "VMKHIST1" << std::string(8 + 2 * 128, '\0');
+        history{ file }.append(std::vector{ measured("build/ninja", 1.0) });
+        REQUIRE(history{ file }.records().size() == 1);
+        CHECK(history{ file }.records()[0].get_name() == "build/ninja");
+    }
+
+    std::filesystem::remove_all(file.parent_path());
+}
+
+TEST_CASE("history_regressions", "[history]")
+{
+    auto samples = std::vector<history_record>{};
+    for (auto duration : { 10.0, 10.2, 9.9, 10.1, 10.0, 9.8 }) {
+        samples.push_back(measured("build/ninja", duration));
+    }
+
+    CHECK(regression::is_slower(measured("build/ninja", 12.5), samples));
+    CHECK_FALSE(regression::is_slower(measured("build/ninja", 10.3), samples));
+    CHECK_FALSE(regression::is_slower(measured("build/ninja", 12.5), std::span{ samples }.first(3)));
+}
+
+}
@@ -0,0 +1,85 @@
+#include "hotspots.hpp"
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_range_equals.hpp>
+
+#include <string>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace {
+
+header_hotspots sample_hotspots()
+{
+    auto hotspots = header_hotspots{ "/src/project", "/src/project/build" };
+    hotspots.add_log_entry("0\t4000\t1\ta.o\tabc");
+    hotspots.add_log_entry("0\t9000\t1\tb.o\tdef");
+    hotspots.add_log_entry("0\t1000\t1\tb.o\tdef");
+    hotspots.add_log_entry("0\t2000\t1\tc.o\tghi");
+
+    for (auto line : {
+             "a.o: #deps 4, deps mtime 1 (VALID)"sv,
+             "    ../src/a.cpp"sv,
+             "    ../src/common.hpp"sv,
+             "    /usr/include/c++/14/vector"sv,
+             "    /usr/include/c++/14/bits/stl_vector.h"sv,
+             ""sv,
+             "b.o: #deps 3, deps mtime 1 (VALID)"sv,
+             "    ../src/b.cpp"sv,
+             "    ../src/common.hpp"sv,
+             "    /usr/include/c++/14/vector"sv,
+             "    /usr/include/c++/14/bits/stl_vector.h"sv,
+             ""sv,
+             "c.o: #deps 4, deps mtime 1 (VALID)"sv,
+             "    ../src/c.cpp"sv,
+             "    ../src/common.hpp"sv,
+             "    ../src/c.hpp"sv,
+             "    /opt/conan/p/fmt/include/fmt/format.h"sv,
+             ""sv,
+         }) {
+        hotspots.add_deps_line(line);
+    }
+    return hotspots;
+}
+
+} // namespace
+
+TEST_CASE("hotspots_ranking", "[hotspots]")
+{
+    auto hotspots = sample_hotspots();
+    CHECK(hotspots.units() == 3);
+
+    auto by_cost = hotspots.by_rebuild_cost(2);
+    REQUIRE(by_cost.size() == 2);
+    CHECK(by_cost[0].path == "/src/project/src/common.hpp");
+    CHECK(by_cost[0].includers == 3);
+    CHECK(by_cost[0].rebuild_seconds == Catch::Approx(7.0));
+
+    auto by_inclusions = hotspots.by_inclusions(10);
+    REQUIRE(by_inclusions.size() == 5);
+    CHECK(by_inclusions.front().includers == 3);
+    CHECK(by_inclusions.back().includers == 1);
+}
+
+TEST_CASE("hotspots_pch_candidates", "[hotspots]")
+{
+    auto hotspots = sample_hotspots();
+
+    // Project and implementation headers are not candidates, fmt is included by too few units.
+    CHECK_THAT(hotspots.pch_candidates(), Catch::Matchers::RangeEquals(std::vector{ "<vector>"s }));
+    CHECK(hotspots.pch_cmake().contains("set(VMK_PCH_CANDIDATES\n    \"<vector>\"\n)\n"));
+}
+
+TEST_CASE("hotspots_without_deps", "[hotspots]")
+{
+    auto hotspots = header_hotspots{ "/src/project", "/src/project/build" };
+    CHECK(hotspots.pch_candidates().empty());
+    CHECK_THAT(
+        hotspots.summary(),
+        Catch::Matchers::RangeEquals(std::vector{ "🔥 ninja recorded no header dependencies, build first"s }));
+}
+
+} // namespace vb::maker
@@ -0,0 +1,65 @@
+#include "install_tree.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("install_tree_sync", "[install_tree]")
+{
+    auto dir         = std::filesystem::temp_directory_path() / std::format("vmk-install-{}", ::getpid());
+    auto staging     = dir / "staging";
+    auto destination = dir / "destination";
+    std::filesystem::create_directories(staging / "usr/lib");
+    std::ofstream{ staging / "usr/lib/libsdk.so.1" } << "library";
+    std::filesystem::create_symlink("libsdk.so.1", staging / "usr/lib/libsdk.so");
+
+    auto first = install_tree::sync(staging, destination);
+    CHECK(first.errors.empty());
+    CHECK(first.unchanged == 0);
+    CHECK(first.cloned + first.copied == 2);
+    CHECK(std::filesystem::read_symlink(destination / "usr/lib/libsdk.so") == "libsdk.so.1");
+    CHECK(install_tree::unchanged(staging / "usr/lib/libsdk.so.1", destination / "usr/lib/libsdk.so.1"));
+
+    auto second = install_tree::sync(staging, destination);
+    CHECK(second.unchanged == 2);
+    CHECK(second.cloned + second.copied == 0);
+
+    // The install tools write a new file when it changed.
+    std::filesystem::remove(staging / "usr/lib/libsdk.so.1");
+    std::ofstream{ staging / "usr/lib/libsdk.so.1" } << "library, version 2";
+    auto third = install_tree::sync(staging, destination);
+    CHECK(third.unchanged == 1);
+    CHECK(third.bytes == "library, version 2"sv.size());
+    CHECK(read_file(destination / "usr/lib/libsdk.so.1") == "library, version 2");
+
+    // The installed files never share their inode with the staged ones, which the next install or strip rewrites.
+    CHECK(std::filesystem::hard_link_count(destination / "usr/lib/libsdk.so.1") == 1);
+    std::ofstream{ staging / "usr/lib/libsdk.so.1", std::ios::app } << ", patched";
+    CHECK(read_file(destination / "usr/lib/libsdk.so.1") == "library, version 2");
+    CHECK(!std::filesystem::exists(destination / std::format("usr/lib/libsdk.so.1.{}.tmp", ::getpid())));
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("install_tree_modes", "[install_tree]")
+{
+    CHECK(install_tree::mode_of("strip") == install_tree::strip_mode::strip);
+    CHECK(install_tree::mode_of("split") == install_tree::strip_mode::split);
+    CHECK(install_tree::mode_of("") == install_tree::strip_mode::none);
+
+    auto errors = std::vector<std::string>{};
+    CHECK(install_tree::strip(std::filesystem::temp_directory_path() / "vmk-no-such-tree", install_tree::strip_mode::strip, errors) == 0);
+    CHECK(errors.empty());
+}
+
+} // namespace vb::maker
@@ -0,0 +1,119 @@
+#include "journal.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace {
+
+struct fake_builder : builder_base
+{
+    task_type             my_task;
+    std::filesystem::path my_input;
+    env::environment      my_env{};
+
+    fake_builder(task_type task, std::filesystem::path input)
+        : my_task{ task }
+        , my_input{ std::move(input) }
+    {
+    }
+
+private:
+
+    execution_result execute_step(std::string, arguments_type) const override
+    {
+        return execution_result{ execution_result::SUCCESS };
+    }
+
+    std::string get_name() const override
+    {
+        return "fake";
+    }
+
+    work_dir get_root() const override
+    {
+        return work_dir{ my_input.parent_path() };
+    }
+
+    bool get_required() const override
+    {
+        return true;
+    }
+
+    Stage get_stage() const override
+    {
+        return Stage{ my_task };
+    }
+
+    std::string get_command(targets_type) const override
+    {
+        return "fake";
+    }
+
+    arguments_type get_arguments(targets_type targets) const override
+    {
+        return std::ranges::to<arguments_type>(targets);
+    }
+
+    const env::environment& get_environment(targets_type) const override
+    {
+        return my_env;
+    }
+
+    std::vector<fs::path> get_inputs() const override
+    {
+        return { my_input };
+    }
+};
+
+} // namespace
+
+TEST_CASE("journal_resume", "[journal]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-journal-{}", ::getpid());
+    std::filesystem::create_directories(dir);
+    auto input = dir / "conanfile.txt";
+    std::ofstream{ input } << "[requires]\n";
+
+    auto configure = fake_builder{ task_type::configuration, input };
+    auto no_args   = std::vector<std::string_view>{};
+    auto all       = std::vector{ "all"sv };
+
+    SECTION("a successful stage is done while nothing changes")
+    {
+        journal{ dir }.record(configure, all, no_args, true);
+        CHECK(journal{ dir }.is_done(configure, all, no_args));
+        CHECK_FALSE(journal{ dir }.is_done(configure, std::vector{ "other"sv }, no_args));
+        CHECK_FALSE(journal{ dir }.is_done(configure, all, std::vector{ "-DX=1"sv }));
+    }
+
+    SECTION("changed inputs make the stage run again")
+    {
+        journal{ dir }.record(configure, all, no_args, true);
+        std::ofstream{ input, std::ios::app } << "fmt/10.0.0\n";
+        CHECK_FALSE(journal{ dir }.is_done(configure, all, no_args));
+    }
+
+    SECTION("failed stages run again")
+    {
+        journal{ dir }.record(configure, all, no_args, false);
+        CHECK_FALSE(journal{ dir }.is_done(configure, all, no_args));
+    }
+
+    SECTION("builds and tests always run")
+    {
+        auto test = fake_builder{ task_type::test, input };
+        journal{ dir }.record(test, all, no_args, true);
+        CHECK_FALSE(journal{ dir }.is_done(test, all, no_args));
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+}
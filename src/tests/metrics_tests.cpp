@@ -0,0 +1,45 @@
+#include "metrics.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <string>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("metrics_text_format", "[metrics]")
+{
+    auto metrics = metrics_file{ "metrics.prom", "/src/my \"project\"" };
+    metrics.add({ "ninja", "build", { { std::string{ metric::DURATION }, 1.5 }, { std::string{ metric::NINJA_EDGES }, 3 } } });
+    metrics.add({ "ctest", "test", { { std::string{ metric::DURATION }, 2 }, { std::string{ metric::TESTS }, 4 } } });
+
+    auto text = metrics.render();
+
+    SECTION("samples of a family are grouped under one header")
+    {
+        CHECK(text.find("# TYPE vmk_stage_duration_seconds gauge\n") == 0);
+        CHECK(text.find("vmk_stage_duration_seconds{builder=\"ninja\"") < text.find("vmk_stage_duration_seconds{builder=\"ctest\""));
+        CHECK(text.find("vmk_ninja_edges") > text.find("vmk_stage_duration_seconds{builder=\"ctest\""));
+    }
+
+    SECTION("counters have the _total suffix, in the header too")
+    {
+        CHECK(text.contains("# TYPE vmk_ninja_edges_total counter\n"));
+        CHECK(text.contains("vmk_ninja_edges_total{builder=\"ninja\",stage=\"build\",root=\"/src/my \\\"project\\\"\"} 3\n"));
+    }
+
+    SECTION("families without samples are left out")
+    {
+        CHECK_FALSE(text.contains("vmk_tests_failed"));
+        CHECK_FALSE(text.contains("# EOF"));
+    }
+}
+
+TEST_CASE("metrics_ccache_ratio", "[metrics]")
+{
+    CHECK(ccache_statistics::hit_ratio({ 10, 10 }, { 13, 11 }) == 0.75);
+    CHECK_FALSE(ccache_statistics::hit_ratio({ 10, 10 }, { 10, 10 }).has_value());
+}
+
+}
@@ -0,0 +1,247 @@
+#include "output_cache.hpp"
+#include "worktree.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace {
+
+struct temporary_directory
+{
+    std::filesystem::path path;
+
+    explicit temporary_directory(std::string_view name)
+        : path{ std::filesystem::temp_directory_path() / std::format("vmk-{}-{}", name, ::getpid()) }
+    {
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+    }
+
+    ~temporary_directory()
+    {
+        auto error = std::error_code{};
+        std::filesystem::remove_all(path, error);
+    }
+};
+
+void write(const std::filesystem::path& file, std::string_view content)
+{
+    std::filesystem::create_directories(file.parent_path());
+    std::ofstream{ file } << content;
+}
+
+} // namespace
+
+TEST_CASE("local_output_cache", "[cache][output]")
+{
+    auto cache_dir = temporary_directory{ "cache" };
+    auto build_dir = temporary_directory{ "build" };
+
+    write(build_dir.path / "main.o", "object");
+    write(build_dir.path / "lib/libfoo.so", "library");
+    write(build_dir.path / ".vmk/journal", "private");
+
+    auto cache = local_cache_backend{ cache_dir.path };
+    REQUIRE_FALSE(cache.contains("key"));
+    REQUIRE(cache.store("key", build_dir.path));
+    REQUIRE(cache.contains("key"));
+    CHECK_FALSE(std::filesystem::exists(cache_dir.path / "key/.vmk"));
+
+    // Tools replace their outputs, they do not rewrite them in place.
+    std::filesystem::remove(build_dir.path / "main.o");
+    std::filesystem::remove(build_dir.path / "lib/libfoo.so");
+    write(build_dir.path / "lib/libfoo.so", "other branch");
+
+    REQUIRE(restore_outputs(cache, "key", build_dir.path));
+    CHECK(read_file(build_dir.path / "main.o") == "object");
+    CHECK(read_file(build_dir.path / "lib/libfoo.so") == "library");
+    CHECK(output_cache_marker::current(build_dir.path) == "key");
+
+    SECTION("already restored")
+    {
+        CHECK_FALSE(restore_outputs(cache, "key", build_dir.path));
+    }
+}
+
+TEST_CASE("local_output_cache_modified_entry", "[cache][output]")
+{
+    auto cache_dir = temporary_directory{ "cache-modified" };
+    auto build_dir = temporary_directory{ "build-modified" };
+    write(build_dir.path / "main.o", "object");
+
+    auto cache = local_cache_backend{ cache_dir.path };
+    REQUIRE(cache.store("key", build_dir.path));
+
+    // Rewriting in place changes the stored copy when it is a hard link, the entry must then be dropped.
+    std::filesystem::last_write_time(
+        build_dir.path / "main.o", std::filesystem::file_time_type::clock::now() + std::chrono::seconds{ 10 });
+    if (std::filesystem::hard_link_count(build_dir.path / "main.o") > 1) {
+        CHECK_FALSE(cache.restore("key", build_dir.path));
+        CHECK_FALSE(cache.contains("key"));
+    } else {
+        CHECK(cache.restore("key", build_dir.path));
+    }
+}
+
+TEST_CASE("local_output_cache_reports", "[cache][output]")
+{
+    auto cache_dir = temporary_directory{ "cache-reports" };
+    auto build_dir = temporary_directory{ "build-reports" };
+    write(build_dir.path / "main.o", "object");
+
+    auto reported = std::vector<std::string>{};
+    auto cache    = local_cache_backend{ cache_dir.path };
+    cache.report_to([&](std::string_view message) { reported.emplace_back(message); });
+    REQUIRE(cache.store("key", build_dir.path));
+    CHECK(reported.empty());
+
+    write(cache_dir.path / "key" / "main.o", "changed object");
+    CHECK_FALSE(cache.restore("key", build_dir.path));
+    REQUIRE(reported.size() == 1);
+    CHECK(reported.front().contains("cache entry key was modified"));
+}
+
+TEST_CASE("local_output_cache_eviction", "[cache][output]")
+{
+    auto cache_dir = temporary_directory{ "cache-evict" };
+    auto build_dir = temporary_directory{ "build-evict" };
+    write(build_dir.path / "main.o", "object");
+
+    auto cache = local_cache_backend{ cache_dir.path, 2 };
+    for (auto key : { "a"sv, "b"sv, "c"sv }) {
+        REQUIRE(cache.store(key, build_dir.path));
+        std::filesystem::last_write_time(
+            cache_dir.path / key / local_cache_backend::MANIFEST,
+            std::filesystem::file_time_type::clock::now() - std::chrono::seconds{ 10 - (key.front() - 'a') });
+    }
+    REQUIRE(cache.store("d", build_dir.path));
+
+    CHECK_FALSE(cache.contains("a"));
+    CHECK(cache.contains("d"));
+}
+
+TEST_CASE("local_output_cache_symlinks", "[cache][output]")
+{
+    auto cache_dir = temporary_directory{ "cache-links" };
+    auto project   = temporary_directory{ "project-links" };
+    auto build_dir = project.path / "build";
+    write(build_dir / "lib/libfoo.so.1", "library");
+    std::filesystem::create_symlink("libfoo.so.1", build_dir / "lib/libfoo.so");
+    write(project.path / "src/data/input.txt", "source");
+    std::filesystem::create_symlink("../src/data", build_dir / "data");
+    auto source_time = std::filesystem::last_write_time(project.path / "src/data");
+
+    auto cache = local_cache_backend{ cache_dir.path };
+    REQUIRE(cache.store("key", build_dir));
+    CHECK(std::filesystem::read_symlink(cache_dir.path / "key/lib/libfoo.so") == "libfoo.so.1");
+    CHECK(read_file(cache_dir.path / "key/lib/libfoo.so.1") == "library");
+    CHECK(std::filesystem::read_symlink(cache_dir.path / "key/data") == "../src/data");
+
+    output_cache_marker::set(build_dir, "other");
+    REQUIRE(restore_outputs(cache, "key", build_dir));
+    CHECK(std::filesystem::read_symlink(build_dir / "lib/libfoo.so") == "libfoo.so.1");
+    CHECK(read_file(build_dir / "lib/libfoo.so.1") == "library");
+    CHECK(std::filesystem::read_symlink(build_dir / "data") == "../src/data");
+
+    // What the links point to outside of the build is left alone.
+    CHECK(read_file(project.path / "src/data/input.txt") == "source");
+    CHECK(std::filesystem::last_write_time(project.path / "src/data") == source_time);
+}
+
+TEST_CASE("output_cache_restore_removes_stale_outputs", "[cache][output]")
+{
+    auto cache_dir = temporary_directory{ "cache-stale" };
+    auto build_dir = temporary_directory{ "build-stale" };
+    write(build_dir.path / "main.o", "object");
+
+    auto cache = local_cache_backend{ cache_dir.path };
+    REQUIRE(cache.store("key", build_dir.path));
+
+    write(build_dir.path / "removed/target.o", "stale");
+    write(build_dir.path / ".vmk/journal", "private");
+    output_cache_marker::set(build_dir.path, "other");
+    REQUIRE(restore_outputs(cache, "key", build_dir.path));
+    CHECK(std::filesystem::exists(build_dir.path / "main.o"));
+    CHECK_FALSE(std::filesystem::exists(build_dir.path / "removed"));
+    CHECK(read_file(build_dir.path / ".vmk/journal") == "private");
+}
+
+TEST_CASE("ninja_state_deps_times", "[cache][output][ninja]")
+{
+    auto build_dir = temporary_directory{ "build-deps" };
+    write(build_dir.path / "main.o", "object");
+
+    auto content = std::string{ ninja_state::DEPS_SIGNATURE };
+    auto append  = [&](std::uint32_t value) {
+        content.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    append(ninja_state::DEPS_VERSION);
+    for (auto [id, path] : { std::pair{ 0U, "main.o"sv }, std::pair{ 1U, "../main.c"sv } }) {
+        auto padding = (4 - path.size() % 4) % 4;
+        append(static_cast<std::uint32_t>(path.size() + padding + 4));
+        content.append(path);
+        content.append(padding, '\0');
+        append(~id);
+    }
+    append(4 * (1 + 2 + 1) | ninja_state::DEPS_RECORD_BIT);
+    append(0);
+    append(1);
+    append(0);
+    append(1);
+    write(build_dir.path / ninja_state::DEPS_LOG, content);
+
+    REQUIRE(ninja_state::retime_deps(build_dir.path) == 1);
+    auto updated = read_file(build_dir.path / ninja_state::DEPS_LOG);
+    REQUIRE(updated.size() == content.size());
+    auto time = std::int64_t{};
+    std::memcpy(&time, updated.data() + updated.size() - 3 * sizeof(std::uint32_t), sizeof(time));
+    CHECK(time == ninja_state::mtime_of(build_dir.path / "main.o"));
+
+    write(build_dir.path / ninja_state::DEPS_LOG, "# ninjadeps\n\3\0\0\0"s);
+    CHECK(ninja_state::retime_deps(build_dir.path) == 0);
+}
+
+TEST_CASE("output_cache_restored_ninja_build_is_up_to_date", "[cache][output][ninja]")
+{
+    if (!find_program("ninja"sv).has_value()) {
+        SKIP("ninja is not installed");
+    }
+
+    auto root      = temporary_directory{ "ninja-root" };
+    auto cache_dir = temporary_directory{ "ninja-cache" };
+    auto build_dir = root.path / "build";
+    write(root.path / "input.txt", "content");
+    write(build_dir / "build.ninja", R"(rule copy
+  command = cp $in $out && echo "$out: $in" > $out.d
+  depfile = $out.d
+  deps = gcc
+build output.txt: copy ../input.txt
+)");
+
+    REQUIRE(details::tool_output("ninja"sv, "-C"sv, build_dir.string()).has_value());
+    auto cache = local_cache_backend{ cache_dir.path };
+    REQUIRE(cache.store("key", build_dir));
+
+    // A fresh checkout: no build directory, and sources newer than the outputs that were stored.
+    std::filesystem::remove_all(build_dir);
+    std::filesystem::create_directories(build_dir);
+    std::filesystem::last_write_time(root.path / "input.txt", std::filesystem::file_time_type::clock::now());
+    REQUIRE(restore_outputs(cache, "key", build_dir));
+
+    auto dry_run = details::tool_output("ninja"sv, "-C"sv, build_dir.string(), "-n"sv);
+    REQUIRE(dry_run.has_value());
+    CHECK(std::ranges::any_of(*dry_run, [](const auto& line) { return line.contains("no work to do"sv); }));
+}
+
+}
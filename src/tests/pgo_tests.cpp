@@ -0,0 +1,46 @@
+#include "builders.hpp"
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_range_equals.hpp>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("pgo_clang_flags", "[builders][pgo]")
+{
+    auto profiles = std::filesystem::path{ "/src/build-pgo-generate/.vmk/pgo-profiles" };
+
+    CHECK_THAT(
+        builders::pgo::generate_flags(true, profiles, "/src/build-pgo-generate"),
+        Catch::Matchers::RangeEquals(std::vector{ "-fprofile-instr-generate"s }));
+    CHECK_THAT(
+        builders::pgo::use_flags(true, profiles, "/src/build-pgo"),
+        Catch::Matchers::RangeEquals(std::vector{ "-fprofile-instr-use=/src/build-pgo-generate/.vmk/pgo.profdata"s,
+                                                  "-Wno-profile-instr-unprofiled"s,
+                                                  "-Wno-profile-instr-out-of-date"s }));
+}
+
+TEST_CASE("pgo_gcc_flags", "[builders][pgo]")
+{
+    auto profiles = std::filesystem::path{ "/src/build-pgo-generate/.vmk/pgo-profiles" };
+
+    // Both builds strip their own directory, so the objects find the same .gcda.
+    CHECK_THAT(
+        builders::pgo::generate_flags(false, profiles, "/src/build-pgo-generate"),
+        Catch::Matchers::RangeEquals(std::vector{ "-fprofile-generate=/src/build-pgo-generate/.vmk/pgo-profiles"s,
+                                                  "-fprofile-update=atomic"s,
+                                                  "-fprofile-prefix-path=/src/build-pgo-generate"s }));
+    CHECK_THAT(
+        builders::pgo::use_flags(false, profiles, "/src/build-pgo"),
+        Catch::Matchers::RangeEquals(std::vector{ "-fprofile-use=/src/build-pgo-generate/.vmk/pgo-profiles"s,
+                                                  "-fprofile-partial-training"s,
+                                                  "-fprofile-prefix-path=/src/build-pgo"s,
+                                                  "-Wno-missing-profile"s }));
+}
+
+} // namespace vb::maker
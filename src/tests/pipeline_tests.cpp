@@ -0,0 +1,84 @@
+#include "pipeline.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("pipeline_run_async", "[pipeline]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-pipeline-{}", ::getpid());
+    std::filesystem::create_directories(dir);
+    std::ofstream{ dir / "Makefile" } << "all:\n\t@echo hello\n";
+
+    auto found = pipeline::detect(dir);
+    REQUIRE(found.has_value());
+
+    auto plan = found->plan();
+    REQUIRE(plan.size() == 1);
+    CHECK(plan.front().builder == "make");
+    CHECK(plan.front().stage.type() == task_type::build);
+
+    auto events = std::vector<stage_event::kind>{};
+    auto output = std::vector<std::string>{};
+    auto callbacks = pipeline_callbacks{
+        .on_stage  = [&](const stage_event& event) { events.push_back(event.what); },
+        .on_output = [&](std::string_view line, std_io) { output.emplace_back(line); },
+    };
+
+    auto result = found->run_async({}, callbacks).get();
+    CHECK(static_cast<bool>(result));
+    CHECK(events == std::vector{ stage_event::started, stage_event::finished });
+    CHECK(output == std::vector{ "hello"s });
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("pipeline_output_and_errors", "[pipeline]")
+{
+    // More errors than a pipe holds before the output, the tool only finishes if both are read at once.
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-pipeline-errors-{}", ::getpid());
+    std::filesystem::create_directories(dir);
+    std::ofstream{ dir / "Makefile" } << "all:\n\t@for i in $$(seq 20000); do echo warning $$i >&2; done; echo done\n";
+
+    auto found = pipeline::detect(dir);
+    REQUIRE(found.has_value());
+
+    auto output    = std::vector<std::string>{};
+    auto errors    = std::size_t{ 0 };
+    auto callbacks = pipeline_callbacks{
+        .on_output = [&](std::string_view line, std_io stream) {
+            if (stream == std_io::ERR) {
+                ++errors;
+            } else {
+                output.emplace_back(line);
+            }
+        },
+    };
+
+    auto result = found->run_async({}, callbacks).get();
+    CHECK(static_cast<bool>(result));
+    CHECK(output == std::vector{ "done"s });
+    CHECK(errors == 20000);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("pipeline_nothing_detected", "[pipeline]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-pipeline-empty-{}", ::getpid());
+    std::filesystem::create_directories(dir);
+    CHECK_FALSE(pipeline::detect(dir).has_value());
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace vb::maker
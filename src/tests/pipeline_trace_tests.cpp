@@ -0,0 +1,56 @@
+#include "pipeline_trace.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <chrono>
+#include <filesystem>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("pipeline_trace_stages", "[pipeline_trace]")
+{
+    auto start = pipeline_trace::clock::now();
+    auto trace = pipeline_trace{ "trace.json", start };
+    trace.add_stage("cmake", "configuration", start + 2ms, 1.5, true);
+
+    auto events = trace.json()["traceEvents"];
+    REQUIRE(events.size() == 1);
+    CHECK(events[0]["name"] == "configuration → cmake");
+    CHECK(events[0]["ph"] == "X");
+    CHECK(events[0]["ts"].get<double>() == Catch::Approx(2000.0));
+    CHECK(events[0]["dur"].get<double>() == Catch::Approx(1500000.0));
+    CHECK(events[0]["args"]["succeeded"] == true);
+}
+
+TEST_CASE("pipeline_trace_tool_traces", "[pipeline_trace]")
+{
+    auto start = pipeline_trace::clock::now();
+    auto trace = pipeline_trace{ "trace.json", start };
+    trace.add_tool_trace(nlohmann::json::parse(R"([
+        { "ph": "X", "name": "find_package", "ts": 900000000, "dur": 10, "pid": 42, "tid": 42 },
+        { "ph": "X", "name": "include", "ts": 900000500, "dur": 10, "pid": 42, "tid": 42 }
+    ])"), start + 1s);
+
+    auto events = trace.json()["traceEvents"];
+    REQUIRE(events.size() == 2);
+    CHECK(events[0]["ts"].get<double>() == Catch::Approx(1000000.0));
+    CHECK(events[1]["ts"].get<double>() == Catch::Approx(1000500.0));
+    CHECK(events[0]["pid"] == pipeline_trace::PROCESS);
+    CHECK(events[0]["tid"] != pipeline_trace::STAGE_TID);
+}
+
+TEST_CASE("pipeline_trace_write", "[pipeline_trace]")
+{
+    auto path  = std::filesystem::temp_directory_path() / "vmk_pipeline_trace_test.json";
+    auto trace = pipeline_trace{ path };
+    trace.add_stage("ninja", "build", pipeline_trace::clock::now(), 0.1, false);
+    trace.write();
+
+    auto written = nlohmann::json::parse(read_file(path));
+    CHECK(written["traceEvents"].size() == 1);
+    std::filesystem::remove(path);
+}
+
+} // namespace vb::maker
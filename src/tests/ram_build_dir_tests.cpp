@@ -0,0 +1,117 @@
+#include "ram_build_dir.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+#include <unistd.h>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("ram_build_dir_persist", "[ram_build_dir]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-ram-{}", ::getpid());
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "project" / "build" / "objects");
+    std::filesystem::create_directories(dir / "memory");
+    ::setenv("XDG_STATE_HOME", (dir / "state").c_str(), 1);
+
+    auto object = dir / "project" / "build" / "objects" / "a.o";
+    std::ofstream{ object } << "object";
+    auto built = std::filesystem::last_write_time(object) - std::chrono::hours{ 1 };
+    std::filesystem::last_write_time(object, built);
+
+    {
+        auto in_memory = ram_build_dir{ dir / "project", dir / "project" / "build", true, { dir / "memory" } };
+        REQUIRE_FALSE(in_memory.prepare().has_value());
+        REQUIRE(in_memory.location().has_value());
+        CHECK(in_memory.location()->string().starts_with((dir / "memory" / std::format("vmk-{}", ::getuid())).string()));
+        CHECK((std::filesystem::status(dir / "memory" / std::format("vmk-{}", ::getuid())).permissions() &
+               std::filesystem::perms::all) == std::filesystem::perms::owner_all);
+        CHECK(std::filesystem::is_symlink(dir / "project" / "build"));
+        CHECK(std::filesystem::last_write_time(object) == built);
+
+        std::ofstream{ dir / "project" / "build" / "b.o" } << "object";
+        std::filesystem::remove(object);
+    }
+
+    CHECK(std::filesystem::is_regular_file(dir / "project" / "build.disk" / "b.o"));
+    CHECK_FALSE(std::filesystem::exists(dir / "project" / "build.disk" / "objects" / "a.o"));
+
+    // The memory is empty after a reboot, the copy on disk comes back.
+    std::filesystem::remove_all(dir / "memory");
+    std::filesystem::create_directories(dir / "memory");
+    {
+        auto in_memory = ram_build_dir{ dir / "project", dir / "project" / "build", true, { dir / "memory" } };
+        REQUIRE_FALSE(in_memory.prepare().has_value());
+        CHECK(std::filesystem::is_regular_file(dir / "project" / "build" / "b.o"));
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("ram_build_dir_after_reboot", "[ram_build_dir]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-ram-reboot-{}", ::getpid());
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "project" / "build");
+    std::filesystem::create_directories(dir / "memory");
+    ::setenv("XDG_STATE_HOME", (dir / "state").c_str(), 1);
+
+    {
+        auto in_memory = ram_build_dir{ dir / "project", dir / "project" / "build", false, { dir / "memory" } };
+        REQUIRE_FALSE(in_memory.prepare().has_value());
+    }
+
+    // Nothing was kept, the link left in the project points nowhere and the build starts over in memory.
+    std::filesystem::remove_all(dir / "memory");
+    std::filesystem::create_directories(dir / "memory");
+    REQUIRE(std::filesystem::is_symlink(dir / "project" / "build"));
+    REQUIRE_FALSE(std::filesystem::exists(dir / "project" / "build"));
+    {
+        auto in_memory = ram_build_dir{ dir / "project", dir / "project" / "build", false, { dir / "memory" } };
+        REQUIRE_FALSE(in_memory.prepare().has_value());
+        CHECK(std::filesystem::is_directory(dir / "project" / "build"));
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("ram_build_dir_shared_memory", "[ram_build_dir]")
+{
+    // A directory anyone can write to may have been created by someone else, the build stays on disk.
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-ram-shared-{}", ::getpid());
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "project" / "build");
+    std::filesystem::create_directories(dir / "memory" / std::format("vmk-{}", ::getuid()));
+    std::filesystem::permissions(dir / "memory" / std::format("vmk-{}", ::getuid()), std::filesystem::perms::all);
+    ::setenv("XDG_STATE_HOME", (dir / "state").c_str(), 1);
+
+    auto in_memory = ram_build_dir{ dir / "project", dir / "project" / "build", false, { dir / "memory" } };
+    CHECK(in_memory.prepare().has_value());
+    CHECK_FALSE(std::filesystem::is_symlink(dir / "project" / "build"));
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("ram_build_dir_no_room", "[ram_build_dir]")
+{
+    auto dir = std::filesystem::temp_directory_path() / std::format("vmk-ram-full-{}", ::getpid());
+    std::filesystem::create_directories(dir / "project" / "build");
+    ::setenv("XDG_STATE_HOME", (dir / "state").c_str(), 1);
+
+    auto in_memory = ram_build_dir{ dir / "project", dir / "project" / "build", false, { dir / "missing" } };
+    CHECK(in_memory.prepare().has_value());
+    CHECK_FALSE(in_memory.location().has_value());
+    CHECK_FALSE(std::filesystem::is_symlink(dir / "project" / "build"));
+
+    std::filesystem::remove_all(dir);
+}
+
+} // namespace vb::maker
@@ -0,0 +1,79 @@
+#include "builders/gradle.hpp"
+#include "html_table.hpp"
+
+#include <catch2/catch_all.hpp>
+#include <catch2/matchers/catch_matchers_range_equals.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string_view>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+TEST_CASE("html_table_rows", "[report][html]")
+{
+    static constexpr auto html = R"(<html><body>
+<table class="my-table summary-table">
+  <tr><td>Profile:</td><td>dev</td></tr>
+  <tr>
+    <td>Total units:</td>
+    <td><b>12</b></td>
+  </tr>
+  <tr><th>Total time:</th><td>3.4s</td></tr>
+</table></body></html>)"sv;
+
+    auto rows = html_table_rows(html);
+    REQUIRE(rows.size() == 3);
+    CHECK_THAT(rows[0], Catch::Matchers::RangeEquals(std::vector{ "Profile:"s, "dev"s }));
+    CHECK_THAT(rows[1], Catch::Matchers::RangeEquals(std::vector{ "Total units:"s, "12"s }));
+    CHECK_THAT(rows[2], Catch::Matchers::RangeEquals(std::vector{ "Total time:"s, "3.4s"s }));
+}
+
+TEST_CASE("html_table_rows_empty", "[report][html]")
+{
+    CHECK(html_table_rows("<p>no table</p>"sv).empty());
+}
+
+TEST_CASE("gradle_profile_summary", "[report][gradle]")
+{
+    static constexpr auto html = R"(<div id="tab0"><table>
+<tr><th>Description</th><th class="numeric">Duration</th></tr>
+<tr><td>Total Build Time</td><td class="numeric">41.512s</td></tr>
+<tr><td>Startup</td><td class="numeric">0.312s</td></tr>
+<tr><td>Configuring Projects</td><td class="numeric">38.020s</td></tr>
+<tr><td>Task Execution</td><td class="numeric">3.101s</td></tr>
+</table></div>)"sv;
+
+    auto summary = builders::details::gradle_profile_summary(html_table_rows(html));
+    REQUIRE(summary.size() == 4);
+    CHECK(summary[0] == std::pair{ "Total Build Time"s, "41.512s"s });
+    CHECK(summary[2] == std::pair{ "Configuring Projects"s, "38.020s"s });
+    CHECK(summary[3] == std::pair{ "Task Execution"s, "3.101s"s });
+}
+
+TEST_CASE("gradle_profile_pruning", "[report][gradle]")
+{
+    auto dir = std::filesystem::temp_directory_path() / "vmk_gradle_profiles";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir / "css");
+    auto now = std::filesystem::file_time_type::clock::now();
+    for (auto index = 0; index < 4; ++index) {
+        auto report = dir / std::format("profile-{}.html", index);
+        std::ofstream{ report } << "<html></html>";
+        std::filesystem::last_write_time(report, now - std::chrono::minutes{ 10 - index });
+    }
+
+    CHECK(builders::details::prune_gradle_profiles(dir, 2) == 2);
+    CHECK_FALSE(std::filesystem::exists(dir / "profile-0.html"));
+    CHECK_FALSE(std::filesystem::exists(dir / "profile-1.html"));
+    CHECK(std::filesystem::exists(dir / "profile-3.html"));
+    CHECK(std::filesystem::is_directory(dir / "css"));
+    CHECK(builders::details::prune_gradle_profiles(dir, 2) == 0);
+}
+
+}
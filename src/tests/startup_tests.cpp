@@ -0,0 +1,110 @@
+#include "pipeline.hpp"
+#include "startup.hpp"
+
+#include <catch2/catch_all.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+namespace {
+
+/// A cmake project with presets, in a temporary directory.
+std::filesystem::path make_project(std::string_view name)
+{
+    auto project = std::filesystem::temp_directory_path() / std::format("vmk-{}-{}", name, ::getpid());
+    std::filesystem::create_directories(project / ".git");
+    std::ofstream{ project / "CMakeLists.txt" } << "project(test)\n";
+    std::ofstream{ project / "CMakePresets.json" }
+        << R"({"version": 3, "configurePresets": [{"name": "default", "binaryDir": "build"}]})";
+    return project;
+}
+
+} // namespace
+
+/// Finding the project must not start anything: vmk is called from save hooks, and outside of a project it fails.
+TEST_CASE("startup_spawns_nothing", "[startup]")
+{
+    static constexpr auto tools = std::array{ "bundle"sv, "c++"sv,   "cargo"sv, "cc"sv,    "clang"sv, "clang++"sv,
+                                              "cmake"sv,  "conan"sv, "ctest"sv, "g++"sv,   "gcc"sv,   "git"sv,
+                                              "gradle"sv, "make"sv,  "meson"sv, "ninja"sv, "sh"sv };
+
+    auto project = make_project("startup-spawn");
+    std::ofstream{ project / "conanfile.txt" } << "[requires]\n";
+    auto outside = project.parent_path() / std::format("vmk-startup-outside-{}", ::getpid());
+    std::filesystem::create_directories(outside);
+
+    // Every tool vmk could start only writes its name down.
+    auto spies = project.parent_path() / std::format("vmk-startup-spies-{}", ::getpid());
+    auto log   = spies / "spawned.log";
+    std::filesystem::create_directories(spies);
+    for (auto tool : tools) {
+        auto script = spies / tool;
+        std::ofstream{ script } << std::format("#!/bin/sh\necho {} >> {}\n", tool, log.string());
+        std::filesystem::permissions(script, std::filesystem::perms::owner_all);
+    }
+    auto path = std::string{ std::getenv("PATH") != nullptr ? std::getenv("PATH") : "" };
+    ::setenv("PATH", spies.c_str(), 1);
+
+    CHECK(detect_first_stage(work_dir{ outside }) == nullptr);
+    CHECK_FALSE(pipeline::detect(outside).has_value());
+
+    auto factory = detect_first_stage(work_dir{ builders::git_root_locator(project / "src").value_or(project) });
+    CHECK(factory != nullptr);
+    CHECK(pipeline::detect(project).has_value());
+
+    auto env = env::environment{};
+    import_default_environment(env);
+
+    ::setenv("PATH", path.c_str(), 1);
+    CHECK_FALSE(std::filesystem::exists(log));
+
+    std::filesystem::remove_all(spies);
+    std::filesystem::remove_all(outside);
+    std::filesystem::remove_all(project);
+}
+
+/// The time of the no-op path, only run when asked for: `vmak_test [performance]`. Timings are meaningless in Debug
+/// builds, under sanitizers or on a loaded machine.
+TEST_CASE("startup_budget", "[.][startup][performance]")
+{
+    static constexpr auto budget = std::chrono::milliseconds{ 5 };
+    static constexpr auto rounds = 20;
+
+    auto project = make_project("startup");
+
+    auto total = startup_profile::clock::duration{};
+    for (auto round = 0; round < rounds; ++round) {
+        auto profile = startup_profile{};
+
+        auto root    = builders::git_root_locator(project / "src").value_or(project);
+        auto factory = detect_first_stage(work_dir{ root });
+        REQUIRE(factory != nullptr);
+
+        auto env = env::environment{};
+        import_default_environment(env);
+
+        auto created = maker::builder{ factory->my_builder(work_dir{ root }, env) };
+        REQUIRE(created);
+        static_cast<void>(created.required());
+
+        profile.mark("no-op");
+        total += profile.total();
+    }
+
+    std::filesystem::remove_all(project);
+    CHECK(total / rounds < budget);
+}
+
+}
@@ -1,5 +1,7 @@
 #include "builders/cmake_preset.hpp"
 #include "builders/conan.hpp"
+#include "builders/ninja.hpp"
+#include "builders/package.hpp"
 #include <catch2/catch_all.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers.hpp>
@@ -9,6 +11,7 @@
 #include <exception>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <ranges>
 #include <source_location>
 #include <string>
@@ -44,6 +47,53 @@ TEST_CASE("cmake_presets", "[builders][cmake][json]")
         Catch::Matchers::UnorderedEquals(std::vector{ { "direct-test"s, "test-included"s } }));
 }
 
+TEST_CASE("cmake_preset_binary_dir", "[builders][cmake][json]")
+{
+    auto source = std::filesystem::temp_directory_path() / std::format("vmk-presets-{}", ::getpid()) / "project";
+    std::filesystem::create_directories(source);
+    std::ofstream{ source / "CMakePresets.json" } << R"({
+        "version": 6,
+        "configurePresets": [
+            { "name": "base", "hidden": true, "generator": "Ninja", "binaryDir": "${sourceDir}/out/${presetName}" },
+            { "name": "debug", "inherits": "base" },
+            { "name": "shared", "inherits": [ "debug" ], "binaryDir": "../${sourceDirName}-shared" },
+            { "name": "unset", "generator": "Unix Makefiles" }
+        ],
+        "buildPresets": [ { "name": "debug-build", "configurePreset": "debug" } ],
+        "packagePresets": [
+            { "name": "pack", "configurePreset": "shared" },
+            { "name": "archives", "inherits": "pack", "generators": [ "TGZ", "TXZ" ] }
+        ]
+    })";
+
+    auto presets = builders::presets_storage{ source / "CMakePresets.json" };
+    using enum task_type;
+
+    CHECK(presets.binary_dir(configuration, "debug", source) == source / "out/debug");
+    CHECK(presets.binary_dir(build, "debug-build", source) == source / "out/debug");
+    CHECK(presets.binary_dir(package, "pack", source) == source.parent_path() / "project-shared");
+    CHECK_FALSE(presets.binary_dir(configuration, "unset", source).has_value());
+    CHECK_FALSE(presets.binary_dir(build, "missing", source).has_value());
+    CHECK(presets.generator(build, "debug-build") == "Ninja");
+    CHECK(presets.generator(configuration, "unset") == "Unix Makefiles");
+    CHECK(presets.binary_dir(package, "archives", source) == source.parent_path() / "project-shared");
+    CHECK(presets.package_generators("archives") == std::vector{ "TGZ"s, "TXZ"s });
+    CHECK(presets.package_generators("pack").empty());
+
+    std::filesystem::remove_all(source.parent_path());
+}
+
+TEST_CASE("package_generators_option", "[builders][package]")
+{
+    auto env = env::environment{};
+    CHECK_FALSE(builders::package::apply(env, { "--generators=TGZ,DEB"sv, "--generators=ZIP"sv }).has_value());
+    CHECK(value_of(env, builders::package::GENERATORS_VAR) == "TGZ,DEB,ZIP");
+
+    auto error = builders::package::apply(env, { "--generators=TGZ,DEB"sv, "--generators=,TGZ"sv });
+    REQUIRE(error.has_value());
+    CHECK(error->contains("TGZ"));
+}
+
 TEST_CASE("conan_config", "[conan][config]")
 {
     SKIP();
@@ -103,4 +153,16 @@ TEST_CASE("conan_profile_config", "[conan][config][profile]")
     }
 }
 
+TEST_CASE("ninja_targets", "[builders][ninja]")
+{
+    auto build   = std::filesystem::temp_directory_path();
+    auto builder = builders::ninja{ work_dir{ build }, env::environment{}, build };
+
+    CHECK_THAT(
+        builder.command_line(std::vector{ "a"sv, "b"sv, "c"sv }),
+        Catch::Matchers::RangeEquals(std::vector{ "ninja"s, "-C"s, build.string(), "a"s, "b"s, "c"s }));
+    CHECK_THAT(
+        builder.command_line({}), Catch::Matchers::RangeEquals(std::vector{ "ninja"s, "-C"s, build.string() }));
+}
+
 }
@@ -0,0 +1,51 @@
+#ifndef INCLUDED_TIMINGS_HPP
+#define INCLUDED_TIMINGS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace vb::maker {
+
+/// Time spent in something a profile aggregates, a template, a compiler pass, a cmake package…, and how many times.
+struct timing
+{
+    double      seconds = 0.0;
+    std::size_t count   = 0;
+};
+
+using timings = std::map<std::string, timing, std::less<>>;
+
+/// Charges `seconds` to `name`.
+inline void add_timing(timings& entries, std::string_view name, double seconds)
+{
+    auto found = entries.find(name);
+    if (found == entries.end()) {
+        found = entries.emplace(std::string{ name }, timing{}).first;
+    }
+    found->second.seconds += seconds;
+    found->second.count++;
+}
+
+/// The `limit` entries with the most time, the slowest first.
+inline std::vector<std::pair<std::string, timing>> slowest(const timings& entries, std::size_t limit)
+{
+    auto result = std::ranges::to<std::vector<std::pair<std::string, timing>>>(entries);
+    auto count  = std::min(limit, result.size());
+    std::ranges::partial_sort(
+        result, result.begin() + static_cast<std::ptrdiff_t>(count), std::ranges::greater{}, [](const auto& item) {
+            return item.second.seconds;
+        });
+    result.resize(count);
+    return result;
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_TIMINGS_HPP
@@ -8,7 +8,13 @@
 
 #include <concepts>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <print>
 #include <ranges>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 namespace vb::maker {
@@ -17,6 +23,9 @@ using namespace std::literals;
 
 using arguments = std::vector<std::string_view>;
 
+/// Receives the lines the tools print, as they print them.
+using output_sink = std::function<void(std::string_view line, std_io stream)>;
+
 template<typename WORKDIR>
 concept is_work_directory = requires(const WORKDIR dir) {
     { dir.path() } -> std::same_as<fs::path>;
@@ -32,8 +41,13 @@ struct work_dir
 {
     fs::path root;
 
-    explicit work_dir(fs::path rt = fs::current_path())
+    /// When set the output of the tools goes there instead of the terminal, the builders created from this directory
+    /// share it.
+    std::shared_ptr<const output_sink> sink;
+
+    explicit work_dir(fs::path rt = fs::current_path(), std::shared_ptr<const output_sink> sink_ = nullptr)
         : root{ rt }
+        , sink{ std::move(sink_) }
     {
     }
 
@@ -67,7 +81,13 @@ struct work_dir
     auto execute(std::string_view command, std::ranges::contiguous_range auto args, env::environment::optional env = {})
         const -> execution_result
     {
-        auto errors = std::vector<std::string>{};
+        auto arguments = std::ranges::to<std::vector>(args | std::views::transform([](auto view) {
+                                                          return std::string(view);
+                                                      }));
+        if (sink) {
+            return execute_to_sink(command, arguments, env);
+        }
+
         std::print(" {} [ {} ", root.string(), command);
         for (const auto& arg : args) {
             std::print("«{}» ", arg);
@@ -75,16 +95,73 @@ struct work_dir
         std::println(" ]\n");
 
         execution executer{ io_set::ERR };
-        executer.execute(
-            command,
-            std::ranges::to<std::vector>(args | std::views::transform([](auto view) {
-                                             return std::string(view);
-                                         })),
-            env,
-            root);
+        executer.execute(command, arguments, env, root);
 
         return execution_result{ executer };
     }
+
+    /// Hands a line a tool printed to the sink, or prints it on the terminal when there is none.
+    void emit(std::string_view line, std_io stream = std_io::OUT) const
+    {
+        static auto lock  = std::mutex{};
+        auto        guard = std::lock_guard{ lock };
+        if (sink) {
+            (*sink)(line, stream);
+        } else if (stream == std_io::ERR) {
+            std::println(stderr, "{}", line);
+        } else {
+            std::println("{}", line);
+        }
+    }
+
+    /// Runs `command` in `dir` and calls `on_line` with each line it prints, as it prints it. Returns the exit code.
+    ///
+    /// The errors are drained on their own thread, a tool blocked on a full pipe would never finish the other one.
+    /// `on_line` is never called from both threads at once.
+    int stream_lines(
+        std::string_view                                    command,
+        const std::vector<std::string>&                     arguments,
+        env::environment::optional                          env,
+        const fs::path&                                     dir,
+        const std::function<void(std::string_view, std_io)>& on_line) const
+    {
+        execution tool{ io_set::OUT | io_set::ERR };
+        tool.execute(command, arguments, env, dir);
+        {
+            auto lock   = std::mutex{};
+            auto reader = std::jthread{ [&tool, &lock, &on_line] {
+                for (const auto& line : tool.lines<std_io::ERR>()) {
+                    auto guard = std::lock_guard{ lock };
+                    on_line(line, std_io::ERR);
+                }
+            } };
+            for (const auto& line : tool.lines<std_io::OUT>()) {
+                auto guard = std::lock_guard{ lock };
+                on_line(line, std_io::OUT);
+            }
+        }
+        return tool.wait();
+    }
+
+private:
+
+    execution_result execute_to_sink(
+        std::string_view                command,
+        const std::vector<std::string>& arguments,
+        env::environment::optional      env) const
+    {
+        auto result      = execution_result{};
+        result.exit_code = stream_lines(command, arguments, env, root, [this, &result](std::string_view line, std_io stream) {
+            emit(line, stream);
+            if (stream == std_io::ERR) {
+                result.error_output.emplace_back(line);
+            }
+        });
+        result.status = result.exit_code != 0         ? execution_result::FAILURE
+                      : result.error_output.empty() ? execution_result::SUCCESS
+                                                    : execution_result::SOFT_FAILURE;
+        return result;
+    }
 };
 
 }
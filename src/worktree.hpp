@@ -0,0 +1,153 @@
+#ifndef INCLUDED_WORKTREE_HPP
+#define INCLUDED_WORKTREE_HPP
+
+#include "hash.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Locates the git directory of a checkout.
+///
+/// For the main worktree `.git` is the directory itself, for linked worktrees (and submodules) `.git` is a file
+/// containing `gitdir: «path»`.
+inline std::optional<std::filesystem::path> git_dir(std::filesystem::path root)
+{
+    static constexpr auto GITDIR_PREFIX = "gitdir:"sv;
+
+    auto git = root / ".git";
+    if (std::filesystem::is_directory(git)) {
+        return git;
+    }
+
+    if (!std::filesystem::is_regular_file(git)) {
+        return std::nullopt;
+    }
+
+    auto line = std::string{};
+    std::getline(std::ifstream{ git }, line);
+    if (!line.starts_with(GITDIR_PREFIX)) {
+        return std::nullopt;
+    }
+
+    auto start = line.find_first_not_of(' ', GITDIR_PREFIX.size());
+    if (start == line.npos) {
+        return std::nullopt;
+    }
+
+    auto path = std::filesystem::path{ line.substr(start) };
+    return path.is_absolute() ? path : std::filesystem::weakly_canonical(root / path);
+}
+
+/// The git directory shared by all worktrees of a repository.
+inline std::optional<std::filesystem::path> git_common_dir(std::filesystem::path root)
+{
+    auto dir = git_dir(root);
+    if (!dir) {
+        return std::nullopt;
+    }
+
+    auto common = *dir / "commondir";
+    if (!std::filesystem::is_regular_file(common)) {
+        return dir;
+    }
+
+    auto line = std::string{};
+    std::getline(std::ifstream{ common }, line);
+    auto path = std::filesystem::path{ line };
+    return path.is_absolute() ? path : std::filesystem::weakly_canonical(*dir / path);
+}
+
+/// Root of the main worktree, the same for every `git worktree` of the repository.
+inline std::filesystem::path main_worktree_root(std::filesystem::path root)
+{
+    auto common = git_common_dir(root);
+    if (!common || common->filename() != ".git") {
+        return root;
+    }
+    return common->parent_path();
+}
+
+inline std::filesystem::path xdg_cache_home()
+{
+    if (auto cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr && *cache != '\0') {
+        return std::filesystem::path{ cache };
+    }
+    if (auto home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+        return std::filesystem::path{ home } / ".cache";
+    }
+    return std::filesystem::temp_directory_path();
+}
+
+inline std::filesystem::path xdg_state_home()
+{
+    if (auto state = std::getenv("XDG_STATE_HOME"); state != nullptr && *state != '\0') {
+        return std::filesystem::path{ state };
+    }
+    if (auto home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+        return std::filesystem::path{ home } / ".local" / "state";
+    }
+    return std::filesystem::temp_directory_path();
+}
+
+/// Names a repository the same way from all its worktrees: `«repository name»-«hash»`.
+inline std::string repository_id(std::filesystem::path root)
+{
+    auto main_root = main_worktree_root(root);
+    return std::format("{}-{}", main_root.filename().string(), fingerprint{ main_root.string() }.hex());
+}
+
+/// A cache directory shared by all worktrees of the repository containing `root`.
+///
+/// The result looks like `$XDG_CACHE_HOME/vmk/«repository name»-«hash»/«kind»`. It is not created here, the builders
+/// look it up when they are detected; the tools given the path create it when a stage runs.
+inline std::filesystem::path shared_cache_dir(std::filesystem::path root, std::string_view kind)
+{
+    return xdg_cache_home() / "vmk" / repository_id(root) / kind;
+}
+
+/// Directory for the data vmk keeps about the repository containing `root`, `$XDG_STATE_HOME/vmk/«repository id»`.
+inline std::filesystem::path repository_state_dir(std::filesystem::path root)
+{
+    auto result = xdg_state_home() / "vmk" / repository_id(root);
+    std::filesystem::create_directories(result);
+    return result;
+}
+
+/// Searches for an executable in `PATH`.
+inline std::optional<std::filesystem::path> find_program(std::string_view name)
+{
+    auto path = std::getenv("PATH");
+    if (path == nullptr) {
+        return std::nullopt;
+    }
+
+    auto paths = std::string_view{ path };
+    while (!paths.empty()) {
+        auto separator = paths.find(':');
+        auto dir       = paths.substr(0, separator);
+        paths          = separator == paths.npos ? ""sv : paths.substr(separator + 1);
+
+        auto candidate = std::filesystem::path{ dir.empty() ? "."sv : dir } / name;
+        auto error     = std::error_code{};
+        if (std::filesystem::is_regular_file(candidate, error) &&
+            (std::filesystem::status(candidate, error).permissions() & std::filesystem::perms::owner_exec) !=
+                std::filesystem::perms::none) {
+            return candidate;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace vb::maker
+
+#endif // INCLUDED_WORKTREE_HPP
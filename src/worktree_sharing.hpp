@@ -0,0 +1,169 @@
+#ifndef INCLUDED_WORKTREE_SHARING_HPP
+#define INCLUDED_WORKTREE_SHARING_HPP
+
+#include "builder.hpp"
+#include "state.hpp"
+#include "worktree.hpp"
+#include <util/environment.hpp>
+
+#include <array>
+#include <filesystem>
+#include <format>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vb::maker {
+
+using namespace std::literals;
+
+/// Makes the outputs of a worktree independent of where it is checked out.
+///
+/// Enabled by `VMK_SHARE_WORKTREES`. The compilers get prefix maps so that the worktree path does not end up in the
+/// objects, ccache is told to ignore the worktree location, and the caches are moved to a location shared by all the
+/// worktrees of the repository. A fresh worktree can then build mostly from the cache.
+struct worktree_sharing
+{
+    static constexpr auto ENABLE_VAR = "VMK_SHARE_WORKTREES"sv;
+    static constexpr auto PROVIDER   = "vmk-provider.cmake"sv;
+    static constexpr auto SOURCES    = "@SOURCES@"sv;
+
+    /// Dependency provider sharing the sources populated by `FetchContent_MakeAvailable`.
+    ///
+    /// Each dependency is populated once in `«shared dir»/«name»-«hash of its details»`, under a lock, and is then
+    /// handed to FetchContent through `FETCHCONTENT_SOURCE_DIR_«NAME»`. The build directories of the dependencies stay in each
+    /// build tree, so that concurrent configurations never write to the same place.
+    static constexpr auto provider_script = R"(# Written by vmk, shares the FetchContent sources between the worktrees.
+include(FetchContent)
+
+function(vmk_share_fetchcontent method name)
+    string(TOUPPER "${name}" upper)
+    string(TOLOWER "${name}" lower)
+    cmake_parse_arguments(PARSE_ARGV 2 declared "SYSTEM;EXCLUDE_FROM_ALL" "SOURCE_DIR;BINARY_DIR;SUBBUILD_DIR" "")
+    if(DEFINED FETCHCONTENT_SOURCE_DIR_${upper} OR FETCHCONTENT_FULLY_DISCONNECTED
+       OR NOT declared_SOURCE_DIR STREQUAL "${FETCHCONTENT_BASE_DIR}/${lower}-src")
+        return()
+    endif()
+
+    string(SHA1 key "${declared_UNPARSED_ARGUMENTS}")
+    string(SUBSTRING "${key}" 0 16 key)
+    set(shared "@SOURCES@/${lower}-${key}")
+    if(NOT EXISTS "${shared}.populated")
+        file(LOCK "${shared}.lock" GUARD FUNCTION)
+        if(NOT EXISTS "${shared}.populated")
+            file(REMOVE_RECURSE "${shared}")
+            FetchContent_Populate(vmk_${lower} QUIET ${declared_UNPARSED_ARGUMENTS}
+                SOURCE_DIR "${shared}"
+                BINARY_DIR "${declared_BINARY_DIR}"
+                SUBBUILD_DIR "${FETCHCONTENT_BASE_DIR}/${lower}-vmk-subbuild")
+            file(TOUCH "${shared}.populated")
+        endif()
+    endif()
+    set(FETCHCONTENT_SOURCE_DIR_${upper} "${shared}" PARENT_SCOPE)
+endfunction()
+
+cmake_language(SET_DEPENDENCY_PROVIDER vmk_share_fetchcontent SUPPORTED_METHODS FETCHCONTENT_MAKEAVAILABLE_SERIAL)
+)"sv;
+
+    static constexpr auto flag_variables = std::array{ "CFLAGS"sv, "CXXFLAGS"sv };
+
+    static bool enabled(const env::environment& env)
+    {
+        auto value = value_of(env, ENABLE_VAR);
+        return !value.empty() && value != "0" && value != "false";
+    }
+
+    static std::array<std::string, 2> prefix_maps(const std::filesystem::path& root)
+    {
+        return { std::format("-ffile-prefix-map={}=.", root.string()),
+                 std::format("-fdebug-prefix-map={}=.", root.string()) };
+    }
+
+    /// Sets up the environment of a configuration stage. Does nothing if sharing is not enabled.
+    static void apply(env::environment& env, const std::filesystem::path& root)
+    {
+        if (!enabled(env)) {
+            return;
+        }
+
+        for (auto name : flag_variables) {
+            auto flags = value_of(env, name);
+            for (const auto& map : prefix_maps(root)) {
+                if (!flags.contains(map)) {
+                    flags += flags.empty() ? map : " " + map;
+                }
+            }
+            env.set(name) = flags;
+        }
+
+        env.set("CCACHE_BASEDIR")   = root.string();
+        env.set("CCACHE_NOHASHDIR") = "true";
+        if (value_of(env, "CCACHE_DIR").empty()) {
+            env.set("CCACHE_DIR") = shared_cache_dir(root, "ccache").string();
+        }
+
+        if (find_program("ccache").has_value()) {
+            for (auto name : { "CMAKE_C_COMPILER_LAUNCHER"sv, "CMAKE_CXX_COMPILER_LAUNCHER"sv }) {
+                if (value_of(env, name).empty()) {
+                    env.set(name) = "ccache";
+                }
+            }
+        }
+    }
+
+    static std::filesystem::path fetchcontent_dir(const std::filesystem::path& root)
+    {
+        return shared_cache_dir(root, "fetchcontent");
+    }
+
+    /// The provider script for the shared sources directory `sources`.
+    static std::string fetchcontent_provider(const std::filesystem::path& sources)
+    {
+        auto quoted = std::string{};
+        for (auto c : sources.generic_string()) {
+            if (c == '\\' || c == '"' || c == '$') {
+                quoted.push_back('\\');
+            }
+            quoted.push_back(c);
+        }
+
+        auto result = std::string{ provider_script };
+        for (auto at = result.find(SOURCES); at != result.npos; at = result.find(SOURCES, at + quoted.size())) {
+            result.replace(at, SOURCES.size(), quoted);
+        }
+        return result;
+    }
+
+    /// Writes the FetchContent provider before a cmake configuration runs. Does nothing if sharing is not enabled.
+    ///
+    /// The script is only rewritten when it changes, configurations of other worktrees may be reading it.
+    static void prepare(const env::environment& env, const std::filesystem::path& root)
+    {
+        if (!enabled(env)) {
+            return;
+        }
+
+        auto dir = fetchcontent_dir(root);
+        std::filesystem::create_directories(dir);
+        auto script = fetchcontent_provider(dir);
+        if (read_file(dir / PROVIDER) != script) {
+            write_atomically(dir / PROVIDER, script);
+        }
+    }
+
+    /// Cache entries for a cmake configuration, empty if sharing is not enabled.
+    ///
+    /// Only the sources of the dependencies are shared, see `provider_script`; `FETCHCONTENT_BASE_DIR` stays in the
+    /// build directory.
+    static std::vector<std::string> cmake_arguments(const env::environment& env, const std::filesystem::path& root)
+    {
+        if (!enabled(env)) {
+            return {};
+        }
+        return { std::format("-DCMAKE_PROJECT_TOP_LEVEL_INCLUDES={}", (fetchcontent_dir(root) / PROVIDER).string()) };
+    }
+};
+
+} // namespace vb::maker
+
+#endif // INCLUDED_WORKTREE_SHARING_HPP